@@ -0,0 +1,440 @@
+/*
+ * shmfifo-ipc, the same message stream through shm_fifo, pipe(2), AF_UNIX
+ * SOCK_SEQPACKET and POSIX message queues between the same pair of cpus,
+ * ping-pong latency and one direction throughput side by side
+ *
+ * shmfifo busy polls, shmfifo-wait uses SHMFIFO_FLAG_WAIT and sleeps on the
+ * futex like the kernel transports sleep in their syscalls
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <mqueue.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "shmfifo.h"
+#include "bench_util.h"
+
+#define IPC_ITERS    (20000)
+#define IPC_WARMUP   (2000)
+#define IPC_MSGS     (200000)
+#define IPC_DEPTH    (1024)
+#define IPC_MQ_DEPTH (10)
+#define IPC_PATH     "/dev/shm/shmfifo_ipc"
+
+enum {
+  IPC_SHMFIFO = 0,
+  IPC_SHMFIFO_WAIT,
+  IPC_PIPE,
+  IPC_SOCKET,
+  IPC_MQUEUE,
+  IPC_TRANSPORT_NUM,
+};
+
+/*
+ * both directions of one transport, channel 0 carries parent to child and
+ * channel 1 child to parent, side s sends on channel s
+ */
+struct IpcLink {
+  int             kind;
+  size_t          size;
+  int             yield;
+  int             pipe_fd[2][2];
+  int             sock[2];
+  mqd_t           mq[2];
+  char            name[2][256];
+  struct ShmFifo *fifo[2];
+};
+
+struct IpcResult {
+  struct BenchHist hist;
+  double           rate;
+  int              ok;
+};
+
+static const char *kIpcNames[IPC_TRANSPORT_NUM] = {
+  "shmfifo", "shmfifo-wait", "pipe", "seqpacket", "mqueue",
+};
+
+static void IpcUsage(const char *prog)
+{
+  fprintf(stderr, "usage: %s [-s sizes] [-n iters] [-N msgs] [-c cpu0,cpu1] [-g factor]\n"
+    "  [-p path]\n"
+    "  -s  message sizes, default 64,1k,4k\n"
+    "  -n  measured round trips per transport and size, default %d\n"
+    "  -N  messages of the throughput run, default %d\n"
+    "  -c  cpus of the two processes, default 0,1\n"
+    "  -g  exit 2 unless shmfifo beats every other transport by factor in p50\n"
+    "      latency and throughput\n"
+    "  -p  fifo file prefix, default %s\n", prog, IPC_ITERS, IPC_MSGS, IPC_PATH);
+}
+
+static uint64_t IpcNs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int IpcFifoOpen(struct IpcLink *link, int chan, int create)
+{
+  struct ShmFifoAttr attr;
+
+  if (create) {
+    unlink(link->name[chan]);
+  }
+  ShmFifoAttrInit(&attr);
+  attr.flags = link->kind == IPC_SHMFIFO_WAIT ? SHMFIFO_FLAG_WAIT : 0;
+  link->fifo[chan] = ShmFifoOpenAttr(link->name[chan], link->size, IPC_DEPTH, &attr);
+  return link->fifo[chan] ? 0 : -1;
+}
+
+/* parent side, before the fork */
+static int IpcSetup(struct IpcLink *link, const char *path)
+{
+  struct mq_attr attr;
+  int            chan;
+
+  for (chan = 0; chan < 2; ++chan) {
+    switch (link->kind) {
+    case IPC_SHMFIFO:
+    case IPC_SHMFIFO_WAIT:
+      snprintf(link->name[chan], sizeof(link->name[chan]), "%s.%d", path, chan);
+      if (IpcFifoOpen(link, chan, 1) < 0) {
+        return -1;
+      }
+      ShmFifoClose(link->fifo[chan]);
+      link->fifo[chan] = NULL;
+      break;
+    case IPC_PIPE:
+      if (pipe(link->pipe_fd[chan]) < 0) {
+        return -1;
+      }
+      break;
+    case IPC_SOCKET:
+      if (chan == 0 && socketpair(AF_UNIX, SOCK_SEQPACKET, 0, link->sock) < 0) {
+        return -1;
+      }
+      break;
+    case IPC_MQUEUE:
+      snprintf(link->name[chan], sizeof(link->name[chan]), "/shmfifo_ipc.%d.%d",
+        (int)getpid(), chan);
+      memset(&attr, 0, sizeof(attr));
+      attr.mq_maxmsg = IPC_MQ_DEPTH;
+      attr.mq_msgsize = link->size;
+      mq_unlink(link->name[chan]);
+      link->mq[chan] = mq_open(link->name[chan], O_RDWR | O_CREAT | O_EXCL, 0600, &attr);
+      if (link->mq[chan] == (mqd_t)-1) {
+        return -1;
+      }
+      break;
+    }
+  }
+  return 0;
+}
+
+static void IpcTeardown(struct IpcLink *link)
+{
+  int chan;
+
+  for (chan = 0; chan < 2; ++chan) {
+    switch (link->kind) {
+    case IPC_SHMFIFO:
+    case IPC_SHMFIFO_WAIT:
+      if (link->fifo[chan]) {
+        ShmFifoClose(link->fifo[chan]);
+      }
+      unlink(link->name[chan]);
+      break;
+    case IPC_PIPE:
+      close(link->pipe_fd[chan][0]);
+      close(link->pipe_fd[chan][1]);
+      break;
+    case IPC_SOCKET:
+      close(link->sock[chan]);
+      break;
+    case IPC_MQUEUE:
+      mq_close(link->mq[chan]);
+      mq_unlink(link->name[chan]);
+      break;
+    }
+  }
+}
+
+/* both processes, after the fork, fifos are opened per process */
+static int IpcAttach(struct IpcLink *link)
+{
+  if (link->kind != IPC_SHMFIFO && link->kind != IPC_SHMFIFO_WAIT) {
+    return 0;
+  }
+  return (IpcFifoOpen(link, 0, 0) < 0 || IpcFifoOpen(link, 1, 0) < 0) ? -1 : 0;
+}
+
+static int IpcSend(struct IpcLink *link, int side, const char *buf)
+{
+  size_t  done = 0;
+  ssize_t n;
+
+  switch (link->kind) {
+  case IPC_SHMFIFO:
+    while (ShmFifoPush(link->fifo[side], buf, link->size) <= 0) {
+      BenchRelax(link->yield);
+    }
+    return 0;
+  case IPC_SHMFIFO_WAIT:
+    return ShmFifoPushWait(link->fifo[side], buf, link->size, -1) > 0 ? 0 : -1;
+  case IPC_PIPE:
+    while (done < link->size) {
+      n = write(link->pipe_fd[side][1], buf + done, link->size - done);
+      if (n <= 0) {
+        return -1;
+      }
+      done += n;
+    }
+    return 0;
+  case IPC_SOCKET:
+    return send(link->sock[side], buf, link->size, 0) == (ssize_t)link->size ? 0 : -1;
+  default:
+    return mq_send(link->mq[side], buf, link->size, 0);
+  }
+}
+
+static int IpcRecv(struct IpcLink *link, int side, char *buf)
+{
+  size_t  done = 0;
+  ssize_t n;
+
+  switch (link->kind) {
+  case IPC_SHMFIFO:
+    while (ShmFifoPopData(link->fifo[1 - side], buf, link->size) <= 0) {
+      BenchRelax(link->yield);
+    }
+    return 0;
+  case IPC_SHMFIFO_WAIT:
+    return ShmFifoPopDataWait(link->fifo[1 - side], buf, link->size, -1) > 0 ? 0 : -1;
+  case IPC_PIPE:
+    while (done < link->size) {
+      n = read(link->pipe_fd[1 - side][0], buf + done, link->size - done);
+      if (n <= 0) {
+        return -1;
+      }
+      done += n;
+    }
+    return 0;
+  case IPC_SOCKET:
+    return recv(link->sock[side], buf, link->size, 0) == (ssize_t)link->size ? 0 : -1;
+  default:
+    return mq_receive(link->mq[1 - side], buf, link->size, NULL) == (ssize_t)link->size ?
+      0 : -1;
+  }
+}
+
+/* child, echoes the round trips then swallows the stream and acks it */
+static int IpcChild(struct IpcLink *link, long rounds, long msgs, uint64_t *end_ns, int cpu)
+{
+  char *buf = (char *)calloc(1, link->size);
+  long  i;
+
+  BenchPinCpu(cpu);
+  if (IpcAttach(link) < 0) {
+    return 1;
+  }
+  for (i = 0; i < rounds; ++i) {
+    if (IpcRecv(link, 1, buf) < 0 || IpcSend(link, 1, buf) < 0) {
+      return 1;
+    }
+  }
+  for (i = 0; i < msgs; ++i) {
+    if (IpcRecv(link, 1, buf) < 0) {
+      return 1;
+    }
+  }
+  __atomic_store_n(end_ns, IpcNs(), __ATOMIC_RELEASE);
+  if (IpcSend(link, 1, buf) < 0) {
+    return 1;
+  }
+  free(buf);
+  return 0;
+}
+
+static int IpcParent(struct IpcLink *link, long warmup, long iters, long msgs,
+  const uint64_t *end_ns, struct IpcResult *result)
+{
+  struct BenchStamp *stamp;
+  char              *buf = (char *)calloc(1, link->size);
+  uint64_t           start_ns;
+  long               i;
+  int                ret = -1;
+
+  stamp = (struct BenchStamp *)buf;
+  if (IpcAttach(link) < 0) {
+    goto out;
+  }
+  for (i = 0; i < warmup + iters; ++i) {
+    stamp->seq = i;
+    stamp->tsc = BenchTsc();
+    if (IpcSend(link, 0, buf) < 0 || IpcRecv(link, 0, buf) < 0) {
+      goto out;
+    }
+    if (i >= warmup) {
+      BenchHistRecord(&result->hist, BenchTsc() - stamp->tsc);
+    }
+  }
+  start_ns = IpcNs();
+  for (i = 0; i < msgs; ++i) {
+    stamp->seq = i;
+    if (IpcSend(link, 0, buf) < 0) {
+      goto out;
+    }
+  }
+  if (IpcRecv(link, 0, buf) < 0) {
+    goto out;
+  }
+  result->rate = msgs * 1e9 / (__atomic_load_n(end_ns, __ATOMIC_ACQUIRE) - start_ns);
+  ret = 0;
+
+out:
+  free(buf);
+  return ret;
+}
+
+static int IpcRun(int kind, size_t size, const char *path, long warmup, long iters, long msgs,
+  const int *cpu, struct IpcResult *result)
+{
+  struct IpcLink link;
+  uint64_t      *end_ns;
+  pid_t          pid;
+  int            status;
+  int            ret;
+
+  memset(&link, 0, sizeof(link));
+  link.kind = kind;
+  link.size = size;
+  link.yield = cpu[0] == cpu[1];
+  BenchHistInit(&result->hist);
+  result->ok = 0;
+  if (IpcSetup(&link, path) < 0) {
+    fprintf(stderr, "%s size %lu setup failed, %s\n", kIpcNames[kind], (unsigned long)size,
+      strerror(errno));
+    IpcTeardown(&link);
+    return -1;
+  }
+  end_ns = (uint64_t *)mmap(NULL, sizeof(*end_ns), PROT_READ | PROT_WRITE,
+    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (end_ns == MAP_FAILED) {
+    IpcTeardown(&link);
+    return -1;
+  }
+  pid = fork();
+  if (pid == 0) {
+    _exit(IpcChild(&link, warmup + iters, msgs, end_ns, cpu[1]));
+  }
+  BenchPinCpu(cpu[0]);
+  ret = IpcParent(&link, warmup, iters, msgs, end_ns, result);
+  if (ret < 0) {
+    kill(pid, SIGKILL);
+  }
+  waitpid(pid, &status, 0);
+  munmap(end_ns, sizeof(*end_ns));
+  IpcTeardown(&link);
+  result->ok = !ret && WIFEXITED(status) && !WEXITSTATUS(status);
+  return result->ok ? 0 : -1;
+}
+
+int main(int argc, char *argv[])
+{
+  static struct IpcResult result[IPC_TRANSPORT_NUM];
+  const char             *path = IPC_PATH;
+  const char             *cpus = NULL;
+  size_t                  sizes[BENCH_LIST_MAX] = {64, 1024, 4096};
+  size_t                  size;
+  double                  ns;
+  double                  factor = 0;
+  double                  p50;
+  double                  base_p50;
+  long                    iters = IPC_ITERS;
+  long                    msgs = IPC_MSGS;
+  int                     size_num = 3;
+  int                     cpu[2];
+  int                     guard_failed = 0;
+  int                     opt;
+  int                     s;
+  int                     k;
+
+  while ((opt = getopt(argc, argv, "s:n:N:c:g:p:h")) != -1) {
+    switch (opt) {
+    case 's':
+      size_num = BenchParseList(optarg, sizes, BENCH_LIST_MAX);
+      break;
+    case 'n':
+      iters = atol(optarg);
+      break;
+    case 'N':
+      msgs = atol(optarg);
+      break;
+    case 'c':
+      cpus = optarg;
+      break;
+    case 'g':
+      factor = atof(optarg);
+      break;
+    case 'p':
+      path = optarg;
+      break;
+    default:
+      IpcUsage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc || size_num <= 0 || iters <= 0 || msgs <= 0 || factor < 0 ||
+      BenchParseCpus(cpus, &cpu[0], &cpu[1]) < 0 || cpu[0] < 0 || cpu[1] < 0 ||
+      cpu[0] >= BenchCpuCount() || cpu[1] >= BenchCpuCount()) {
+    IpcUsage(argv[0]);
+    return 1;
+  }
+  ns = BenchTscPerNs();
+  printf("# cpus %d,%d  rtt in ns, throughput one direction%s\n", cpu[0], cpu[1],
+    cpu[0] == cpu[1] ? "  same cpu, spinning yields" : "");
+  printf("%-12s %7s %9s %9s %9s %12s %10s %9s %9s\n", "transport", "size", "rtt_p50",
+    "rtt_p99", "rtt_max", "msgs/s", "MB/s", "x_p50", "x_rate");
+  for (s = 0; s < size_num; ++s) {
+    size = sizes[s] < sizeof(struct BenchStamp) ? sizeof(struct BenchStamp) : sizes[s];
+    for (k = 0; k < IPC_TRANSPORT_NUM; ++k) {
+      if (IpcRun(k, size, path, IPC_WARMUP, iters, msgs, cpu, &result[k]) < 0) {
+        printf("%-12s %7lu %9s\n", kIpcNames[k], (unsigned long)size, "n/a");
+        continue;
+      }
+      p50 = BenchHistValue(&result[k].hist, 50) / ns;
+      /* how many times slower than busy polling shmfifo */
+      base_p50 = result[IPC_SHMFIFO].ok ? BenchHistValue(&result[IPC_SHMFIFO].hist, 50) / ns : 0;
+      printf("%-12s %7lu %9.0f %9.0f %9.0f %12.0f %10.1f", kIpcNames[k], (unsigned long)size,
+        p50, BenchHistValue(&result[k].hist, 99) / ns, result[k].hist.max / ns,
+        result[k].rate, result[k].rate * size / 1e6);
+      if (result[IPC_SHMFIFO].ok && base_p50 > 0 && result[k].rate > 0) {
+        printf(" %9.1f %9.1f\n", p50 / base_p50, result[IPC_SHMFIFO].rate / result[k].rate);
+      } else {
+        printf(" %9s %9s\n", "-", "-");
+      }
+      if (factor > 0 && k > IPC_SHMFIFO_WAIT && (!result[IPC_SHMFIFO].ok ||
+          p50 < factor * base_p50 || result[IPC_SHMFIFO].rate < factor * result[k].rate)) {
+        guard_failed = 1;
+      }
+    }
+    fflush(stdout);
+  }
+  if (guard_failed) {
+    printf("# shmfifo is not %.1fx ahead of every kernel transport\n", factor);
+    return 2;
+  }
+  return 0;
+}
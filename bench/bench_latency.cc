@@ -0,0 +1,346 @@
+/*
+ * shmfifo-latency, ping-pong and one-way latency between two pinned
+ * processes through ShmFifoPush/ShmFifoTop/ShmFifoPop, every message
+ * starts with a BenchStamp carrying the sender's tsc
+ *
+ * one-way compares tsc values of two cores, which needs an invariant tsc
+ * kept in sync by the platform, ping-pong only ever reads one core's tsc
+ */
+#include <errno.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "shmfifo.h"
+#include "shmfifo_define.h"
+#include "bench_util.h"
+
+#define LATENCY_ITERS  (100000)
+#define LATENCY_WARMUP (10000)
+#define LATENCY_PATH   "/dev/shm/shmfifo_latency"
+
+enum {
+  LATENCY_PINGPONG = 0x1,
+  LATENCY_ONEWAY   = 0x2,
+};
+
+struct LatencyConf {
+  const char *path;
+  uint32_t    flags;
+  long        iters;
+  long        warmup;
+  int         cpu[2];
+  int         yield;
+};
+
+/* one-way results and the consumer's ack, shared across the fork */
+struct LatencyShared {
+  uint64_t         ack SHMFIFO_CACHELINE_ALIGN;
+  struct BenchHist hist SHMFIFO_CACHELINE_ALIGN;
+};
+
+static void LatencyUsage(const char *prog)
+{
+  fprintf(stderr, "usage: %s [-m pingpong|oneway|all] [-s sizes] [-d depths] [-n iters]\n"
+    "  [-w warmup] [-c cpu0,cpu1] [-f flags] [-p path]\n"
+    "  -s  message sizes, default 16,64,256,1k,4k\n"
+    "  -d  fifo depths in messages, default 64,1k\n"
+    "  -n  measured round trips or messages per point, default %d\n"
+    "  -w  unmeasured messages before each point, default %d\n"
+    "  -c  cpus of the two processes, default 0,1\n"
+    "  -f  ShmFifoAttr flags of both fifos, e.g. 0x1 for DIRECT, 0x800 for INLINE\n"
+    "  -p  fifo file prefix, default %s\n", prog, LATENCY_ITERS, LATENCY_WARMUP,
+    LATENCY_PATH);
+}
+
+static struct ShmFifo *LatencyOpen(const struct LatencyConf *conf, const char *name,
+  size_t msg_size, size_t depth, int create)
+{
+  struct ShmFifoAttr attr;
+  char               path[256];
+
+  snprintf(path, sizeof(path), "%s.%s", conf->path, name);
+  if (create) {
+    unlink(path);
+  }
+  ShmFifoAttrInit(&attr);
+  attr.flags = conf->flags;
+  return ShmFifoOpenAttr(path, msg_size, depth, &attr);
+}
+
+static void LatencyUnlink(const struct LatencyConf *conf, const char *name)
+{
+  char path[256];
+
+  snprintf(path, sizeof(path), "%s.%s", conf->path, name);
+  unlink(path);
+}
+
+static const struct BenchStamp *LatencyTop(struct ShmFifo *fifo, int yield)
+{
+  const struct BenchStamp *stamp;
+  size_t                   size;
+
+  while (!(stamp = (const struct BenchStamp *)ShmFifoTop(fifo, &size))) {
+    BenchRelax(yield);
+  }
+  return stamp;
+}
+
+static void LatencyPush(struct ShmFifo *fifo, const char *buf, size_t size, int yield)
+{
+  while (ShmFifoPush(fifo, buf, size) <= 0) {
+    BenchRelax(yield);
+  }
+}
+
+/* echo side of ping-pong, sends every ping back unchanged */
+static int LatencyEcho(const struct LatencyConf *conf, size_t size, size_t depth)
+{
+  struct ShmFifo          *ping = LatencyOpen(conf, "ping", size, depth, 0);
+  struct ShmFifo          *pong = LatencyOpen(conf, "pong", size, depth, 0);
+  const struct BenchStamp *stamp;
+  uint64_t                 seq;
+
+  if (!ping || !pong) {
+    return 1;
+  }
+  BenchPinCpu(conf->cpu[1]);
+  do {
+    stamp = LatencyTop(ping, conf->yield);
+    seq = stamp->seq;
+    LatencyPush(pong, (const char *)stamp, size, conf->yield);
+    ShmFifoPop(ping);
+  } while (seq != BENCH_SEQ_STOP);
+  ShmFifoClose(ping);
+  ShmFifoClose(pong);
+  return 0;
+}
+
+static int LatencyPingPong(const struct LatencyConf *conf, size_t size, size_t depth,
+  struct BenchHist *hist)
+{
+  struct ShmFifo    *ping = LatencyOpen(conf, "ping", size, depth, 1);
+  struct ShmFifo    *pong = LatencyOpen(conf, "pong", size, depth, 1);
+  struct BenchStamp *stamp;
+  char              *buf;
+  uint64_t           sent;
+  pid_t              pid;
+  long               i;
+  int                status;
+
+  if (!ping || !pong) {
+    return -1;
+  }
+  pid = fork();
+  if (pid == 0) {
+    _exit(LatencyEcho(conf, size, depth));
+  }
+  BenchPinCpu(conf->cpu[0]);
+  buf = (char *)calloc(1, size);
+  stamp = (struct BenchStamp *)buf;
+  for (i = 0; i < conf->warmup + conf->iters; ++i) {
+    stamp->seq = i;
+    stamp->tsc = BenchTsc();
+    LatencyPush(ping, buf, size, conf->yield);
+    sent = LatencyTop(pong, conf->yield)->tsc;
+    if (i >= conf->warmup) {
+      BenchHistRecord(hist, BenchTsc() - sent);
+    }
+    ShmFifoPop(pong);
+  }
+  stamp->seq = BENCH_SEQ_STOP;
+  LatencyPush(ping, buf, size, conf->yield);
+  waitpid(pid, &status, 0);
+  free(buf);
+  ShmFifoClose(ping);
+  ShmFifoClose(pong);
+  LatencyUnlink(conf, "ping");
+  LatencyUnlink(conf, "pong");
+  return (WIFEXITED(status) && !WEXITSTATUS(status)) ? 0 : -1;
+}
+
+/* one-way consumer, the ack keeps a single message in flight so nothing queues */
+static int LatencyReceive(const struct LatencyConf *conf, size_t size, size_t depth,
+  struct LatencyShared *shared)
+{
+  struct ShmFifo          *fifo = LatencyOpen(conf, "oneway", size, depth, 0);
+  const struct BenchStamp *stamp;
+  uint64_t                 delay;
+  uint64_t                 seq;
+
+  if (!fifo) {
+    return 1;
+  }
+  BenchPinCpu(conf->cpu[1]);
+  for (;;) {
+    stamp = LatencyTop(fifo, conf->yield);
+    delay = BenchTsc() - stamp->tsc;
+    seq = stamp->seq;
+    ShmFifoPop(fifo);
+    if (seq == BENCH_SEQ_STOP) {
+      break;
+    }
+    if ((long)seq >= conf->warmup) {
+      BenchHistRecord(&shared->hist, delay);
+    }
+    __atomic_store_n(&shared->ack, seq + 1, __ATOMIC_RELEASE);
+  }
+  ShmFifoClose(fifo);
+  return 0;
+}
+
+static int LatencyOneWay(const struct LatencyConf *conf, size_t size, size_t depth,
+  struct BenchHist *hist)
+{
+  struct ShmFifo       *fifo = LatencyOpen(conf, "oneway", size, depth, 1);
+  struct LatencyShared *shared;
+  struct BenchStamp    *stamp;
+  char                 *buf;
+  pid_t                 pid;
+  long                  i;
+  int                   status;
+
+  if (!fifo) {
+    return -1;
+  }
+  shared = (struct LatencyShared *)mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE,
+    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (shared == MAP_FAILED) {
+    ShmFifoClose(fifo);
+    return -1;
+  }
+  BenchHistInit(&shared->hist);
+  pid = fork();
+  if (pid == 0) {
+    _exit(LatencyReceive(conf, size, depth, shared));
+  }
+  BenchPinCpu(conf->cpu[0]);
+  buf = (char *)calloc(1, size);
+  stamp = (struct BenchStamp *)buf;
+  for (i = 0; i < conf->warmup + conf->iters; ++i) {
+    stamp->seq = i;
+    stamp->tsc = BenchTsc();
+    LatencyPush(fifo, buf, size, conf->yield);
+    while (__atomic_load_n(&shared->ack, __ATOMIC_ACQUIRE) != (uint64_t)i + 1) {
+      BenchRelax(conf->yield);
+    }
+  }
+  stamp->seq = BENCH_SEQ_STOP;
+  LatencyPush(fifo, buf, size, conf->yield);
+  waitpid(pid, &status, 0);
+  memcpy(hist, &shared->hist, sizeof(*hist));
+  munmap(shared, sizeof(*shared));
+  free(buf);
+  ShmFifoClose(fifo);
+  LatencyUnlink(conf, "oneway");
+  return (WIFEXITED(status) && !WEXITSTATUS(status)) ? 0 : -1;
+}
+
+static void LatencyReport(const char *mode, size_t size, size_t depth,
+  const struct BenchHist *hist)
+{
+  double ns = BenchTscPerNs();
+
+  printf("%-9s %7lu %7lu %9lu %8.0f %8.0f %8.0f %8.0f %8.0f %8.0f %8.0f\n", mode,
+    (unsigned long)size, (unsigned long)depth, (unsigned long)hist->count,
+    hist->min / ns, BenchHistValue(hist, 50) / ns, BenchHistValue(hist, 90) / ns,
+    BenchHistValue(hist, 99) / ns, BenchHistValue(hist, 99.9) / ns,
+    BenchHistValue(hist, 99.99) / ns, hist->max / ns);
+  fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+  static const char  *names[] = {"pingpong", "oneway"};
+  struct LatencyConf  conf;
+  struct BenchHist   *hist;
+  const char         *cpus = NULL;
+  size_t              sizes[BENCH_LIST_MAX] = {16, 64, 256, 1024, 4096};
+  size_t              depths[BENCH_LIST_MAX] = {64, 1024};
+  size_t              size;
+  int                 size_num = 5;
+  int                 depth_num = 2;
+  int                 modes = LATENCY_PINGPONG | LATENCY_ONEWAY;
+  int                 ret = 0;
+  int                 opt;
+  int                 m;
+  int                 s;
+  int                 d;
+
+  memset(&conf, 0, sizeof(conf));
+  conf.path = LATENCY_PATH;
+  conf.iters = LATENCY_ITERS;
+  conf.warmup = LATENCY_WARMUP;
+  while ((opt = getopt(argc, argv, "m:s:d:n:w:c:f:p:h")) != -1) {
+    switch (opt) {
+    case 'm':
+      modes = !strcmp(optarg, "pingpong") ? LATENCY_PINGPONG :
+        !strcmp(optarg, "oneway") ? LATENCY_ONEWAY :
+        !strcmp(optarg, "all") ? LATENCY_PINGPONG | LATENCY_ONEWAY : 0;
+      break;
+    case 's':
+      size_num = BenchParseList(optarg, sizes, BENCH_LIST_MAX);
+      break;
+    case 'd':
+      depth_num = BenchParseList(optarg, depths, BENCH_LIST_MAX);
+      break;
+    case 'n':
+      conf.iters = atol(optarg);
+      break;
+    case 'w':
+      conf.warmup = atol(optarg);
+      break;
+    case 'c':
+      cpus = optarg;
+      break;
+    case 'f':
+      conf.flags = strtoul(optarg, NULL, 0);
+      break;
+    case 'p':
+      conf.path = optarg;
+      break;
+    default:
+      LatencyUsage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc || !modes || size_num <= 0 || depth_num <= 0 || conf.iters <= 0 ||
+      conf.warmup < 0 || BenchParseCpus(cpus, &conf.cpu[0], &conf.cpu[1]) < 0 ||
+      conf.cpu[0] < 0 || conf.cpu[1] < 0 || conf.cpu[0] >= BenchCpuCount() ||
+      conf.cpu[1] >= BenchCpuCount()) {
+    LatencyUsage(argv[0]);
+    return 1;
+  }
+  conf.yield = conf.cpu[0] == conf.cpu[1];
+  hist = (struct BenchHist *)malloc(sizeof(*hist));
+  printf("# cpus %d,%d  flags %#x  tsc %.3f GHz%s\n", conf.cpu[0], conf.cpu[1], conf.flags,
+    BenchTscPerNs(), conf.yield ? "  same cpu, spinning yields" : "");
+  printf("%-9s %7s %7s %9s %8s %8s %8s %8s %8s %8s %8s  (ns)\n", "mode", "size", "depth",
+    "count", "min", "p50", "p90", "p99", "p99.9", "p99.99", "max");
+  for (m = 0; m < 2; ++m) {
+    if (!(modes & (1 << m))) {
+      continue;
+    }
+    for (s = 0; s < size_num; ++s) {
+      size = sizes[s] < sizeof(struct BenchStamp) ? sizeof(struct BenchStamp) : sizes[s];
+      for (d = 0; d < depth_num; ++d) {
+        BenchHistInit(hist);
+        if ((m ? LatencyOneWay : LatencyPingPong)(&conf, size, depths[d], hist) < 0) {
+          fprintf(stderr, "%s size %lu depth %lu failed\n", names[m], (unsigned long)size,
+            (unsigned long)depths[d]);
+          ret = 1;
+          continue;
+        }
+        LatencyReport(names[m], size, depths[d], hist);
+      }
+    }
+  }
+  free(hist);
+  return ret;
+}
@@ -0,0 +1,589 @@
+/*
+ * shmfifo-throughput, sustained rate of 1..N producer and consumer
+ * processes over a matrix of message sizes and batch sizes
+ *
+ * fifo drives ShmFifoPush/ShmFifoPushBurst and ShmFifoPopData, or
+ * ShmFifoTopBurst/ShmFifoPopBulk for a single consumer with batches, ring
+ * moves bare descriptors through ShmFifoRingEnqueueBurst/DequeueBurst so
+ * changes to shmfifo_ring.h can be told apart from the copies around them
+ */
+#include <errno.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+
+#include "shmfifo.h"
+#include "shmfifo_ring.h"
+#include "shmfifo_define.h"
+#include "bench_util.h"
+
+#define THROUGHPUT_MS      (1000)
+#define THROUGHPUT_DEPTH   (1024)
+#define THROUGHPUT_WORKERS (64)
+#define THROUGHPUT_PATH    "/dev/shm/shmfifo_throughput"
+
+enum {
+  THROUGHPUT_FIFO = 0x1,
+  THROUGHPUT_RING = 0x2,
+};
+
+enum {
+  THROUGHPUT_TABLE = 0,
+  THROUGHPUT_CSV,
+  THROUGHPUT_JSON,
+};
+
+struct ThroughputConf {
+  const char *path;
+  const char *label;
+  uint32_t    flags;
+  size_t      depth;
+  long        ms;
+  int         cpus[THROUGHPUT_WORKERS];
+  int         cpu_num;
+  int         perf;
+};
+
+/* one point of the matrix */
+struct ThroughputPoint {
+  int      mode;
+  size_t   size;
+  size_t   batch;
+  int      prod_num;
+  int      cons_num;
+  uint32_t flags;
+  uint64_t msgs;
+  double   secs;
+  uint64_t cycles;
+  uint64_t misses;
+  int      perf;
+};
+
+/* written by one worker only */
+struct ThroughputWorker {
+  uint64_t msgs;
+  uint64_t end_ns;
+  uint64_t cycles;
+  uint64_t misses;
+  int      perf;
+} SHMFIFO_CACHELINE_ALIGN;
+
+/* control block shared across the forks, the ring of ring mode follows it */
+struct ThroughputShared {
+  uint32_t                ready SHMFIFO_CACHELINE_ALIGN;
+  uint32_t                start;
+  uint32_t                stop;
+  uint32_t                prod_done;
+  struct ThroughputWorker worker[THROUGHPUT_WORKERS];
+};
+
+static void ThroughputUsage(const char *prog)
+{
+  fprintf(stderr, "usage: %s [-m fifo|ring|all] [-s sizes] [-b batches] [-P producers]\n"
+    "  [-C consumers] [-t ms] [-d depth] [-c cpus] [-f flags] [-e] [-o file] [-l label]\n"
+    "  [-p path]\n"
+    "  -s  message sizes, default 8,64,512,4k,64k, ring mode ignores them\n"
+    "  -b  batch sizes up to %d, default 1,8,64,256\n"
+    "  -P  producer counts, default 1\n"
+    "  -C  consumer counts, default 1\n"
+    "  -t  run time of every point in ms, default %d\n"
+    "  -d  fifo depth in messages, default %d\n"
+    "  -c  cpus to pin producers then consumers to round robin, default not pinned\n"
+    "  -f  extra ShmFifoAttr flags, MP/MC follow the producer/consumer counts\n"
+    "  -e  count cycles and cache misses per message with perf_event_open\n"
+    "  -o  also write the results to file, .json for JSON, otherwise CSV\n"
+    "  -l  label of the run written to every CSV/JSON record, e.g. the commit\n"
+    "  -p  fifo file, default %s\n", prog, SHMFIFO_BULK_MAX, THROUGHPUT_MS,
+    THROUGHPUT_DEPTH, THROUGHPUT_PATH);
+}
+
+static uint64_t ThroughputNs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t ThroughputFlags(const struct ThroughputConf *conf, int prod_num, int cons_num)
+{
+  return conf->flags | (prod_num > 1 ? SHMFIFO_FLAG_MP : 0) |
+    (cons_num > 1 ? SHMFIFO_FLAG_MC : 0);
+}
+
+/* every pushed message was popped once the producers are done */
+static int ThroughputDrained(const struct ThroughputShared *shared, int prod_num,
+  int cons_num)
+{
+  uint64_t pushed = 0;
+  uint64_t popped = 0;
+  int      i;
+
+  if (__atomic_load_n(&shared->prod_done, __ATOMIC_ACQUIRE) != (uint32_t)prod_num) {
+    return 0;
+  }
+  for (i = 0; i < prod_num; ++i) {
+    pushed += __atomic_load_n(&shared->worker[i].msgs, __ATOMIC_RELAXED);
+  }
+  for (i = 0; i < cons_num; ++i) {
+    popped += __atomic_load_n(&shared->worker[prod_num + i].msgs, __ATOMIC_RELAXED);
+  }
+  return pushed == popped;
+}
+
+static void ThroughputCount(struct ThroughputWorker *worker, uint64_t n)
+{
+  __atomic_store_n(&worker->msgs, worker->msgs + n, __ATOMIC_RELAXED);
+}
+
+static void ThroughputProduce(struct ThroughputShared *shared, struct ThroughputWorker *worker,
+  struct ShmFifo *fifo, struct ShmFifoRing *ring, const struct ThroughputPoint *point,
+  int yield)
+{
+  struct ShmFifoObj obj_list[SHMFIFO_BULK_MAX];
+  struct iovec      iov[SHMFIFO_BULK_MAX];
+  char             *buf = (char *)calloc(1, point->size);
+  ssize_t           n;
+  size_t            i;
+
+  memset(obj_list, 0, sizeof(obj_list));
+  for (i = 0; i < point->batch; ++i) {
+    iov[i].iov_base = buf;
+    iov[i].iov_len = point->size;
+  }
+  while (!__atomic_load_n(&shared->stop, __ATOMIC_RELAXED)) {
+    if (ring) {
+      n = ShmFifoRingEnqueueBurst(ring, obj_list, point->batch, NULL);
+    } else if (point->batch == 1) {
+      n = ShmFifoPush(fifo, buf, point->size) > 0;
+    } else {
+      n = ShmFifoPushBurst(fifo, iov, point->batch);
+    }
+    if (n > 0) {
+      ThroughputCount(worker, n);
+    } else {
+      BenchRelax(yield);
+    }
+  }
+  free(buf);
+}
+
+static void ThroughputConsume(struct ThroughputShared *shared, struct ThroughputWorker *worker,
+  struct ShmFifo *fifo, struct ShmFifoRing *ring, const struct ThroughputPoint *point,
+  int yield)
+{
+  struct ShmFifoObj obj_list[SHMFIFO_BULK_MAX];
+  struct iovec      iov[SHMFIFO_BULK_MAX];
+  char             *buf = (char *)malloc(point->size);
+  ssize_t           n;
+  ssize_t           i;
+
+  for (;;) {
+    if (ring) {
+      n = ShmFifoRingDequeueBurst(ring, obj_list, point->batch, NULL);
+    } else if (point->batch == 1 || point->cons_num > 1) {
+      n = ShmFifoPopData(fifo, buf, point->size) > 0;
+    } else {
+      n = ShmFifoTopBurst(fifo, iov, point->batch);
+      for (i = 0; i < n; ++i) {
+        memcpy(buf, iov[i].iov_base, iov[i].iov_len);
+      }
+      if (n > 0) {
+        ShmFifoPopBulk(fifo, n);
+      }
+    }
+    if (n > 0) {
+      ThroughputCount(worker, n);
+    } else if (ThroughputDrained(shared, point->prod_num, point->cons_num)) {
+      break;
+    } else {
+      BenchRelax(yield);
+    }
+  }
+  free(buf);
+}
+
+static int ThroughputWork(const struct ThroughputConf *conf, struct ThroughputShared *shared,
+  struct ShmFifoRing *ring, const struct ThroughputPoint *point, int idx, int yield)
+{
+  struct ThroughputWorker *worker = &shared->worker[idx];
+  struct ShmFifo          *fifo = NULL;
+  struct ShmFifoAttr       attr;
+  struct BenchPerf         perf;
+
+  if (conf->cpu_num) {
+    BenchPinCpu(conf->cpus[idx % conf->cpu_num]);
+  }
+  if (!ring) {
+    ShmFifoAttrInit(&attr);
+    attr.flags = point->flags;
+    fifo = ShmFifoOpenAttr(conf->path, point->size, conf->depth, &attr);
+    if (!fifo) {
+      return 1;
+    }
+  }
+  worker->perf = conf->perf && BenchPerfOpen(&perf) == 0;
+  __atomic_fetch_add(&shared->ready, 1, __ATOMIC_RELEASE);
+  while (!__atomic_load_n(&shared->start, __ATOMIC_ACQUIRE)) {
+    BenchRelax(1);
+  }
+  if (worker->perf) {
+    BenchPerfStart(&perf);
+  }
+  if (idx < point->prod_num) {
+    ThroughputProduce(shared, worker, fifo, ring, point, yield);
+    __atomic_fetch_add(&shared->prod_done, 1, __ATOMIC_RELEASE);
+  } else {
+    ThroughputConsume(shared, worker, fifo, ring, point, yield);
+  }
+  worker->end_ns = ThroughputNs();
+  if (worker->perf) {
+    BenchPerfStop(&perf);
+    worker->cycles = perf.cycles;
+    worker->misses = perf.misses;
+    BenchPerfClose(&perf);
+  }
+  if (fifo) {
+    ShmFifoClose(fifo);
+  }
+  return 0;
+}
+
+static int ThroughputRun(const struct ThroughputConf *conf, struct ThroughputPoint *point)
+{
+  struct ThroughputShared *shared;
+  struct ShmFifoRing      *ring = NULL;
+  struct ShmFifo          *fifo = NULL;
+  struct ShmFifoAttr       attr;
+  struct timespec          nap;
+  size_t                   map_size;
+  uint32_t                 ring_count = 1;
+  uint64_t                 start_ns;
+  uint64_t                 end_ns = 0;
+  pid_t                    pid[THROUGHPUT_WORKERS];
+  int                      workers = point->prod_num + point->cons_num;
+  int                      yield;
+  int                      ret = 0;
+  int                      status;
+  int                      i;
+
+  map_size = sizeof(*shared);
+  if (point->mode == THROUGHPUT_RING) {
+    while (ring_count < conf->depth) {
+      ring_count <<= 1;
+    }
+    map_size += sizeof(struct ShmFifoRing) + ring_count * sizeof(struct ShmFifoObj);
+  } else {
+    /* the parent formats the fifo so the workers only attach */
+    unlink(conf->path);
+    ShmFifoAttrInit(&attr);
+    attr.flags = point->flags;
+    fifo = ShmFifoOpenAttr(conf->path, point->size, conf->depth, &attr);
+    if (!fifo) {
+      return -1;
+    }
+  }
+  shared = (struct ThroughputShared *)mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (shared == MAP_FAILED) {
+    ret = -1;
+    goto out_fifo;
+  }
+  if (point->mode == THROUGHPUT_RING) {
+    ring = (struct ShmFifoRing *)&shared[1];
+    ShmFifoRingInit(ring, ring_count,
+      (point->prod_num > 1 ? 0 : SHMFIFO_RING_SP_ENQ) |
+      (point->cons_num > 1 ? 0 : SHMFIFO_RING_SC_DEQ));
+  }
+  yield = workers > (conf->cpu_num ? conf->cpu_num : BenchCpuCount());
+  for (i = 0; i < workers; ++i) {
+    pid[i] = fork();
+    if (pid[i] == 0) {
+      _exit(ThroughputWork(conf, shared, ring, point, i, yield));
+    }
+  }
+  while (__atomic_load_n(&shared->ready, __ATOMIC_ACQUIRE) != (uint32_t)workers) {
+    for (i = 0; i < workers; ++i) {
+      if (waitpid(pid[i], &status, WNOHANG) == pid[i]) {
+        fprintf(stderr, "worker %d exited before the start\n", i);
+        __atomic_store_n(&shared->stop, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&shared->start, 1, __ATOMIC_RELEASE);
+        ret = -1;
+        break;
+      }
+    }
+    if (ret < 0) {
+      break;
+    }
+    usleep(1000);
+  }
+  start_ns = ThroughputNs();
+  __atomic_store_n(&shared->start, 1, __ATOMIC_RELEASE);
+  nap.tv_sec = conf->ms / 1000;
+  nap.tv_nsec = (conf->ms % 1000) * 1000000L;
+  if (!ret) {
+    while (nanosleep(&nap, &nap) < 0 && errno == EINTR);
+  }
+  __atomic_store_n(&shared->stop, 1, __ATOMIC_RELAXED);
+  for (i = 0; i < workers; ++i) {
+    if (waitpid(pid[i], &status, 0) != pid[i] || !WIFEXITED(status) || WEXITSTATUS(status)) {
+      ret = -1;
+    }
+  }
+  point->msgs = 0;
+  point->cycles = 0;
+  point->misses = 0;
+  point->perf = conf->perf;
+  for (i = 0; i < workers; ++i) {
+    if (i >= point->prod_num) {
+      point->msgs += shared->worker[i].msgs;
+    }
+    if (shared->worker[i].end_ns > end_ns) {
+      end_ns = shared->worker[i].end_ns;
+    }
+    point->cycles += shared->worker[i].cycles;
+    point->misses += shared->worker[i].misses;
+    point->perf = point->perf && shared->worker[i].perf;
+  }
+  point->secs = end_ns > start_ns ? (end_ns - start_ns) / 1e9 : 0;
+  munmap(shared, map_size);
+
+out_fifo:
+  if (fifo) {
+    ShmFifoClose(fifo);
+    unlink(conf->path);
+  }
+  return ret;
+}
+
+static const char *ThroughputModeName(int mode)
+{
+  return mode == THROUGHPUT_RING ? "ring" : "fifo";
+}
+
+static void ThroughputPrint(FILE *out, int format, const char *label,
+  const struct ThroughputPoint *point, int first)
+{
+  double rate = point->secs > 0 ? point->msgs / point->secs : 0;
+  double gbps = rate * point->size / 1e9;
+  double cycles = point->msgs ? (double)point->cycles / point->msgs : 0;
+  double misses = point->msgs ? (double)point->misses / point->msgs : 0;
+
+  switch (format) {
+  case THROUGHPUT_CSV:
+    if (first) {
+      fprintf(out, "label,mode,size,batch,producers,consumers,flags,msgs,secs,"
+        "msgs_per_sec,gb_per_sec,cycles_per_msg,misses_per_msg\n");
+    }
+    fprintf(out, "%s,%s,%lu,%lu,%d,%d,%#x,%lu,%.6f,%.0f,%.6f,", label,
+      ThroughputModeName(point->mode), (unsigned long)point->size,
+      (unsigned long)point->batch, point->prod_num, point->cons_num, point->flags,
+      (unsigned long)point->msgs, point->secs, rate, gbps);
+    if (point->perf) {
+      fprintf(out, "%.2f,%.4f\n", cycles, misses);
+    } else {
+      fprintf(out, ",\n");
+    }
+    break;
+  case THROUGHPUT_JSON:
+    fprintf(out, "%s  {\"label\": \"%s\", \"mode\": \"%s\", \"size\": %lu, \"batch\": %lu, "
+      "\"producers\": %d, \"consumers\": %d, \"flags\": %u, \"msgs\": %lu, \"secs\": %.6f, "
+      "\"msgs_per_sec\": %.0f, \"gb_per_sec\": %.6f", first ? "" : ",\n", label,
+      ThroughputModeName(point->mode), (unsigned long)point->size,
+      (unsigned long)point->batch, point->prod_num, point->cons_num, point->flags,
+      (unsigned long)point->msgs, point->secs, rate, gbps);
+    if (point->perf) {
+      fprintf(out, ", \"cycles_per_msg\": %.2f, \"misses_per_msg\": %.4f", cycles, misses);
+    }
+    fprintf(out, "}");
+    break;
+  default:
+    if (first) {
+      fprintf(out, "%-5s %7s %6s %4s %4s %7s %12s %10s %9s %9s\n", "mode", "size", "batch",
+        "prod", "cons", "flags", "msgs/s", "GB/s", "cyc/msg", "miss/msg");
+    }
+    fprintf(out, "%-5s %7lu %6lu %4d %4d %#7x %12.0f %10.3f", ThroughputModeName(point->mode),
+      (unsigned long)point->size, (unsigned long)point->batch, point->prod_num,
+      point->cons_num, point->flags, rate, gbps);
+    if (point->perf) {
+      fprintf(out, " %9.1f %9.3f\n", cycles, misses);
+    } else {
+      fprintf(out, " %9s %9s\n", "-", "-");
+    }
+    break;
+  }
+  fflush(out);
+}
+
+int main(int argc, char *argv[])
+{
+  struct ThroughputConf  conf;
+  struct ThroughputPoint point;
+  const char            *out_path = NULL;
+  FILE                  *out = NULL;
+  size_t                 sizes[BENCH_LIST_MAX] = {8, 64, 512, 4096, 65536};
+  size_t                 batches[BENCH_LIST_MAX] = {1, 8, 64, 256};
+  size_t                 prods[BENCH_LIST_MAX] = {1};
+  size_t                 conss[BENCH_LIST_MAX] = {1};
+  size_t                 cpus[BENCH_LIST_MAX];
+  int                    size_num = 5;
+  int                    batch_num = 4;
+  int                    prod_num = 1;
+  int                    cons_num = 1;
+  int                    modes = THROUGHPUT_FIFO | THROUGHPUT_RING;
+  int                    format = THROUGHPUT_TABLE;
+  int                    first = 1;
+  int                    ret = 0;
+  int                    opt;
+  int                    m;
+  int                    s;
+  int                    b;
+  int                    p;
+  int                    c;
+  int                    i;
+
+  memset(&conf, 0, sizeof(conf));
+  conf.path = THROUGHPUT_PATH;
+  conf.label = "";
+  conf.depth = THROUGHPUT_DEPTH;
+  conf.ms = THROUGHPUT_MS;
+  while ((opt = getopt(argc, argv, "m:s:b:P:C:t:d:c:f:eo:l:p:h")) != -1) {
+    switch (opt) {
+    case 'm':
+      modes = !strcmp(optarg, "fifo") ? THROUGHPUT_FIFO :
+        !strcmp(optarg, "ring") ? THROUGHPUT_RING :
+        !strcmp(optarg, "all") ? THROUGHPUT_FIFO | THROUGHPUT_RING : 0;
+      break;
+    case 's':
+      size_num = BenchParseList(optarg, sizes, BENCH_LIST_MAX);
+      break;
+    case 'b':
+      batch_num = BenchParseList(optarg, batches, BENCH_LIST_MAX);
+      break;
+    case 'P':
+      prod_num = BenchParseList(optarg, prods, BENCH_LIST_MAX);
+      break;
+    case 'C':
+      cons_num = BenchParseList(optarg, conss, BENCH_LIST_MAX);
+      break;
+    case 't':
+      conf.ms = atol(optarg);
+      break;
+    case 'd':
+      conf.depth = strtoul(optarg, NULL, 0);
+      break;
+    case 'c':
+      conf.cpu_num = BenchParseList(optarg, cpus, BENCH_LIST_MAX);
+      for (i = 0; i < conf.cpu_num; ++i) {
+        conf.cpus[i] = (int)cpus[i];
+      }
+      break;
+    case 'f':
+      conf.flags = strtoul(optarg, NULL, 0);
+      break;
+    case 'e':
+      conf.perf = 1;
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    case 'l':
+      conf.label = optarg;
+      break;
+    case 'p':
+      conf.path = optarg;
+      break;
+    default:
+      ThroughputUsage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc || !modes || size_num <= 0 || batch_num <= 0 || prod_num <= 0 ||
+      cons_num <= 0 || conf.cpu_num < 0 || conf.ms <= 0 || conf.depth < 2) {
+    ThroughputUsage(argv[0]);
+    return 1;
+  }
+  for (i = 0; i < batch_num; ++i) {
+    if (!batches[i] || batches[i] > SHMFIFO_BULK_MAX) {
+      ThroughputUsage(argv[0]);
+      return 1;
+    }
+  }
+  for (p = 0; p < prod_num; ++p) {
+    for (c = 0; c < cons_num; ++c) {
+      if (!prods[p] || !conss[c] || prods[p] + conss[c] > THROUGHPUT_WORKERS) {
+        ThroughputUsage(argv[0]);
+        return 1;
+      }
+    }
+  }
+  if (out_path) {
+    out = fopen(out_path, "w");
+    if (!out) {
+      fprintf(stderr, "open %s failed, %s\n", out_path, strerror(errno));
+      return 1;
+    }
+    s = strlen(out_path);
+    format = (s > 5 && !strcmp(out_path + s - 5, ".json")) ? THROUGHPUT_JSON : THROUGHPUT_CSV;
+    if (format == THROUGHPUT_JSON) {
+      fprintf(out, "[\n");
+    }
+  }
+  if (conf.perf) {
+    struct BenchPerf perf;
+
+    if (BenchPerfOpen(&perf) < 0) {
+      fprintf(stderr, "perf_event_open failed, %s, no cycle or cache miss counts\n",
+        strerror(errno));
+    }
+    BenchPerfClose(&perf);
+  }
+  /* the ring only moves descriptors, the message size does not apply to it */
+  for (m = THROUGHPUT_FIFO; m <= THROUGHPUT_RING; m <<= 1) {
+    if (!(modes & m)) {
+      continue;
+    }
+    for (p = 0; p < prod_num; ++p) {
+      for (c = 0; c < cons_num; ++c) {
+        for (s = 0; s < (m == THROUGHPUT_RING ? 1 : size_num); ++s) {
+          for (b = 0; b < batch_num; ++b) {
+            memset(&point, 0, sizeof(point));
+            point.mode = m;
+            point.size = m == THROUGHPUT_RING ? sizeof(struct ShmFifoObj) : sizes[s];
+            point.batch = batches[b];
+            point.prod_num = (int)prods[p];
+            point.cons_num = (int)conss[c];
+            point.flags = m == THROUGHPUT_RING ? 0 :
+              ThroughputFlags(&conf, point.prod_num, point.cons_num);
+            if (ThroughputRun(&conf, &point) < 0) {
+              fprintf(stderr, "%s size %lu batch %lu %dx%d failed\n", ThroughputModeName(m),
+                (unsigned long)point.size, (unsigned long)point.batch, point.prod_num,
+                point.cons_num);
+              ret = 1;
+              continue;
+            }
+            ThroughputPrint(stdout, THROUGHPUT_TABLE, conf.label, &point, first);
+            if (out) {
+              ThroughputPrint(out, format, conf.label, &point, first);
+            }
+            first = 0;
+          }
+        }
+      }
+    }
+  }
+  if (out) {
+    if (format == THROUGHPUT_JSON) {
+      fprintf(out, "\n]\n");
+    }
+    fclose(out);
+  }
+  return ret;
+}
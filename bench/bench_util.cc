@@ -0,0 +1,207 @@
+#include "bench_util.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+void BenchHistInit(struct BenchHist *hist)
+{
+  memset(hist, 0, sizeof(*hist));
+  hist->min = ~0ULL;
+}
+
+uint64_t BenchHistValue(const struct BenchHist *hist, double pct)
+{
+  uint64_t rank = (uint64_t)(hist->count * pct / 100.0);
+  uint64_t seen = 0;
+  uint64_t top;
+  uint32_t shift;
+  uint32_t i;
+
+  if (!hist->count) {
+    return 0;
+  }
+  if (rank >= hist->count) {
+    return hist->max;
+  }
+  for (i = 0; i < BENCH_HIST_BUCKETS; ++i) {
+    seen += hist->bucket[i];
+    if (seen > rank) {
+      break;
+    }
+  }
+  if (i < 2 * BENCH_HIST_SUB) {
+    top = i;
+  } else {
+    shift = i / BENCH_HIST_SUB - 1;
+    top = (((uint64_t)(i - shift * BENCH_HIST_SUB) + 1) << shift) - 1;
+  }
+  return top < hist->max ? top : hist->max;
+}
+
+static uint64_t BenchMonoNs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+double BenchTscPerNs(void)
+{
+  static double   ratio;
+  struct timespec nap = {0, 50 * 1000 * 1000};
+  uint64_t        ns0;
+  uint64_t        ns1;
+  uint64_t        tsc0;
+  uint64_t        tsc1;
+
+  if (ratio > 0) {
+    return ratio;
+  }
+  ns0 = BenchMonoNs();
+  tsc0 = BenchTsc();
+  nanosleep(&nap, NULL);
+  ns1 = BenchMonoNs();
+  tsc1 = BenchTsc();
+  ratio = (double)(tsc1 - tsc0) / (double)(ns1 - ns0);
+  return ratio;
+}
+
+int BenchPinCpu(int cpu)
+{
+  cpu_set_t set;
+
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return sched_setaffinity(0, sizeof(set), &set);
+}
+
+int BenchCpuCount(void)
+{
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+  return n > 0 ? (int)n : 1;
+}
+
+int BenchParseList(const char *str, size_t *list, int max)
+{
+  const char *p = str;
+  char       *end;
+  int         n = 0;
+
+  while (*p) {
+    if (n == max) {
+      return -1;
+    }
+    list[n] = strtoull(p, &end, 0);
+    if (end == p) {
+      return -1;
+    }
+    if (*end == 'k' || *end == 'K') {
+      list[n] <<= 10;
+      ++end;
+    } else if (*end == 'm' || *end == 'M') {
+      list[n] <<= 20;
+      ++end;
+    }
+    ++n;
+    if (*end == ',') {
+      ++end;
+    } else if (*end) {
+      return -1;
+    }
+    p = end;
+  }
+  return n;
+}
+
+int BenchParseCpus(const char *str, int *cpu0, int *cpu1)
+{
+  char *end;
+
+  if (!str) {
+    *cpu0 = 0;
+    *cpu1 = BenchCpuCount() > 1 ? 1 : 0;
+    return 0;
+  }
+  *cpu0 = (int)strtol(str, &end, 0);
+  if (end == str || *end != ',') {
+    return -1;
+  }
+  str = end + 1;
+  *cpu1 = (int)strtol(str, &end, 0);
+  if (end == str || *end) {
+    return -1;
+  }
+  return 0;
+}
+
+static int BenchPerfEvent(uint64_t config, int group)
+{
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = config;
+  attr.disabled = group < 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+int BenchPerfOpen(struct BenchPerf *perf)
+{
+  memset(perf, 0, sizeof(*perf));
+  perf->miss_fd = -1;
+  perf->fd = BenchPerfEvent(PERF_COUNT_HW_CPU_CYCLES, -1);
+  if (perf->fd < 0) {
+    return -1;
+  }
+  perf->miss_fd = BenchPerfEvent(PERF_COUNT_HW_CACHE_MISSES, perf->fd);
+  if (perf->miss_fd < 0) {
+    BenchPerfClose(perf);
+    return -1;
+  }
+  return 0;
+}
+
+void BenchPerfStart(struct BenchPerf *perf)
+{
+  if (perf->fd >= 0) {
+    ioctl(perf->fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(perf->fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+}
+
+void BenchPerfStop(struct BenchPerf *perf)
+{
+  uint64_t value[3];
+
+  if (perf->fd < 0) {
+    return;
+  }
+  ioctl(perf->fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  if (read(perf->fd, value, sizeof(value)) == (ssize_t)sizeof(value)) {
+    perf->cycles = value[1];
+    perf->misses = value[2];
+  }
+}
+
+void BenchPerfClose(struct BenchPerf *perf)
+{
+  if (perf->miss_fd >= 0) {
+    close(perf->miss_fd);
+    perf->miss_fd = -1;
+  }
+  if (perf->fd >= 0) {
+    close(perf->fd);
+    perf->fd = -1;
+  }
+}
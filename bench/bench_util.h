@@ -0,0 +1,114 @@
+#ifndef BENCH_UTIL_H_
+#define BENCH_UTIL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sched.h>
+#include <x86intrin.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * log linear histogram like HdrHistogram, values below 2 * BENCH_HIST_SUB
+ * are exact and every power of two above is cut into BENCH_HIST_SUB
+ * buckets, so any recorded value is off by less than 1 / BENCH_HIST_SUB
+ */
+#define BENCH_HIST_SUB_BITS (5)
+#define BENCH_HIST_SUB      (1U << BENCH_HIST_SUB_BITS)
+#define BENCH_HIST_BUCKETS  ((64 - BENCH_HIST_SUB_BITS + 1) * BENCH_HIST_SUB)
+
+#define BENCH_LIST_MAX (32)
+
+struct BenchHist {
+  uint64_t count;
+  uint64_t min;
+  uint64_t max;
+  uint64_t sum;
+  uint64_t bucket[BENCH_HIST_BUCKETS];
+};
+
+/* message prefix written by the sender, size and payload follow it */
+struct BenchStamp {
+  uint64_t tsc;
+  uint64_t seq;
+};
+
+#define BENCH_SEQ_STOP (~0ULL)
+
+/* cycles and cache misses of the calling process, user space only */
+struct BenchPerf {
+  int      fd;
+  int      miss_fd;
+  uint64_t cycles;
+  uint64_t misses;
+};
+
+void BenchHistInit(struct BenchHist *hist);
+/* highest value of the bucket holding the pct percentile, capped at max */
+uint64_t BenchHistValue(const struct BenchHist *hist, double pct);
+
+/* tsc ticks per nanosecond, measured against CLOCK_MONOTONIC once */
+double BenchTscPerNs(void);
+int BenchPinCpu(int cpu);
+int BenchCpuCount(void);
+/* comma separated sizes with optional k/m suffix, returns the count or -1 */
+int BenchParseList(const char *str, size_t *list, int max);
+/* pair of cpus "a,b", both default to distinct cpus when there are two */
+int BenchParseCpus(const char *str, int *cpu0, int *cpu1);
+/* -1 when perf_event_open is not allowed, the counters then stay 0 */
+int BenchPerfOpen(struct BenchPerf *perf);
+void BenchPerfStart(struct BenchPerf *perf);
+void BenchPerfStop(struct BenchPerf *perf);
+void BenchPerfClose(struct BenchPerf *perf);
+
+static inline uint32_t
+BenchHistIndex(uint64_t v)
+{
+  uint32_t shift;
+
+  if (v < 2 * BENCH_HIST_SUB) {
+    return (uint32_t)v;
+  }
+  shift = 63 - __builtin_clzll(v) - BENCH_HIST_SUB_BITS;
+  return shift * BENCH_HIST_SUB + (uint32_t)(v >> shift);
+}
+
+static inline void
+BenchHistRecord(struct BenchHist *hist, uint64_t v)
+{
+  hist->bucket[BenchHistIndex(v)]++;
+  hist->count++;
+  hist->sum += v;
+  if (v < hist->min) {
+    hist->min = v;
+  }
+  if (v > hist->max) {
+    hist->max = v;
+  }
+}
+
+/* stamps are taken after the earlier loads and stores retired */
+static inline uint64_t
+BenchTsc(void)
+{
+  _mm_lfence();
+  return __rdtsc();
+}
+
+/* two spinning processes on one cpu have to give the core up to make progress */
+static inline void
+BenchRelax(int yield)
+{
+  if (yield) {
+    sched_yield();
+  } else {
+    _mm_pause();
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <unistd.h>
+#include <sys/uio.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -12,12 +13,104 @@ struct ShmFifo;
 #define SHMFIFO_MODE_READ  (1)
 #define SHMFIFO_MODE_WRITE (2)
 
+#define SHMFIFO_BULK_MAX   (256)
+#define SHMFIFO_SPIN_CYCLES (20000)
+#define SHMFIFO_CLASS_MAX  (4)
+
+#define SHMFIFO_FLAG_DIRECT (0x0001)
+#define SHMFIFO_FLAG_MP     (0x0002)
+#define SHMFIFO_FLAG_MC     (0x0004)
+#define SHMFIFO_FLAG_RTS    (0x0008)
+#define SHMFIFO_FLAG_WAIT   (0x0010)
+#define SHMFIFO_FLAG_EVENT  (0x0020)
+#define SHMFIFO_FLAG_BROADCAST (0x0040)
+#define SHMFIFO_FLAG_EVICT  (0x0080)
+#define SHMFIFO_FLAG_VARLEN (0x0100)
+#define SHMFIFO_FLAG_ALIGN64 (0x0200)
+#define SHMFIFO_FLAG_MIRROR (0x0400)
+#define SHMFIFO_FLAG_INLINE (0x0800)
+#define SHMFIFO_FLAG_STATS  (0x1000)
+
+#define SHMFIFO_SYNC_SPSC   (0)
+#define SHMFIFO_SYNC_MPSC   (SHMFIFO_FLAG_MP)
+#define SHMFIFO_SYNC_SPMC   (SHMFIFO_FLAG_MC)
+#define SHMFIFO_SYNC_MPMC   (SHMFIFO_FLAG_MP | SHMFIFO_FLAG_MC)
+
+#define SHMFIFO_MEMCPY_AUTO   (0)
+#define SHMFIFO_MEMCPY_LIBC   (1)
+#define SHMFIFO_MEMCPY_SSE    (2)
+#define SHMFIFO_MEMCPY_AVX2   (3)
+#define SHMFIFO_MEMCPY_AVX512 (4)
+
+#define SHMFIFO_PREFAULT_TOUCH    (0)
+#define SHMFIFO_PREFAULT_POPULATE (1)
+#define SHMFIFO_PREFAULT_THREADS  (2)
+#define SHMFIFO_PREFAULT_LAZY     (3)
+#define SHMFIFO_PREFAULT_MODE     (0x00ff)
+#define SHMFIFO_PREFAULT_NOLOCK   (0x0100)
+
+#define SHMFIFO_NUMA_NONE  (-1)
+#define SHMFIFO_NUMA_LOCAL (-2)
+
+struct ShmFifoAttr {
+  uint32_t flags;
+  uint64_t spin_cycles;
+  size_t   nt_threshold;
+  uint32_t prefetch;
+  uint32_t prefault;
+  uint32_t prefault_threads;
+  size_t   page_size;
+  int32_t  numa_node;
+  uint32_t numa_interleave;
+  size_t   class_size[SHMFIFO_CLASS_MAX - 1];
+  size_t   class_count[SHMFIFO_CLASS_MAX - 1];
+};
+
+/* snapshot of the SHMFIFO_FLAG_STATS counters, depths are in bytes for varlen */
+struct ShmFifoStats {
+  uint64_t pushes;
+  uint64_t push_bytes;
+  uint64_t full;
+  uint64_t pops;
+  uint64_t empty;
+  uint64_t depth;
+  uint64_t max_depth;
+  uint64_t prod_retries;
+  uint64_t cons_retries;
+};
+
+void ShmFifoAttrInit(struct ShmFifoAttr *attr);
+
 struct ShmFifo* ShmFifoOpen(const char *path, size_t msg_size, size_t msg_count);
+struct ShmFifo* ShmFifoOpenAttr(const char *path, size_t msg_size, size_t msg_count,
+  const struct ShmFifoAttr *attr);
 void ShmFifoClose(struct ShmFifo *fifo);
 ssize_t ShmFifoPush(struct ShmFifo *fifo, const char* buf, const size_t buf_size);
 int ShmFifoPop(struct ShmFifo *fifo);
 ssize_t ShmFifoPopData(struct ShmFifo *fifo,  char* const buf, const size_t buf_size);
 void* ShmFifoTop(struct ShmFifo *fifo, size_t* const size);
+void* ShmFifoReserve(struct ShmFifo *fifo, const size_t size);
+ssize_t ShmFifoCommit(struct ShmFifo *fifo, void *buf, const size_t size);
+int ShmFifoAbort(struct ShmFifo *fifo, void *buf);
+ssize_t ShmFifoPushBulk(struct ShmFifo *fifo, const struct iovec *iov, const unsigned int n);
+ssize_t ShmFifoPushBurst(struct ShmFifo *fifo, const struct iovec *iov, const unsigned int n);
+ssize_t ShmFifoTopBurst(struct ShmFifo *fifo, struct iovec *iov, const unsigned int n);
+ssize_t ShmFifoTopSpan(struct ShmFifo *fifo, struct iovec *span, const unsigned int n);
+int ShmFifoPopBulk(struct ShmFifo *fifo, const unsigned int n);
+ssize_t ShmFifoPushWait(struct ShmFifo *fifo, const char* buf, const size_t buf_size,
+  int timeout_us);
+ssize_t ShmFifoPopDataWait(struct ShmFifo *fifo,  char* const buf, const size_t buf_size,
+  int timeout_us);
+void* ShmFifoTopWait(struct ShmFifo *fifo, size_t* const size, int timeout_us);
+int ShmFifoEventFd(struct ShmFifo *fifo);
+int ShmFifoFd(struct ShmFifo *fifo);
+int ShmFifoNumaNode(struct ShmFifo *fifo);
+int ShmFifoEventArm(struct ShmFifo *fifo);
+int ShmFifoSubscribe(struct ShmFifo *fifo);
+int ShmFifoUnsubscribe(struct ShmFifo *fifo);
+int ShmFifoMemcpySelect(int kind);
+int ShmFifoMemcpyKind(void);
+int ShmFifoStatsGet(struct ShmFifo *fifo, struct ShmFifoStats *stats);
 #ifdef __cplusplus
 }
 #endif
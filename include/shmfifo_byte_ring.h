@@ -0,0 +1,117 @@
+#ifndef SHMFIFO_BYTE_RING_H_
+#define SHMFIFO_BYTE_RING_H_
+
+#include <stdint.h>
+#include <unistd.h>
+
+#include "shmfifo_define.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHMFIFO_BYTE_PAD (0x1)
+
+/* record header, len is the payload size, or the whole filler size with PAD */
+struct ShmFifoByteHdr {
+  uint32_t len;
+  uint32_t flags;
+};
+
+#define SHMFIFO_BYTE_HDR_SIZE (sizeof(struct ShmFifoByteHdr))
+
+/*
+ * single producer single consumer ring of variable length records packed
+ * back to back, positions are byte offsets that never wrap, a record that
+ * does not fit before the end is preceded by a PAD filler unless the data
+ * is mirrored, then it simply runs on into the second mapping
+ */
+struct ShmFifoByteRing {
+  uint64_t size;
+  uint64_t mask;
+  uint32_t align;
+  uint32_t mirror;
+  char     pad0[0] SHMFIFO_CACHELINE_ALIGN;
+  uint64_t prod_tail SHMFIFO_CACHELINE_ALIGN;
+  char     pad1[0] SHMFIFO_CACHELINE_ALIGN;
+  uint64_t cons_tail SHMFIFO_CACHELINE_ALIGN;
+} SHMFIFO_CACHELINE_ALIGN;
+
+void ShmFifoByteRingInit(struct ShmFifoByteRing *ring, uint64_t size, uint32_t align,
+  uint32_t mirror);
+
+static inline uint64_t
+ShmFifoByteRecordSize(const struct ShmFifoByteRing *ring, size_t len)
+{
+  return SHMFIFO_SIZE_ALIGN(SHMFIFO_BYTE_HDR_SIZE + len, (uint64_t)ring->align);
+}
+
+/*
+ * producer, room for a len byte record at *pos, a PAD filler is written
+ * and *pos moved past it when the record would straddle the end
+ */
+static inline struct ShmFifoByteHdr *
+ShmFifoByteRingReserve(const struct ShmFifoByteRing *ring, char *data, uint64_t *pos,
+  uint64_t *cons_tail, size_t len)
+{
+  uint64_t               need = ShmFifoByteRecordSize(ring, len);
+  uint64_t               off = *pos & ring->mask;
+  uint64_t               pad = (need > ring->size - off && !ring->mirror) ?
+                                 ring->size - off : 0;
+  uint64_t               total = pad + need;
+  struct ShmFifoByteHdr *hdr;
+
+  if (ring->size - (*pos - *cons_tail) < total) {
+    *cons_tail = __atomic_load_n(&ring->cons_tail, __ATOMIC_ACQUIRE);
+    if (ring->size - (*pos - *cons_tail) < total) {
+      return NULL;
+    }
+  }
+  if (pad) {
+    hdr = (struct ShmFifoByteHdr *)(data + off);
+    hdr->len = (uint32_t)pad;
+    hdr->flags = SHMFIFO_BYTE_PAD;
+    *pos += pad;
+    off = 0;
+  }
+  return (struct ShmFifoByteHdr *)(data + off);
+}
+
+static inline void
+ShmFifoByteRingPublish(struct ShmFifoByteRing *ring, uint64_t pos)
+{
+  __atomic_store_n(&ring->prod_tail, pos, __ATOMIC_RELEASE);
+}
+
+/* consumer, record at *pos skipping fillers, NULL once *pos reaches the producer */
+static inline struct ShmFifoByteHdr *
+ShmFifoByteRingAt(const struct ShmFifoByteRing *ring, char *data, uint64_t *pos,
+  uint64_t *prod_tail)
+{
+  struct ShmFifoByteHdr *hdr;
+
+  for (;;) {
+    if (*pos == *prod_tail) {
+      *prod_tail = __atomic_load_n(&ring->prod_tail, __ATOMIC_ACQUIRE);
+      if (*pos == *prod_tail) {
+        return NULL;
+      }
+    }
+    hdr = (struct ShmFifoByteHdr *)(data + (*pos & ring->mask));
+    if (shmfifo_likely(!(hdr->flags & SHMFIFO_BYTE_PAD))) {
+      return hdr;
+    }
+    *pos += hdr->len;
+  }
+}
+
+static inline void
+ShmFifoByteRingRelease(struct ShmFifoByteRing *ring, uint64_t pos)
+{
+  __atomic_store_n(&ring->cons_tail, pos, __ATOMIC_RELEASE);
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
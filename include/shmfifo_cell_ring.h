@@ -0,0 +1,205 @@
+#ifndef SHMFIFO_CELL_RING_H_
+#define SHMFIFO_CELL_RING_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "shmfifo_ring.h"
+#include "shmfifo_copy.h"
+#include "shmfifo_define.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHMFIFO_CELL_SIZE (SHMFIFO_CACHE_LINE)
+#define SHMFIFO_CELL_DATA (SHMFIFO_CELL_SIZE - sizeof(uint32_t))
+
+/* ring entry of the inline mode, the message lives in the entry itself */
+struct ShmFifoCell {
+  uint32_t len;
+  char     data[SHMFIFO_CELL_DATA];
+} SHMFIFO_CACHELINE_ALIGN;
+
+/*
+ * the usual ShmFifoRing head/tail with SHMFIFO_CELL_SIZE entries after it,
+ * cells are copied in and out whole with aligned vector moves
+ */
+static inline size_t
+ShmFifoCellRingMemSize(uint32_t count)
+{
+  return sizeof(struct ShmFifoRing) + (size_t)count * SHMFIFO_CELL_SIZE;
+}
+
+static inline struct ShmFifoCell *
+ShmFifoCellRingAt(const struct ShmFifoRing *ring, uint32_t pos)
+{
+  return (struct ShmFifoCell *)&ring[1] + (pos & ring->mask);
+}
+
+static inline void
+ShmFifoCellRingCopyIn(struct ShmFifoRing *ring, uint32_t head,
+  const struct ShmFifoCell *cells, unsigned int n)
+{
+  uint32_t            idx = head & ring->mask;
+  uint32_t            first = (idx + n <= ring->size) ? n : ring->size - idx;
+  struct ShmFifoCell *base = (struct ShmFifoCell *)&ring[1];
+
+  ShmFifoCopyCell(&base[idx], cells, (size_t)first * SHMFIFO_CELL_SIZE);
+  if (shmfifo_unlikely(first != n)) {
+    ShmFifoCopyCell(base, &cells[first], (size_t)(n - first) * SHMFIFO_CELL_SIZE);
+  }
+}
+
+static inline void
+ShmFifoCellRingCopyOut(const struct ShmFifoRing *ring, uint32_t head,
+  struct ShmFifoCell *cells, unsigned int n)
+{
+  uint32_t                  idx = head & ring->mask;
+  uint32_t                  first = (idx + n <= ring->size) ? n : ring->size - idx;
+  const struct ShmFifoCell *base = (const struct ShmFifoCell *)&ring[1];
+
+  ShmFifoCopyCell(cells, &base[idx], (size_t)first * SHMFIFO_CELL_SIZE);
+  if (shmfifo_unlikely(first != n)) {
+    ShmFifoCopyCell(&cells[first], base, (size_t)(n - first) * SHMFIFO_CELL_SIZE);
+  }
+}
+
+/*
+ * claims up to n cells for the producer from *head, cons_tail is the
+ * producer's cached consumer tail, only used single threaded
+ */
+static inline unsigned int
+ShmFifoCellRingClaim(struct ShmFifoRing *ring, uint32_t *cons_tail, unsigned int n,
+  int behavior, uint32_t *head, uint32_t *next)
+{
+  uint32_t sync_type = ring->prod.sync_type;
+  uint32_t free_entries;
+
+  if (sync_type == SHMFIFO_RING_SYNC_MT_RTS) {
+    return ShmFifoRingRtsMoveProdHead(ring, n, behavior, head, next, &free_entries);
+  }
+  return ShmFifoRingMoveProdHead(ring, sync_type == SHMFIFO_RING_SYNC_ST, n, behavior,
+      sync_type == SHMFIFO_RING_SYNC_ST ? cons_tail : NULL, head, next, &free_entries);
+}
+
+static inline void
+ShmFifoCellRingPublish(struct ShmFifoRing *ring, uint32_t head, uint32_t next)
+{
+  uint32_t sync_type = ring->prod.sync_type;
+
+  if (sync_type == SHMFIFO_RING_SYNC_MT_RTS) {
+    ShmFifoRingRtsUpdateTail(&ring->rts_prod);
+  } else {
+    ShmFifoRingUpdateTail(&ring->prod, head, next, sync_type == SHMFIFO_RING_SYNC_ST);
+  }
+}
+
+/* whole staged cells, moved in with aligned 64 byte copies */
+static inline unsigned int
+ShmFifoCellRingEnqueue(struct ShmFifoRing *ring, uint32_t *cons_tail,
+  const struct ShmFifoCell *cells, unsigned int n, int behavior)
+{
+  uint32_t head;
+  uint32_t next;
+
+  n = ShmFifoCellRingClaim(ring, cons_tail, n, behavior, &head, &next);
+  if (!n) {
+    return 0;
+  }
+  ShmFifoCellRingCopyIn(ring, head, cells, n);
+  ShmFifoCellRingPublish(ring, head, next);
+  return n;
+}
+
+/*
+ * each message is laid out in one local cell and stored into its claimed
+ * cell with an aligned 64 byte move, cut to max_len, *bytes returns the
+ * bytes of the ones that went in
+ */
+static inline unsigned int
+ShmFifoCellRingEnqueueIov(struct ShmFifoRing *ring, uint32_t *cons_tail,
+  const struct iovec *iov, unsigned int n, size_t max_len, int behavior, size_t *bytes)
+{
+  struct ShmFifoCell cell;
+  uint32_t           head;
+  uint32_t           next;
+  size_t             len;
+  unsigned int       i;
+
+  *bytes = 0;
+  n = ShmFifoCellRingClaim(ring, cons_tail, n, behavior, &head, &next);
+  if (!n) {
+    return 0;
+  }
+  /* the tail of a short message would carry stack bytes into the mapping */
+  memset(&cell, 0, sizeof(cell));
+  for (i = 0; i < n; ++i) {
+    len = SHMFIFO_MIN(max_len, iov[i].iov_len);
+    cell.len = (uint32_t)len;
+    memcpy(cell.data, iov[i].iov_base, len);
+    ShmFifoCopyCell(ShmFifoCellRingAt(ring, head + i), &cell, SHMFIFO_CELL_SIZE);
+    *bytes += len;
+  }
+  ShmFifoCellRingPublish(ring, head, next);
+  return n;
+}
+
+/* cells NULL drops the entries, e.g. after they were read in place */
+static inline unsigned int
+ShmFifoCellRingDequeue(struct ShmFifoRing *ring, uint32_t *prod_tail,
+  struct ShmFifoCell *cells, unsigned int n, int behavior)
+{
+  uint32_t sync_type = ring->cons.sync_type;
+  uint32_t head;
+  uint32_t next;
+  uint32_t entries;
+
+  if (sync_type == SHMFIFO_RING_SYNC_MT_RTS) {
+    n = ShmFifoRingRtsMoveConsHead(ring, n, behavior, &head, &next, &entries);
+  } else {
+    n = ShmFifoRingMoveConsHead(ring, sync_type == SHMFIFO_RING_SYNC_ST, n, behavior,
+        sync_type == SHMFIFO_RING_SYNC_ST ? prod_tail : NULL, &head, &next, &entries);
+  }
+  if (!n) {
+    return 0;
+  }
+  if (cells) {
+    ShmFifoCellRingCopyOut(ring, head, cells, n);
+  }
+  if (sync_type == SHMFIFO_RING_SYNC_MT_RTS) {
+    ShmFifoRingRtsUpdateTail(&ring->rts_cons);
+  } else {
+    ShmFifoRingUpdateTail(&ring->cons, head, next, sync_type == SHMFIFO_RING_SYNC_ST);
+  }
+  return n;
+}
+
+/* up to n published cells from the consumer head, read in place */
+static inline unsigned int
+ShmFifoCellRingPeek(const struct ShmFifoRing *ring, uint32_t *prod_tail,
+  uint32_t *head, unsigned int n)
+{
+  uint32_t entries;
+
+  *head = ShmFifoRingConsHead(ring);
+  if (ring->cons.sync_type != SHMFIFO_RING_SYNC_ST) {
+    *prod_tail = __atomic_load_n(&ring->prod.tail, __ATOMIC_ACQUIRE);
+  }
+  entries = *prod_tail - *head;
+  if (entries < n || (int32_t)entries < 0) {
+    *prod_tail = __atomic_load_n(&ring->prod.tail, __ATOMIC_ACQUIRE);
+    entries = *prod_tail - *head;
+  }
+  if ((int32_t)entries < 0) {
+    return 0;
+  }
+  return (n > entries) ? entries : n;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,65 @@
+#ifndef SHMFIFO_COPY_H_
+#define SHMFIFO_COPY_H_
+
+#include <stdint.h>
+#include <unistd.h>
+
+#include "shmfifo_define.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void *(*ShmFifoCopyFn)(void *dst, const void *src, size_t n);
+
+/* selected on first use from cpuid, ShmFifoMemcpySelect may replace them */
+extern ShmFifoCopyFn shmfifo_copy_fn;
+extern ShmFifoCopyFn shmfifo_copy_stream_fn;
+extern ShmFifoCopyFn shmfifo_copy_cell_fn;
+
+/* kernels from shmfifo_memcpy.h, each built with its own -m flags */
+void *ShmFifoCopySse(void *dst, const void *src, size_t n);
+void *ShmFifoCopyAvx2(void *dst, const void *src, size_t n);
+void *ShmFifoCopyAvx512(void *dst, const void *src, size_t n);
+void *ShmFifoCopyStreamSse(void *dst, const void *src, size_t n);
+void *ShmFifoCopyStreamAvx2(void *dst, const void *src, size_t n);
+void *ShmFifoCopyStreamAvx512(void *dst, const void *src, size_t n);
+void *ShmFifoCopyCellSse(void *dst, const void *src, size_t n);
+void *ShmFifoCopyCellAvx2(void *dst, const void *src, size_t n);
+void *ShmFifoCopyCellAvx512(void *dst, const void *src, size_t n);
+
+static inline void *
+ShmFifoCopy(void *dst, const void *src, size_t n)
+{
+  return shmfifo_copy_fn(dst, src, n);
+}
+
+/* non-temporal stores, ends with an sfence so a release store may follow */
+static inline void *
+ShmFifoCopyStream(void *dst, const void *src, size_t n)
+{
+  return shmfifo_copy_stream_fn(dst, src, n);
+}
+
+/* cache line aligned 64 byte cells, n is a multiple of SHMFIFO_CACHE_LINE */
+static inline void *
+ShmFifoCopyCell(void *dst, const void *src, size_t n)
+{
+  return shmfifo_copy_cell_fn(dst, src, n);
+}
+
+static inline void
+ShmFifoPrefetchRange(const void *addr, size_t size)
+{
+  uintptr_t line = (uintptr_t)addr & ~(uintptr_t)(SHMFIFO_CACHE_LINE - 1);
+  uintptr_t end = (uintptr_t)addr + size;
+
+  for (; line < end; line += SHMFIFO_CACHE_LINE) {
+    __builtin_prefetch((const void *)line, 0, 3);
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,74 @@
+#ifndef SHMFIFO_CURSOR_H_
+#define SHMFIFO_CURSOR_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "shmfifo_ring.h"
+#include "shmfifo_define.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHMFIFO_CURSOR_MAX (32)
+
+enum {
+  SHMFIFO_CURSOR_FREE = 0,
+  SHMFIFO_CURSOR_JOINING,
+  SHMFIFO_CURSOR_LIVE,
+  SHMFIFO_CURSOR_EVICTED,
+};
+
+/* read position of one broadcast subscriber, pos is only written by its owner */
+struct ShmFifoCursor {
+  uint32_t pos;
+  uint32_t state;
+  pid_t    pid;
+} SHMFIFO_CACHELINE_ALIGN;
+
+struct ShmFifoCursorTable {
+  uint32_t             count;
+  struct ShmFifoCursor cursor[SHMFIFO_CURSOR_MAX];
+} SHMFIFO_CACHELINE_ALIGN;
+
+void ShmFifoCursorTableInit(struct ShmFifoCursorTable *table);
+int ShmFifoCursorClaim(struct ShmFifoCursorTable *table);
+void ShmFifoCursorJoin(struct ShmFifoCursor *cursor, struct ShmFifoRing *list);
+void ShmFifoCursorRelease(struct ShmFifoCursor *cursor);
+uint32_t ShmFifoCursorGate(struct ShmFifoCursorTable *table, struct ShmFifoRing *list,
+  unsigned int n, int evict);
+
+static inline int
+ShmFifoCursorLive(const struct ShmFifoCursor *cursor)
+{
+  return __atomic_load_n(&cursor->state, __ATOMIC_ACQUIRE) == SHMFIFO_CURSOR_LIVE;
+}
+
+static inline unsigned int
+ShmFifoCursorPeek(const struct ShmFifoCursor *cursor, const struct ShmFifoRing *list,
+  uint32_t *prod_tail, struct ShmFifoObj *obj_list, unsigned int n)
+{
+  return ShmFifoRingPeekAt(list, __atomic_load_n(&cursor->pos, __ATOMIC_RELAXED),
+    prod_tail, obj_list, n);
+}
+
+static inline unsigned int
+ShmFifoCursorCount(const struct ShmFifoCursor *cursor, const struct ShmFifoRing *list)
+{
+  return __atomic_load_n(&list->prod.tail, __ATOMIC_ACQUIRE) -
+    __atomic_load_n(&cursor->pos, __ATOMIC_RELAXED);
+}
+
+/* release pairs with the producer's acquire in ShmFifoCursorGate */
+static inline void
+ShmFifoCursorAdvance(struct ShmFifoCursor *cursor, unsigned int n)
+{
+  __atomic_store_n(&cursor->pos, __atomic_load_n(&cursor->pos, __ATOMIC_RELAXED) + n,
+    __ATOMIC_RELEASE);
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -29,28 +29,26 @@ extern "C" {
 #define SHMFIFO_PAGE_SIZE (4096UL)
 #endif
 
-#ifdef SHMFIFO_FENCE
-#define SHMFIFO_RMB()   _mm_lfence()
-#define SHMFIFO_WMB()   _mm_sfence()
-#define SHMFIFO_MB()    _mm_mfence()
 #define SHMFIFO_PAUSE() _mm_pause()
-#else
-#define SHMFIFO_RMB() 
-#define SHMFIFO_WMB()
-#define SHMFIFO_MB()
-#define SHMFIFO_PAUSE()
-#endif
 
 #define shmfifo_likely(x) __builtin_expect(!!(x), 1)
 #define shmfifo_unlikely(x)  __builtin_expect(!!(x), 0)
 
 #define SHMFIFO_PATH_MAX   PATH_MAX
+#define SHMFIFO_HUGEPAGES_DIR "/sys/kernel/mm/hugepages"
 
 #define SHMFIFO_MIN(x_, y_) ((y_) ^ (((x_) ^ (y_)) & -((x_) < (y_))))
+/*
+ * ring descriptor, 8 per cache line, slots start on a cache line so the
+ * data offset is kept in 64 byte units, which covers 256G of slot data
+ */
+#define SHMFIFO_OBJ_SHIFT (6)
+#define SHMFIFO_OBJ_DATA_MAX ((size_t)UINT32_MAX << SHMFIFO_OBJ_SHIFT)
+
 struct ShmFifoObj
 {
-  size_t offset;
-  size_t size;
+  uint32_t index;
+  uint32_t size;
 };
 
 #ifdef __cplusplus
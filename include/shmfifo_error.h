@@ -24,6 +24,34 @@ enum {
   SHMFIFO_ERR_FILE_SIZE,
   SHMFIFO_ERR_FORMAT_FTRUNCATE,
   SHMFIFO_ERR_FORMAT_FTRUNCATE_SIZE,
+  SHMFIFO_ERR_COMMIT_ADDR,
+  SHMFIFO_ERR_COMMIT_SIZE,
+  SHMFIFO_ERR_COMMIT_OBJ_ENQUEUE,
+  SHMFIFO_ERR_ABORT_ADDR,
+  SHMFIFO_ERR_ABORT_OBJ_FREE,
+  SHMFIFO_ERR_PUSH_BULK_SIZE,
+  SHMFIFO_ERR_PUSH_BULK_OBJ_ENQUEUE,
+  SHMFIFO_ERR_POP_BULK_SIZE,
+  SHMFIFO_ERR_POP_BULK_OBJ_FREE,
+  SHMFIFO_ERR_OPEN_FLAGS,
+  SHMFIFO_ERR_OPEN_ATTR,
+  SHMFIFO_ERR_TIMEOUT,
+  SHMFIFO_ERR_WAIT_FLAGS,
+  SHMFIFO_ERR_WAIT_FUTEX,
+  SHMFIFO_ERR_EVENT_FLAGS,
+  SHMFIFO_ERR_EVENT_PATH,
+  SHMFIFO_ERR_EVENT_MKFIFO,
+  SHMFIFO_ERR_EVENT_OPEN,
+  SHMFIFO_ERR_BROADCAST_FLAGS,
+  SHMFIFO_ERR_CURSOR_FULL,
+  SHMFIFO_ERR_CURSOR_NONE,
+  SHMFIFO_ERR_EVICTED,
+  SHMFIFO_ERR_SPAN_FLAGS,
+  SHMFIFO_ERR_MEMCPY_KIND,
+  SHMFIFO_ERR_STATS_FLAGS,
+  SHMFIFO_ERR_NUMA,
+  SHMFIFO_ERR_PAGE_SIZE,
+  SHMFIFO_ERR_POP_DATA_DROP,
   SHMFIFO_ERR_MAX
 };
 #ifdef __cplusplus
@@ -0,0 +1,28 @@
+#ifndef SHMFIFO_EVENT_H_
+#define SHMFIFO_EVENT_H_
+
+#include <stdint.h>
+
+#include "shmfifo_define.h"
+#include "shmfifo_error.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHMFIFO_EVENT_SUFFIX ".event"
+
+/* set by an idle consumer, cleared by the producer that rings the doorbell */
+struct ShmFifoEvent {
+  uint32_t armed;
+} SHMFIFO_CACHELINE_ALIGN;
+
+void ShmFifoEventInit(struct ShmFifoEvent *event);
+int ShmFifoEventOpen(const char *path);
+void ShmFifoEventKick(int fd);
+void ShmFifoEventDrain(int fd);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,73 @@
+#ifndef SHMFIFO_HEADER_H_
+#define SHMFIFO_HEADER_H_
+
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "shmfifo.h"
+#include "shmfifo_wait.h"
+#include "shmfifo_event.h"
+#include "shmfifo_stats.h"
+#include "shmfifo_define.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SHMFIFO_MAGIC
+#define SHMFIFO_MAGIC 0x4649464F //SHMFIFO
+#endif
+
+#ifndef SHMFIFO_MAJOR
+#define SHMFIFO_MAJOR (1U)
+#endif
+
+#ifndef SHMFIFO_MINOR
+#define SHMFIFO_MINOR  (12U)
+#endif
+
+#ifndef SHMFIFO_VERSION
+#define SHMFIFO_VERSION ((SHMFIFO_MAJOR << 16) | SHMFIFO_MINOR)
+#endif
+
+/* slot size class, offsets are from the header and from the data region */
+struct ShmFifoClass {
+  size_t            msg_size;
+  size_t            msg_count;
+  size_t            pool_offset;
+  size_t            data_offset;
+};
+
+/*
+ * shared header at offset 0 of the fifo file, holds no pointers or fds so
+ * shmfifo-stat can map it read only
+ */
+struct ShmFifoHeader {
+  uint32_t          magic;
+  uint32_t          version;
+  uint32_t          flags;
+  uint32_t          page_size;
+  size_t            total_size;
+  size_t            list_size;
+  size_t            msg_size;
+  size_t            msg_count;
+  size_t            data_size;
+  size_t            class_num;
+  struct ShmFifoClass classes[SHMFIFO_CLASS_MAX];
+  size_t            list_offset;
+  size_t            obj_pool_offset;
+  size_t            cursor_offset;
+  size_t            data_offset;
+  time_t            create_time;
+  pid_t             creator;
+  struct ShmFifoWaitQueue not_empty;
+  struct ShmFifoWaitQueue not_full;
+  struct ShmFifoEvent     event;
+  struct ShmFifoStatsBlock stats;
+} SHMFIFO_CACHELINE_ALIGN;
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -20,6 +20,16 @@ shmfifo_fast_memcpy(void *dst, const void *src, size_t n);
 
 #define ALIGNMENT_MASK 0x3F
 
+static __fast_always_inline void fast_stream(uint8_t *dst, const uint8_t *src)
+{
+	_mm512_stream_si512((__m512i *)dst, _mm512_loadu_si512((const void *)src));
+}
+
+static __fast_always_inline void fast_cell(uint8_t *dst, const uint8_t *src)
+{
+	_mm512_store_si512((void *)dst, _mm512_load_si512((const void *)src));
+}
+
 static __fast_always_inline void fast_mov16(uint8_t *dst, const uint8_t *src)
 {
 	__m128i xmm0;
@@ -201,6 +211,21 @@ COPY_BLOCK_128_BACK63:
 
 #define ALIGNMENT_MASK 0x1F
 
+static __fast_always_inline void fast_stream(uint8_t *dst, const uint8_t *src)
+{
+	_mm256_stream_si256((__m256i *)dst, _mm256_loadu_si256((const __m256i *)src));
+}
+
+static __fast_always_inline void fast_cell(uint8_t *dst, const uint8_t *src)
+{
+	__m256i ymm0, ymm1;
+
+	ymm0 = _mm256_load_si256((const __m256i *)src);
+	ymm1 = _mm256_load_si256((const __m256i *)(src + 32));
+	_mm256_store_si256((__m256i *)dst, ymm0);
+	_mm256_store_si256((__m256i *)(dst + 32), ymm1);
+}
+
 static __fast_always_inline void fast_mov16(uint8_t *dst, const uint8_t *src)
 {
 	__m128i xmm0;
@@ -351,6 +376,25 @@ COPY_BLOCK_128_BACK31:
 
 #define ALIGNMENT_MASK 0x0F
 
+static __fast_always_inline void fast_stream(uint8_t *dst, const uint8_t *src)
+{
+	_mm_stream_si128((__m128i *)dst, _mm_loadu_si128((const __m128i *)src));
+}
+
+static __fast_always_inline void fast_cell(uint8_t *dst, const uint8_t *src)
+{
+	__m128i xmm0, xmm1, xmm2, xmm3;
+
+	xmm0 = _mm_load_si128((const __m128i *)src);
+	xmm1 = _mm_load_si128((const __m128i *)(src + 16));
+	xmm2 = _mm_load_si128((const __m128i *)(src + 32));
+	xmm3 = _mm_load_si128((const __m128i *)(src + 48));
+	_mm_store_si128((__m128i *)dst, xmm0);
+	_mm_store_si128((__m128i *)(dst + 16), xmm1);
+	_mm_store_si128((__m128i *)(dst + 32), xmm2);
+	_mm_store_si128((__m128i *)(dst + 48), xmm3);
+}
+
 static __fast_always_inline void fast_mov16(uint8_t *dst, const uint8_t *src)
 {
 	__m128i xmm0;
@@ -658,6 +702,56 @@ static __fast_always_inline void * shmfifo_fast_memcpy(void *dst,
 		return fast_memcpy_generic(dst, src, n);
 }
 
+/*
+ * non-temporal copy for large buffers, the destination lines go to memory
+ * without being pulled into the writer's cache, the trailing sfence orders
+ * the streamed lines before the caller's release store
+ */
+static __fast_always_inline void * shmfifo_stream_memcpy(void *dst,
+    const void *src, size_t n)
+{
+	uint8_t *d = (uint8_t *)dst;
+	const uint8_t *s = (const uint8_t *)src;
+	size_t head = (size_t)(-(uintptr_t)d) & ALIGNMENT_MASK;
+
+	if (n < head + 4 * (ALIGNMENT_MASK + 1))
+		return shmfifo_fast_memcpy(dst, src, n);
+
+	if (head) {
+		shmfifo_fast_memcpy(d, s, head);
+		d += head;
+		s += head;
+		n -= head;
+	}
+	for (; n > ALIGNMENT_MASK; n -= ALIGNMENT_MASK + 1) {
+		fast_stream(d, s);
+		d += ALIGNMENT_MASK + 1;
+		s += ALIGNMENT_MASK + 1;
+	}
+	if (n)
+		shmfifo_fast_memcpy(d, s, n);
+	_mm_sfence();
+	return dst;
+}
+
+/*
+ * whole 64 byte cells, both sides cache line aligned and n a multiple of
+ * 64, every line moves with aligned vector loads and stores
+ */
+static __fast_always_inline void * shmfifo_cell_memcpy(void *dst,
+    const void *src, size_t n)
+{
+	uint8_t *d = (uint8_t *)dst;
+	const uint8_t *s = (const uint8_t *)src;
+
+	for (; n >= 64; n -= 64) {
+		fast_cell(d, s);
+		d += 64;
+		s += 64;
+	}
+	return dst;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,28 @@
+#ifndef SHMFIFO_NUMA_H_
+#define SHMFIFO_NUMA_H_
+
+#include <stdint.h>
+#include <unistd.h>
+
+#include "shmfifo_define.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * binds the pages of a fresh mapping before they are first touched, the
+ * control part [addr, addr + ctrl_size) goes to node, the rest of the
+ * mapping too or, with interleave, round robin over every allowed node;
+ * node SHMFIFO_NUMA_LOCAL is the node of the calling cpu and
+ * SHMFIFO_NUMA_NONE leaves the control part to first touch
+ */
+int ShmFifoNumaBind(void *addr, size_t ctrl_size, size_t size, size_t page, int node,
+  int interleave);
+/* node holding the page at addr, faulting it in when needed */
+int ShmFifoNumaNodeOf(const void *addr);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
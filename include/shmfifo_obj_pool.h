@@ -9,10 +9,13 @@
 #ifdef __cplusplus 
 extern "C" {
 #endif
-#define SHMFIFO_OBJ_DATA(_fifo, _obj) ((_fifo)->start_addr + (_obj).offset)
+#define SHMFIFO_OBJ_OFFSET(_obj) ((size_t)(_obj).index << SHMFIFO_OBJ_SHIFT)
+#define SHMFIFO_OBJ_INDEX(_offset) ((uint32_t)((_offset) >> SHMFIFO_OBJ_SHIFT))
+#define SHMFIFO_OBJ_DATA(_fifo, _obj) ((_fifo)->start_addr + SHMFIFO_OBJ_OFFSET(_obj))
 #define SHMFIFO_OBJ_SIZE(_obj) ((_obj).size)
 
-int ShmFifoObjPoolInit(struct ShmFifoRing *obj_pool, size_t msg_size, uint32_t msg_count);
+int ShmFifoObjPoolInit(struct ShmFifoRing *obj_pool, size_t offset, size_t msg_size,
+  uint32_t msg_count, int flags);
 
 static inline ssize_t
 ShmFifoObjAlloc(struct ShmFifoRing *obj_pool, struct ShmFifoObj* const obj)
@@ -27,6 +30,64 @@ ShmFifoObjFree(struct ShmFifoRing *obj_pool, struct ShmFifoObj* const obj)
   return ShmFifoRingEnqueueBulk(obj_pool, obj, 1, NULL);
 }
 
+static inline unsigned int
+ShmFifoObjAllocBulk(struct ShmFifoRing *obj_pool, uint32_t *prod_tail,
+  struct ShmFifoObj* const obj_list, unsigned int n, int behavior)
+{
+  return ShmFifoRingDequeueCached(obj_pool, prod_tail, obj_list, n, behavior);
+}
+
+static inline unsigned int
+ShmFifoDirectAlloc(const struct ShmFifoRing *list, uint32_t mask, size_t msg_size,
+  uint32_t *cons_tail, struct ShmFifoObj* const obj_list, unsigned int n, int behavior)
+{
+  unsigned int  i;
+  uint32_t      head;
+  uint32_t      free_entries;
+  uint32_t      stride = SHMFIFO_OBJ_INDEX(msg_size);
+
+  head = __atomic_load_n(&list->prod.head, __ATOMIC_RELAXED);
+  free_entries = list->capacity + *cons_tail - head;
+  if (free_entries < n) {
+    *cons_tail = __atomic_load_n(&list->cons.tail, __ATOMIC_ACQUIRE);
+    free_entries = list->capacity + *cons_tail - head;
+  }
+  if (shmfifo_unlikely(n > free_entries)) {
+    n = (behavior == SHMFIFO_RING_QUEUE_FIXED) ? 0 : free_entries;
+  }
+  for (i = 0; i < n; ++i) {
+    obj_list[i].index = ((head + i) & mask) * stride;
+    obj_list[i].size = 0;
+  }
+  return n;
+}
+
+static inline unsigned int
+ShmFifoObjFreeBulk(struct ShmFifoRing *obj_pool, uint32_t *cons_tail,
+  struct ShmFifoObj* const obj_list, unsigned int n)
+{
+  unsigned int i;
+
+  for (i = 0; i < n; ++i) {
+    SHMFIFO_OBJ_SIZE(obj_list[i]) = 0;
+  }
+  return ShmFifoRingEnqueueCached(obj_pool, cons_tail, obj_list, n,
+    SHMFIFO_RING_QUEUE_FIXED);
+}
+
+/* give back slots allocated by a single producer, never touches the free side */
+static inline void
+ShmFifoObjUnalloc(struct ShmFifoRing *obj_pool, struct ShmFifoObj* const obj_list,
+  unsigned int n)
+{
+  unsigned int i;
+
+  for (i = 0; i < n; ++i) {
+    SHMFIFO_OBJ_SIZE(obj_list[i]) = 0;
+  }
+  ShmFifoRingUndequeue(obj_pool, obj_list, n);
+}
+
 #ifdef __cplusplus 
 }
 #endif
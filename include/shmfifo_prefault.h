@@ -0,0 +1,32 @@
+#ifndef SHMFIFO_PREFAULT_H_
+#define SHMFIFO_PREFAULT_H_
+
+#include <stdint.h>
+#include <unistd.h>
+
+#include "shmfifo_define.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* no thread is started for less than this much memory */
+#define SHMFIFO_PREFAULT_CHUNK       (16UL << 20)
+#define SHMFIFO_PREFAULT_THREADS_MAX (64)
+
+/*
+ * reads one byte of every page of [addr, addr + size) so the page tables are
+ * filled before the fifo is used, threads 0 takes the online cpu count and
+ * the range is split in contiguous runs, one per thread
+ */
+void ShmFifoPrefault(void *addr, size_t size, size_t page, uint32_t threads);
+/*
+ * mlock, or mlock2 MLOCK_ONFAULT with lazy so pages are locked as they come
+ * in, lazy does not lock at all where MLOCK_ONFAULT is missing
+ */
+int ShmFifoLock(void *addr, size_t size, int lazy);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
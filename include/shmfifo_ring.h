@@ -11,132 +11,162 @@
 extern "C" {
 #endif
 
-#define SHMFIFO_RING_SP_ENQ 0x0001
-#define SHMFIFO_RING_SC_DEQ 0x0002
+#define SHMFIFO_RING_SP_ENQ     0x0001
+#define SHMFIFO_RING_SC_DEQ     0x0002
+#define SHMFIFO_RING_MP_RTS_ENQ 0x0004
+#define SHMFIFO_RING_MC_RTS_DEQ 0x0008
+
+#define SHMFIFO_RING_SYNC_MT     0
+#define SHMFIFO_RING_SYNC_ST     1
+#define SHMFIFO_RING_SYNC_MT_RTS 2
+
+#define SHMFIFO_RING_QUEUE_FIXED    0
+#define SHMFIFO_RING_QUEUE_VARIABLE 1
 
 
 struct ShmFifoHeadTail {
-    volatile uint32_t head;
-    volatile uint32_t tail;
-    uint32_t          single;
+    uint32_t          head;
+    uint32_t          tail;
+    uint32_t          sync_type;
 };
+
+union ShmFifoPosCnt {
+    uint64_t raw;
+    struct {
+        uint32_t cnt;
+        uint32_t pos;
+    } val;
+};
+
+/* relaxed tail sync, tail.val.pos overlays ShmFifoHeadTail.tail */
+struct ShmFifoRtsHeadTail {
+    union ShmFifoPosCnt tail;
+    uint32_t          sync_type;
+    uint32_t          htd_max;
+    union ShmFifoPosCnt head;
+};
+
 struct ShmFifoRing{
     uint32_t            size;
     uint32_t            mask;
     uint32_t            capacity;
     char                pad0[0] SHMFIFO_CACHELINE_ALIGN;
-    struct ShmFifoHeadTail prod SHMFIFO_CACHELINE_ALIGN;
+    /* failed head CAS of the multi thread sides, on the line the CAS hits anyway */
+    struct {
+        union {
+            struct ShmFifoHeadTail    prod;
+            struct ShmFifoRtsHeadTail rts_prod;
+        };
+        uint64_t            prod_retries;
+    } SHMFIFO_CACHELINE_ALIGN;
     char                pad1[0] SHMFIFO_CACHELINE_ALIGN;
-    struct ShmFifoHeadTail cons SHMFIFO_CACHELINE_ALIGN;
+    struct {
+        union {
+            struct ShmFifoHeadTail    cons;
+            struct ShmFifoRtsHeadTail rts_cons;
+        };
+        uint64_t            cons_retries;
+    } SHMFIFO_CACHELINE_ALIGN;
 } SHMFIFO_CACHELINE_ALIGN;
 
 void ShmFifoRingInit(struct ShmFifoRing *ring, uint32_t count, int flags);
 
+#define SHMFIFO_RING_COPY_BLOCK (SHMFIFO_CACHE_LINE / sizeof(struct ShmFifoObj))
+
+/*
+ * descriptors are 8 bytes, a cache line of them moves as four unaligned
+ * sse2 loads and stores, the rest go one by one
+ */
+static inline void
+ShmFifoRingCopy(struct ShmFifoObj *dst, const struct ShmFifoObj *src, unsigned int n)
+{
+  unsigned int i;
+  __m128i      x0, x1, x2, x3;
+
+  /* callers pass single objects with n 1, hide them from -Warray-bounds */
+  __asm__("" : "+r"(dst), "+r"(src));
+  for (i = 0; i + SHMFIFO_RING_COPY_BLOCK <= n; i += SHMFIFO_RING_COPY_BLOCK) {
+    x0 = _mm_loadu_si128((const __m128i *)&src[i]);
+    x1 = _mm_loadu_si128((const __m128i *)&src[i + 2]);
+    x2 = _mm_loadu_si128((const __m128i *)&src[i + 4]);
+    x3 = _mm_loadu_si128((const __m128i *)&src[i + 6]);
+    _mm_storeu_si128((__m128i *)&dst[i], x0);
+    _mm_storeu_si128((__m128i *)&dst[i + 2], x1);
+    _mm_storeu_si128((__m128i *)&dst[i + 4], x2);
+    _mm_storeu_si128((__m128i *)&dst[i + 6], x3);
+  }
+  for (; i < n; ++i) {
+    dst[i] = src[i];
+  }
+}
+
 #define SHMFIFO_ENQUEUE_ADDR(r, ring_start, prod_head, obj_table, n) \
 do { \
-	unsigned int i; \
-	const uint32_t size = (r)->size; \
 	uint32_t idx = prod_head & (r)->mask; \
+	uint32_t first = (idx + n <= (r)->size) ? n : (r)->size - idx; \
 	struct ShmFifoObj *_ring = (struct ShmFifoObj *)ring_start; \
-	if (shmfifo_likely(idx + n < size)) { \
-		for (i = 0; i < (n & ((~(unsigned)0x3))); i += 4, idx += 4) { \
-			_ring[idx] = obj_table[i]; \
-			_ring[idx + 1] = obj_table[i + 1]; \
-			_ring[idx + 2] = obj_table[i + 2]; \
-			_ring[idx + 3] = obj_table[i + 3]; \
-		} \
-		switch (n & 0x3) { \
-		case 3: \
-			_ring[idx++] = obj_table[i++];  \
-		case 2: \
-			_ring[idx++] = obj_table[i++];  \
-		case 1: \
-			_ring[idx++] = obj_table[i++]; \
-		} \
-	} else { \
-		for (i = 0; idx < size; i++, idx++)\
-			_ring[idx] = obj_table[i]; \
-		for (idx = 0; i < n; i++, idx++) \
-			_ring[idx] = obj_table[i]; \
+	ShmFifoRingCopy(&_ring[idx], obj_table, first); \
+	if (shmfifo_unlikely(first != n)) { \
+		ShmFifoRingCopy(_ring, &obj_table[first], n - first); \
 	} \
 } while (0)
 
 #define SHMFIFO_DEQUEUE_ADDR(r, ring_start, cons_head, obj_table, n) \
 do { \
-	unsigned int i; \
 	uint32_t idx = cons_head & (r)->mask; \
-	const uint32_t size = (r)->size; \
-	struct ShmFifoObj *_ring = (struct ShmFifoObj *)ring_start; \
-	if (shmfifo_likely(idx + n < size)) { \
-		for (i = 0; i < (n & (~(unsigned)0x3)); i += 4, idx += 4) {\
-			obj_table[i] = _ring[idx]; \
-			obj_table[i + 1] = _ring[idx + 1]; \
-			obj_table[i + 2] = _ring[idx + 2]; \
-			obj_table[i + 3] = _ring[idx + 3]; \
-		} \
-		switch (n & 0x3) { \
-		case 3: \
-			obj_table[i++] = _ring[idx++];  \
-		case 2: \
-			obj_table[i++] = _ring[idx++];  \
-		case 1: \
-			obj_table[i++] = _ring[idx++]; \
-		} \
-	} else { \
-		for (i = 0; idx < size; i++, idx++) \
-			obj_table[i] = _ring[idx]; \
-		for (idx = 0; i < n; i++, idx++) \
-			obj_table[i] = _ring[idx]; \
+	uint32_t first = (idx + n <= (r)->size) ? n : (r)->size - idx; \
+	const struct ShmFifoObj *_ring = (const struct ShmFifoObj *)ring_start; \
+	ShmFifoRingCopy(obj_table, &_ring[idx], first); \
+	if (shmfifo_unlikely(first != n)) { \
+		ShmFifoRingCopy(&obj_table[first], _ring, n - first); \
 	} \
 } while (0)
 
-#if (__GNUC__ >= 4 && __GNUC_MINOR__ >=2)
-#define ShmFifoRingCmpset32(val, old, set) \
-        __sync_bool_compare_and_swap((val), (old), (set))
-#else
-static inline int
-ShmFifoRingCmpset32(volatile uint32_t *dst, uint32_t exp, uint32_t src)
-{
-    uint8_t res;
-    asm volatile(
-        "lock;"
-        "cmpxchgl %[src], %[dst];"
-        "sete %[res];"
-        : [res] "=a" (res), 
-        [dst] "=m" (*dst)
-        : [src] "r" (src), 
-        "a" (exp),
-        "m" (*dst)
-        : "memory");   
-    return res;
-}
-#endif
-
 static inline unsigned int
 ShmFifoRingMoveProdHead(struct ShmFifoRing *ring,
-    unsigned int is_sp, unsigned int n,
+    unsigned int is_sp, unsigned int n, int behavior, uint32_t *peer_tail,
     uint32_t *old_head, uint32_t *new_head, uint32_t *free_entries)
 {
   const uint32_t  capacity = ring->capacity;
   unsigned int    max = n;
+  uint32_t        cons_tail;
   int             ret = 0;
 
+  *old_head = __atomic_load_n(&ring->prod.head, __ATOMIC_RELAXED);
   do {
     n = max;
-    *old_head = ring->prod.head;
-    SHMFIFO_RMB();
-    *free_entries = capacity + ring->cons.tail - *old_head; //???
+    /* keep the head load ahead of the cons.tail load */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    /* 
+     * pairs with the release store of cons.tail in ShmFifoRingUpdateTail,
+     * a cached cons.tail is only reloaded when the ring looks full
+     */
+    if (peer_tail && capacity + *peer_tail - *old_head >= n) {
+      cons_tail = *peer_tail;
+    } else {
+      cons_tail = __atomic_load_n(&ring->cons.tail, __ATOMIC_ACQUIRE);
+      if (peer_tail) {
+        *peer_tail = cons_tail;
+      }
+    }
+    *free_entries = capacity + cons_tail - *old_head;
     if (shmfifo_unlikely(n > *free_entries)) {
-      n = *free_entries;
+      n = (behavior == SHMFIFO_RING_QUEUE_FIXED) ? 0 : *free_entries;
+    }
+    if (n == 0) {
+      return 0;
     }
     *new_head = *old_head + n;
     if (is_sp) {
-      ring->prod.head = *new_head;
+      __atomic_store_n(&ring->prod.head, *new_head, __ATOMIC_RELAXED);
       ret = 1;
     } else {
-      ret = ShmFifoRingCmpset32(&ring->prod.head, *old_head, *new_head);
+      ret = __atomic_compare_exchange_n(&ring->prod.head, old_head, *new_head,
+          0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+      if (shmfifo_unlikely(!ret)) {
+        __atomic_fetch_add(&ring->prod_retries, 1, __ATOMIC_RELAXED);
+      }
     }
-
   } while (shmfifo_unlikely(!ret));
 
   return n;
@@ -144,26 +174,43 @@ ShmFifoRingMoveProdHead(struct ShmFifoRing *ring,
 
 static inline unsigned int
 ShmFifoRingMoveConsHead(struct ShmFifoRing *ring,
-    unsigned int is_sc, unsigned int n,
+    unsigned int is_sc, unsigned int n, int behavior, uint32_t *peer_tail,
     uint32_t *old_head, uint32_t *new_head, uint32_t *entries)
 {
   unsigned int max = n;
+  uint32_t     prod_tail;
   int          ret = 0;
 
+  *old_head = __atomic_load_n(&ring->cons.head, __ATOMIC_RELAXED);
   do {
     n = max;
-    *old_head = ring->cons.head;
-    SHMFIFO_RMB();
-    *entries = ring->prod.tail - *old_head;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    /* pairs with the release store of prod.tail in ShmFifoRingUpdateTail */
+    if (peer_tail && *peer_tail - *old_head >= n) {
+      prod_tail = *peer_tail;
+    } else {
+      prod_tail = __atomic_load_n(&ring->prod.tail, __ATOMIC_ACQUIRE);
+      if (peer_tail) {
+        *peer_tail = prod_tail;
+      }
+    }
+    *entries = prod_tail - *old_head;
     if (shmfifo_unlikely(n > *entries)) {
-      n = *entries;
+      n = (behavior == SHMFIFO_RING_QUEUE_FIXED) ? 0 : *entries;
+    }
+    if (n == 0) {
+      return 0;
     }
     *new_head = *old_head + n;
     if (is_sc) {
-      ring->cons.head = *new_head;
+      __atomic_store_n(&ring->cons.head, *new_head, __ATOMIC_RELAXED);
       ret = 1;
     } else {
-      ret = ShmFifoRingCmpset32(&ring->cons.head, *old_head, *new_head);
+      ret = __atomic_compare_exchange_n(&ring->cons.head, old_head, *new_head,
+          0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+      if (shmfifo_unlikely(!ret)) {
+        __atomic_fetch_add(&ring->cons_retries, 1, __ATOMIC_RELAXED);
+      }
     }
   } while (shmfifo_unlikely(!ret));
 
@@ -172,39 +219,143 @@ ShmFifoRingMoveConsHead(struct ShmFifoRing *ring,
 
 static inline void
 ShmFifoRingUpdateTail(struct ShmFifoHeadTail *ht,
-    uint32_t old_val, uint32_t new_val,
-    uint32_t single, uint32_t enq)
+    uint32_t old_val, uint32_t new_val, uint32_t single)
 {
-  if (enq) {
-    SHMFIFO_RMB();
-  } else {
-    SHMFIFO_WMB();
-  }
-
   if (!single) {
-    while (shmfifo_unlikely(ht->tail != old_val)) {
+    while (shmfifo_unlikely(__atomic_load_n(&ht->tail, __ATOMIC_RELAXED) != old_val)) {
       SHMFIFO_PAUSE();
     }
   }
-  ht->tail = new_val;
+  __atomic_store_n(&ht->tail, new_val, __ATOMIC_RELEASE);
+}
+
+static inline void
+ShmFifoRingRtsUpdateTail(struct ShmFifoRtsHeadTail *ht)
+{
+  union ShmFifoPosCnt h;
+  union ShmFifoPosCnt ot;
+  union ShmFifoPosCnt nt;
+
+  ot.raw = __atomic_load_n(&ht->tail.raw, __ATOMIC_ACQUIRE);
+  do {
+    h.raw = __atomic_load_n(&ht->head.raw, __ATOMIC_RELAXED);
+    nt.raw = ot.raw;
+    if (++nt.val.cnt == h.val.cnt) {
+      nt.val.pos = h.val.pos;
+    }
+  } while (shmfifo_unlikely(!__atomic_compare_exchange_n(&ht->tail.raw, &ot.raw, nt.raw,
+      0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)));
+}
+
+static inline void
+ShmFifoRingRtsHeadWait(const struct ShmFifoRtsHeadTail *ht, union ShmFifoPosCnt *h)
+{
+  const uint32_t max = ht->htd_max;
+
+  while (h->val.pos - __atomic_load_n(&ht->tail.val.pos, __ATOMIC_RELAXED) > max) {
+    SHMFIFO_PAUSE();
+    h->raw = __atomic_load_n(&ht->head.raw, __ATOMIC_ACQUIRE);
+  }
+}
+
+static inline unsigned int
+ShmFifoRingRtsMoveProdHead(struct ShmFifoRing *ring,
+    unsigned int n, int behavior,
+    uint32_t *old_head, uint32_t *new_head, uint32_t *free_entries)
+{
+  const uint32_t      capacity = ring->capacity;
+  unsigned int        max = n;
+  union ShmFifoPosCnt oh;
+  union ShmFifoPosCnt nh;
+  int                 ret;
+
+  oh.raw = __atomic_load_n(&ring->rts_prod.head.raw, __ATOMIC_ACQUIRE);
+  do {
+    n = max;
+    ShmFifoRingRtsHeadWait(&ring->rts_prod, &oh);
+    *free_entries = capacity + __atomic_load_n(&ring->cons.tail, __ATOMIC_ACQUIRE) -
+        oh.val.pos;
+    if (shmfifo_unlikely(n > *free_entries)) {
+      n = (behavior == SHMFIFO_RING_QUEUE_FIXED) ? 0 : *free_entries;
+    }
+    if (n == 0) {
+      return 0;
+    }
+    nh.val.pos = oh.val.pos + n;
+    nh.val.cnt = oh.val.cnt + 1;
+    ret = __atomic_compare_exchange_n(&ring->rts_prod.head.raw, &oh.raw, nh.raw,
+        0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE);
+    if (shmfifo_unlikely(!ret)) {
+      __atomic_fetch_add(&ring->prod_retries, 1, __ATOMIC_RELAXED);
+    }
+  } while (shmfifo_unlikely(!ret));
+  *old_head = oh.val.pos;
+  *new_head = nh.val.pos;
+
+  return n;
+}
+
+static inline unsigned int
+ShmFifoRingRtsMoveConsHead(struct ShmFifoRing *ring,
+    unsigned int n, int behavior,
+    uint32_t *old_head, uint32_t *new_head, uint32_t *entries)
+{
+  unsigned int        max = n;
+  union ShmFifoPosCnt oh;
+  union ShmFifoPosCnt nh;
+  int                 ret;
+
+  oh.raw = __atomic_load_n(&ring->rts_cons.head.raw, __ATOMIC_ACQUIRE);
+  do {
+    n = max;
+    ShmFifoRingRtsHeadWait(&ring->rts_cons, &oh);
+    *entries = __atomic_load_n(&ring->prod.tail, __ATOMIC_ACQUIRE) - oh.val.pos;
+    if (shmfifo_unlikely(n > *entries)) {
+      n = (behavior == SHMFIFO_RING_QUEUE_FIXED) ? 0 : *entries;
+    }
+    if (n == 0) {
+      return 0;
+    }
+    nh.val.pos = oh.val.pos + n;
+    nh.val.cnt = oh.val.cnt + 1;
+    ret = __atomic_compare_exchange_n(&ring->rts_cons.head.raw, &oh.raw, nh.raw,
+        0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE);
+    if (shmfifo_unlikely(!ret)) {
+      __atomic_fetch_add(&ring->cons_retries, 1, __ATOMIC_RELAXED);
+    }
+  } while (shmfifo_unlikely(!ret));
+  *old_head = oh.val.pos;
+  *new_head = nh.val.pos;
+
+  return n;
 }
 
 static inline unsigned int
 ShmFifoRingDoEnqueue(struct ShmFifoRing *ring,
-    struct ShmFifoObj *obj_list, unsigned int n,
-    unsigned int is_sp, unsigned int *free_space)
+    struct ShmFifoObj *obj_list, unsigned int n, int behavior,
+    unsigned int sync_type, uint32_t *peer_tail, unsigned int *free_space)
 {
   uint32_t prod_head;
   uint32_t prod_next;
   uint32_t free_entries;
 
-  n = ShmFifoRingMoveProdHead(ring, is_sp, n,
-      &prod_head, &prod_next, &free_entries);
+  if (sync_type == SHMFIFO_RING_SYNC_MT_RTS) {
+    n = ShmFifoRingRtsMoveProdHead(ring, n, behavior,
+        &prod_head, &prod_next, &free_entries);
+  } else {
+    n = ShmFifoRingMoveProdHead(ring, sync_type == SHMFIFO_RING_SYNC_ST, n, behavior,
+        peer_tail, &prod_head, &prod_next, &free_entries);
+  }
   if (!n) {
     goto out;
   }
   SHMFIFO_ENQUEUE_ADDR(ring, &ring[1], prod_head, obj_list, n);
-  ShmFifoRingUpdateTail(&ring->prod, prod_head, prod_next, is_sp, 1);
+  if (sync_type == SHMFIFO_RING_SYNC_MT_RTS) {
+    ShmFifoRingRtsUpdateTail(&ring->rts_prod);
+  } else {
+    ShmFifoRingUpdateTail(&ring->prod, prod_head, prod_next,
+        sync_type == SHMFIFO_RING_SYNC_ST);
+  }
 out:
   if (free_space) {
     *free_space = free_entries - n;
@@ -214,20 +365,30 @@ out:
 
 static inline unsigned int
 ShmFifoRingDoDequeue(struct ShmFifoRing *ring,
-    struct ShmFifoObj *obj_list, unsigned int n,
-    unsigned int is_sc, unsigned int *available)
+    struct ShmFifoObj *obj_list, unsigned int n, int behavior,
+    unsigned int sync_type, uint32_t *peer_tail, unsigned int *available)
 {
   uint32_t cons_head;
   uint32_t cons_next;
   uint32_t entries;
 
-  n = ShmFifoRingMoveConsHead(ring, is_sc, n,
-      &cons_head, &cons_next, &entries);
+  if (sync_type == SHMFIFO_RING_SYNC_MT_RTS) {
+    n = ShmFifoRingRtsMoveConsHead(ring, n, behavior,
+        &cons_head, &cons_next, &entries);
+  } else {
+    n = ShmFifoRingMoveConsHead(ring, sync_type == SHMFIFO_RING_SYNC_ST, n, behavior,
+        peer_tail, &cons_head, &cons_next, &entries);
+  }
   if (!n) {
     goto out;
   }
   SHMFIFO_DEQUEUE_ADDR(ring, &ring[1], cons_head, obj_list, n);
-  ShmFifoRingUpdateTail(&ring->cons, cons_head, cons_next, is_sc, 0);
+  if (sync_type == SHMFIFO_RING_SYNC_MT_RTS) {
+    ShmFifoRingRtsUpdateTail(&ring->rts_cons);
+  } else {
+    ShmFifoRingUpdateTail(&ring->cons, cons_head, cons_next,
+        sync_type == SHMFIFO_RING_SYNC_ST);
+  }
 out:
   if (available) {
     *available = entries - n;
@@ -241,7 +402,8 @@ ShmFifoRingMultiProdEnqueueBulk(struct ShmFifoRing *ring,
     struct ShmFifoObj *obj_list, unsigned int n,
     unsigned int *free_space)
 {
-  return ShmFifoRingDoEnqueue(ring, obj_list, n, 0, free_space);
+  return ShmFifoRingDoEnqueue(ring, obj_list, n,
+      SHMFIFO_RING_QUEUE_FIXED, SHMFIFO_RING_SYNC_MT, NULL, free_space);
 }
 
 static inline unsigned int
@@ -249,7 +411,8 @@ ShmFifoRingSingleProdEnqueueBulk(struct ShmFifoRing *ring,
     struct ShmFifoObj *obj_list, unsigned int n,
     unsigned int *free_space)
 {
-  return ShmFifoRingDoEnqueue(ring, obj_list, n, 1, free_space);
+  return ShmFifoRingDoEnqueue(ring, obj_list, n,
+      SHMFIFO_RING_QUEUE_FIXED, SHMFIFO_RING_SYNC_ST, NULL, free_space);
 }
 
 static inline unsigned int
@@ -258,21 +421,23 @@ ShmFifoRingEnqueueBulk(struct ShmFifoRing *ring,
     unsigned int *free_space)
 {
   return ShmFifoRingDoEnqueue(ring, obj_list, n,
-      ring->prod.single, free_space);
+      SHMFIFO_RING_QUEUE_FIXED, ring->prod.sync_type, NULL, free_space);
 }
 
 static inline unsigned int
 ShmFifoRingMultiConsDequeueBulk(struct ShmFifoRing *ring,
     struct ShmFifoObj *obj_list, unsigned int n, unsigned int *available)
 {
-  return ShmFifoRingDoDequeue(ring, obj_list, n, 0, available);
+  return ShmFifoRingDoDequeue(ring, obj_list, n,
+      SHMFIFO_RING_QUEUE_FIXED, SHMFIFO_RING_SYNC_MT, NULL, available);
 }
 
 static inline unsigned int
 ShmFifoRinigSingleConsDequeueBulk(struct ShmFifoRing *ring,
     struct ShmFifoObj *obj_list, unsigned int n, unsigned int *available)
 {
-  return ShmFifoRingDoDequeue(ring, obj_list, n, 1, available);
+  return ShmFifoRingDoDequeue(ring, obj_list, n,
+      SHMFIFO_RING_QUEUE_FIXED, SHMFIFO_RING_SYNC_ST, NULL, available);
 }
 
 static inline unsigned int
@@ -281,15 +446,68 @@ ShmFifoRingDequeueBulk(struct ShmFifoRing *ring,
     unsigned int *available)
 {
   return ShmFifoRingDoDequeue(ring, obj_list, n,
-      ring->cons.single, available);
+      SHMFIFO_RING_QUEUE_FIXED, ring->cons.sync_type, NULL, available);
+}
+
+static inline unsigned int
+ShmFifoRingEnqueueBurst(struct ShmFifoRing *ring,
+    struct ShmFifoObj *obj_list, unsigned int n,
+    unsigned int *free_space)
+{
+  return ShmFifoRingDoEnqueue(ring, obj_list, n,
+      SHMFIFO_RING_QUEUE_VARIABLE, ring->prod.sync_type, NULL, free_space);
+}
+
+static inline unsigned int
+ShmFifoRingDequeueBurst(struct ShmFifoRing *ring,
+    struct ShmFifoObj *obj_list, unsigned int n,
+    unsigned int *available)
+{
+  return ShmFifoRingDoDequeue(ring, obj_list, n,
+      SHMFIFO_RING_QUEUE_VARIABLE, ring->cons.sync_type, NULL, available);
+}
+
+static inline unsigned int
+ShmFifoRingEnqueueCached(struct ShmFifoRing *ring, uint32_t *cons_tail,
+    struct ShmFifoObj *obj_list, unsigned int n, int behavior)
+{
+  uint32_t sync_type = ring->prod.sync_type;
+
+  return ShmFifoRingDoEnqueue(ring, obj_list, n, behavior, sync_type,
+      sync_type == SHMFIFO_RING_SYNC_ST ? cons_tail : NULL, NULL);
+}
+
+static inline unsigned int
+ShmFifoRingDequeueCached(struct ShmFifoRing *ring, uint32_t *prod_tail,
+    struct ShmFifoObj *obj_list, unsigned int n, int behavior)
+{
+  uint32_t sync_type = ring->cons.sync_type;
+
+  return ShmFifoRingDoDequeue(ring, obj_list, n, behavior, sync_type,
+      sync_type == SHMFIFO_RING_SYNC_ST ? prod_tail : NULL, NULL);
+}
+
+/*
+ * give back the last n objects dequeued by a single consumer, only valid
+ * for rings which can not overflow such as the object pool
+ */
+static inline void
+ShmFifoRingUndequeue(struct ShmFifoRing *ring,
+    struct ShmFifoObj *obj_list, unsigned int n)
+{
+  uint32_t head = __atomic_load_n(&ring->cons.head, __ATOMIC_RELAXED) - n;
+
+  SHMFIFO_ENQUEUE_ADDR(ring, &ring[1], head, obj_list, n);
+  __atomic_store_n(&ring->cons.head, head, __ATOMIC_RELAXED);
+  __atomic_store_n(&ring->cons.tail, head, __ATOMIC_RELEASE);
 }
 
 static inline unsigned int
 ShmFifoRingCount(const struct ShmFifoRing *ring)
 {
-  uint32_t prod_tail = ring->prod.tail;
-  uint32_t cons_tail = ring->cons.tail;
-  uint32_t count = (prod_tail - cons_tail) & ring->mask;
+  uint32_t prod_tail = __atomic_load_n(&ring->prod.tail, __ATOMIC_ACQUIRE);
+  uint32_t cons_tail = __atomic_load_n(&ring->cons.tail, __ATOMIC_ACQUIRE);
+  uint32_t count = prod_tail - cons_tail;
   return (count > ring->capacity) ? ring->capacity : count;
 }
 
@@ -323,21 +541,71 @@ ShmFifoRingGetCapacity(const struct ShmFifoRing *r)
   return r->capacity;
 }
 
+/* peek from an explicit read position, e.g. a broadcast cursor */
 static inline unsigned int
-ShmFifoRingHead(const struct ShmFifoRing *ring, struct ShmFifoObj *obj)
+ShmFifoRingPeekAt(const struct ShmFifoRing *ring, uint32_t head, uint32_t *prod_tail,
+    struct ShmFifoObj *obj_list, unsigned int n)
 {
-  uint32_t  head;
+  uint32_t  entries;
 
-  if (shmfifo_unlikely(!ShmFifoRingEmpty(ring))) {
-    return -SHMFIFO_ERR_EMPTY;
+  entries = *prod_tail - head;
+  if (entries < n || (int32_t)entries < 0) {
+    *prod_tail = __atomic_load_n(&ring->prod.tail, __ATOMIC_ACQUIRE);
+    entries = *prod_tail - head;
   }
-  do {
-    head = ring->cons.head;
-  } while (!ShmFifoRingCmpset32(&head, ring->cons.head, ring->cons.head));
+  if ((int32_t)entries < 0) {
+    entries = 0;
+  }
+  if (n > entries) {
+    n = entries;
+  }
+  if (shmfifo_unlikely(!n)) {
+    return 0;
+  }
+  SHMFIFO_DEQUEUE_ADDR(ring, &ring[1], head, obj_list, n);
 
-  SHMFIFO_DEQUEUE_ADDR(ring, &ring[1], head, obj, 1);
+  return n;
+}
 
-  return SHMFIFO_ERR_NO;
+/* the rts head keeps its position in the upper half, next to the count */
+static inline uint32_t
+ShmFifoRingConsHead(const struct ShmFifoRing *ring)
+{
+  if (ring->cons.sync_type == SHMFIFO_RING_SYNC_MT_RTS) {
+    return __atomic_load_n(&ring->rts_cons.head.val.pos, __ATOMIC_ACQUIRE);
+  }
+  return __atomic_load_n(&ring->cons.head, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * the cached producer tail is only trusted by a single consumer, other
+ * consumers may have moved the head past it
+ */
+static inline unsigned int
+ShmFifoRingPeekCached(const struct ShmFifoRing *ring, uint32_t *prod_tail,
+    struct ShmFifoObj *obj_list, unsigned int n)
+{
+  uint32_t head = ShmFifoRingConsHead(ring);
+
+  if (ring->cons.sync_type != SHMFIFO_RING_SYNC_ST) {
+    *prod_tail = __atomic_load_n(&ring->prod.tail, __ATOMIC_ACQUIRE);
+  }
+  return ShmFifoRingPeekAt(ring, head, prod_tail, obj_list, n);
+}
+
+static inline unsigned int
+ShmFifoRingPeekBurst(const struct ShmFifoRing *ring,
+    struct ShmFifoObj *obj_list, unsigned int n)
+{
+  uint32_t prod_tail = __atomic_load_n(&ring->prod.tail, __ATOMIC_ACQUIRE);
+
+  return ShmFifoRingPeekCached(ring, &prod_tail, obj_list, n);
+}
+
+static inline unsigned int
+ShmFifoRingHead(const struct ShmFifoRing *ring, struct ShmFifoObj *obj)
+{
+  return ShmFifoRingPeekBurst(ring, obj, 1);
 }
 #ifdef __cplusplus
 } 
@@ -0,0 +1,56 @@
+#ifndef SHMFIFO_STATS_H_
+#define SHMFIFO_STATS_H_
+
+#include <stdint.h>
+
+#include "shmfifo_define.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* written by producers only, max_depth is in bytes for varlen fifos */
+struct ShmFifoProdStats {
+  uint64_t pushes;
+  uint64_t bytes;
+  uint64_t full;
+  uint64_t max_depth;
+} SHMFIFO_CACHELINE_ALIGN;
+
+/* written by consumers only */
+struct ShmFifoConsStats {
+  uint64_t pops;
+  uint64_t empty;
+} SHMFIFO_CACHELINE_ALIGN;
+
+/* in the shared header, only updated with SHMFIFO_FLAG_STATS */
+struct ShmFifoStatsBlock {
+  struct ShmFifoProdStats prod;
+  struct ShmFifoConsStats cons;
+};
+
+/* a side with a single writer skips the locked add */
+static inline void
+ShmFifoStatAdd(uint64_t *counter, uint64_t v, int shared)
+{
+  if (shared) {
+    __atomic_fetch_add(counter, v, __ATOMIC_RELAXED);
+  } else {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + v,
+      __ATOMIC_RELAXED);
+  }
+}
+
+static inline void
+ShmFifoStatMax(uint64_t *max, uint64_t v)
+{
+  uint64_t cur = __atomic_load_n(max, __ATOMIC_RELAXED);
+
+  while (v > cur && !__atomic_compare_exchange_n(max, &cur, v, 0, __ATOMIC_RELAXED,
+      __ATOMIC_RELAXED));
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,113 @@
+#ifndef SHMFIFO_WAIT_H_
+#define SHMFIFO_WAIT_H_
+
+#include <stdint.h>
+#include <time.h>
+#include <x86intrin.h>
+
+#include "shmfifo_define.h"
+#include "shmfifo_error.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHMFIFO_RDTSC() __rdtsc()
+/*
+ * no x86 tsc ticks slower than this, spinning timeout_us times as many
+ * ticks never outlasts the timeout
+ */
+#define SHMFIFO_TSC_PER_US_MIN (1000ULL)
+
+/* futex word in shared memory, seq is bumped on every wake */
+struct ShmFifoWaitQueue {
+  uint32_t seq;
+  uint32_t waiters;
+} SHMFIFO_CACHELINE_ALIGN;
+
+/* per call wait state, spins for spin_end tsc then sleeps on the futex */
+struct ShmFifoWaiter {
+  struct ShmFifoWaitQueue *wq;
+  uint64_t                 spin_end;
+  struct timespec          deadline;
+  uint32_t                 seq;
+  int                      timeout_us;
+  int                      armed;
+};
+
+void ShmFifoWaitInit(struct ShmFifoWaitQueue *wq);
+int ShmFifoWaitSleep(struct ShmFifoWaitQueue *wq, uint32_t seq,
+  const struct timespec *deadline);
+void ShmFifoWaitWakeAll(struct ShmFifoWaitQueue *wq);
+
+/* called after publishing, pairs with the fence in ShmFifoWaitNext */
+static inline void
+ShmFifoWaitWake(struct ShmFifoWaitQueue *wq)
+{
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (shmfifo_unlikely(__atomic_load_n(&wq->waiters, __ATOMIC_RELAXED))) {
+    ShmFifoWaitWakeAll(wq);
+  }
+}
+
+static inline void
+ShmFifoWaitBegin(struct ShmFifoWaiter *w, struct ShmFifoWaitQueue *wq,
+  uint64_t spin_cycles, int timeout_us)
+{
+  w->wq = wq;
+  if (timeout_us >= 0 && spin_cycles > (uint64_t)timeout_us * SHMFIFO_TSC_PER_US_MIN) {
+    spin_cycles = (uint64_t)timeout_us * SHMFIFO_TSC_PER_US_MIN;
+  }
+  w->spin_end = spin_cycles ? SHMFIFO_RDTSC() + spin_cycles : 0;
+  w->timeout_us = timeout_us;
+  w->armed = SHMFIFO_FALSE;
+  if (timeout_us >= 0) {
+    clock_gettime(CLOCK_MONOTONIC, &w->deadline);
+    w->deadline.tv_sec += timeout_us / 1000000;
+    w->deadline.tv_nsec += (long)(timeout_us % 1000000) * 1000;
+    if (w->deadline.tv_nsec >= 1000000000L) {
+      w->deadline.tv_sec++;
+      w->deadline.tv_nsec -= 1000000000L;
+    }
+  }
+}
+
+/*
+ * called each time the caller's try failed, the caller must try again
+ * after every SHMFIFO_ERR_NO return, the first try after arming is the
+ * one that closes the race with ShmFifoWaitWake
+ */
+static inline int
+ShmFifoWaitNext(struct ShmFifoWaiter *w)
+{
+  int ret;
+
+  if (!w->armed) {
+    if (SHMFIFO_RDTSC() < w->spin_end) {
+      SHMFIFO_PAUSE();
+      return SHMFIFO_ERR_NO;
+    }
+    w->seq = __atomic_load_n(&w->wq->seq, __ATOMIC_ACQUIRE);
+    __atomic_fetch_add(&w->wq->waiters, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    w->armed = SHMFIFO_TRUE;
+    return SHMFIFO_ERR_NO;
+  }
+  ret = ShmFifoWaitSleep(w->wq, w->seq, w->timeout_us < 0 ? NULL : &w->deadline);
+  __atomic_fetch_sub(&w->wq->waiters, 1, __ATOMIC_RELAXED);
+  w->armed = SHMFIFO_FALSE;
+  return ret;
+}
+
+static inline void
+ShmFifoWaitEnd(struct ShmFifoWaiter *w)
+{
+  if (w->armed) {
+    __atomic_fetch_sub(&w->wq->waiters, 1, __ATOMIC_RELAXED);
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
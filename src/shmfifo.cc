@@ -5,136 +5,440 @@
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+#include <linux/memfd.h>
 #include <fcntl.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
 #include "shmfifo_ring.h"
 #include "shmfifo_obj_pool.h"
+#include "shmfifo_wait.h"
+#include "shmfifo_event.h"
+#include "shmfifo_cursor.h"
+#include "shmfifo_byte_ring.h"
+#include "shmfifo_cell_ring.h"
+#include "shmfifo_copy.h"
+#include "shmfifo_header.h"
+#include "shmfifo_prefault.h"
+#include "shmfifo_numa.h"
 #include "shmfifo_log.h"
 #include "shmfifo_error.h"
 #include "shmfifo_define.h"
 #include "shmfifo_utils.h"
 
-#ifndef SHMFIFO_MAGIC
-#define SHMFIFO_MAGIC 0x4649464F //SHMFIFO
-#endif
+/* modes where slot i belongs to list position i and there is no obj_pool */
+#define SHMFIFO_FLAG_SLOT_MAPPED (SHMFIFO_FLAG_DIRECT | SHMFIFO_FLAG_BROADCAST)
+/* modes without ShmFifoObj descriptors or an obj_pool */
+#define SHMFIFO_FLAG_NO_POOL (SHMFIFO_FLAG_SLOT_MAPPED | SHMFIFO_FLAG_VARLEN | \
+  SHMFIFO_FLAG_INLINE)
 
-#ifndef SHMFIFO_MAJOR
-#define SHMFIFO_MAJOR (1U)
-#endif
+#define shmfifo_memcpy(_dst, _src, _size) ShmFifoCopy(_dst, _src, _size)
 
-#ifndef SHMFIFO_MINOR
-#define SHMFIFO_MINOR  (0U)
-#endif
-
-#ifndef SHMFIFO_VERSION
-#define SHMFIFO_VERSION ((SHMFIFO_MAJOR << 16) | SHMFIFO_MINOR)
-#endif
+/* last seen peer tails, only trusted when the own side is single threaded */
+struct ShmFifoPeerCache {
+  uint32_t          list_tail;
+  uint32_t          pool_tail;
+  uint64_t          byte_tail;
+  uint32_t          class_tail[SHMFIFO_CLASS_MAX];
+} SHMFIFO_CACHELINE_ALIGN;
 
-#ifdef SHMFIFO_FAST_MEMCPY
-#include "shmfifo_memcpy.h"
-#define shmfifo_memcpy(_dst, _src, _size) fifo_fast_memcpy(_dst, _src, _size)
-#else
-#define shmfifo_memcpy(_dst, _src, _size) memcpy(_dst, _src, _size);
-#endif
+/* process local view of a size class, classes ascend by msg_size and data offset */
+struct ShmFifoSlotClass {
+  struct ShmFifoRing *pool;
+  size_t              msg_size;
+  size_t              data_end;
+};
 
+/* process local handle */
 struct ShmFifo {
-  uint32_t          magic;
-  uint32_t          version;
-  int               fd;
-  char             *start_addr;
-  size_t            total_size;
-  size_t            list_size;
-  size_t            msg_size;
-  size_t            msg_count;
-  time_t            create_time;
-  pid_t             creator;
-  struct ShmFifoRing  *list; 
-  struct ShmFifoRing  *obj_pool; 
-} SHMFIFO_CACHELINE_ALIGN;
+  struct ShmFifoHeader *header;
+  struct ShmFifoRing   *list;
+  struct ShmFifoRing   *obj_pool;
+  struct ShmFifoCursorTable *cursors;
+  struct ShmFifoCursor *cursor;
+  struct ShmFifoByteRing *bytes;
+  char                 *start_addr;
+  size_t                msg_size;
+  size_t                data_size;
+  size_t                total_size;
+  size_t                map_size;
+  size_t                reserve_size;
+  uint64_t              spin_cycles;
+  size_t                nt_threshold;
+  uint32_t              prefetch;
+  uint32_t              mask;
+  uint32_t              flags;
+  uint32_t              class_num;
+  int                   fd;
+  int                   event_fd;
+  struct ShmFifoSlotClass classes[SHMFIFO_CLASS_MAX];
+  struct ShmFifoPeerCache prod;
+  struct ShmFifoPeerCache cons;
+  struct ShmFifoCell    stage;
+};
 
 static int ShmFifoFormat(int fd, size_t size);
-static int ShmFifoFileReady(int fd, size_t size);
-static int ShmFifoLoadVersion(int fd, uint32_t *magic, uint32_t *version);
-static void ShmFifoReset(struct ShmFifo *fifo, size_t total_size, size_t list_size,
-  size_t msg_size, size_t msg_count, int fd);
+static int ShmFifoFileReady(int fd, size_t size, uint32_t flags);
+static int ShmFifoLoadVersion(int fd, uint32_t *magic, uint32_t *version, uint32_t *flags,
+  uint32_t *page_size);
+static void ShmFifoReset(struct ShmFifoHeader *header, size_t total_size, size_t list_size,
+  size_t ring_size, size_t msg_size, size_t msg_count, size_t data_size, uint32_t flags,
+  const struct ShmFifoClass *classes, uint32_t class_num);
+static int ShmFifoClassInit(const struct ShmFifoAttr *attr, size_t msg_size, size_t msg_count,
+  struct ShmFifoClass *classes, uint32_t *class_num);
+static int ShmFifoClassMatch(const struct ShmFifoHeader *header,
+  const struct ShmFifoClass *classes, uint32_t class_num);
+static inline size_t ShmFifoRingMemSize(uint32_t count);
+static int ShmFifoCheckFlags(uint32_t flags);
+static int ShmFifoCheckPageSize(const char *path, size_t page);
+static struct ShmFifo *ShmFifoHandle(struct ShmFifoHeader *header, int fd);
+static void *ShmFifoMap(int fd, size_t total_size, size_t data_size, size_t page,
+  uint32_t flags, int populate);
+static int ShmFifoOpenFile(const char *path, size_t page);
+static size_t ShmFifoPageSize(int fd, size_t page, int *hugetlb);
+static inline int ShmFifoDataObj(const struct ShmFifo *fifo, const void *buf,
+  struct ShmFifoObj *obj);
+static inline ssize_t ShmFifoDoPushBulk(struct ShmFifo *fifo, const struct iovec *iov,
+  unsigned int n, int behavior);
+static inline unsigned int ShmFifoSlotAlloc(struct ShmFifo *fifo,
+  struct ShmFifoObj *obj_list, unsigned int n, int behavior);
+static inline unsigned int ShmFifoSlotFree(struct ShmFifo *fifo,
+  struct ShmFifoObj *obj_list, unsigned int n);
+static inline unsigned int ShmFifoSlotUnalloc(struct ShmFifo *fifo,
+  struct ShmFifoObj *obj_list, unsigned int n);
+static inline unsigned int ShmFifoSlotAllocSize(struct ShmFifo *fifo,
+  struct ShmFifoObj *obj, size_t size);
+static inline size_t ShmFifoSlotSize(const struct ShmFifo *fifo, size_t offset);
+static inline uint32_t ShmFifoClassOf(const struct ShmFifo *fifo, size_t offset);
+static unsigned int ShmFifoClassAlloc(struct ShmFifo *fifo, struct ShmFifoObj *obj,
+  size_t size);
+static unsigned int ShmFifoClassFree(struct ShmFifo *fifo, struct ShmFifoObj *obj_list,
+  unsigned int n);
+static unsigned int ShmFifoClassUnalloc(struct ShmFifo *fifo, struct ShmFifoObj *obj_list,
+  unsigned int n);
+static ssize_t ShmFifoDirectPopData(struct ShmFifo *fifo, char* const buf,
+  const size_t buf_size);
+static inline unsigned int ShmFifoListPeek(struct ShmFifo *fifo,
+  struct ShmFifoObj *obj_list, unsigned int n);
+static int ShmFifoCursorPop(struct ShmFifo *fifo, unsigned int n);
+static inline void ShmFifoPutData(const struct ShmFifo *fifo, void *dst,
+  const void *src, size_t size);
+static inline void ShmFifoListPrefetch(const struct ShmFifo *fifo);
+static inline void ShmFifoBytePrefetch(const struct ShmFifo *fifo, uint64_t pos);
+static inline void ShmFifoNotifyConsumer(struct ShmFifo *fifo, unsigned int n,
+  size_t bytes);
+static inline void ShmFifoNotifyProducer(struct ShmFifo *fifo, unsigned int n);
+static void ShmFifoStatPush(struct ShmFifo *fifo, unsigned int n, size_t bytes);
+static inline void ShmFifoStatFull(struct ShmFifo *fifo);
+static inline void ShmFifoStatEmpty(struct ShmFifo *fifo);
+static int ShmFifoRingFlags(uint32_t flags, int mp, int mc);
+static ssize_t ShmFifoBytePush(struct ShmFifo *fifo, const struct iovec *iov,
+  unsigned int n, int behavior);
+static unsigned int ShmFifoBytePeek(struct ShmFifo *fifo, struct iovec *iov,
+  unsigned int n);
+static unsigned int ShmFifoByteSpan(struct ShmFifo *fifo, struct iovec *span,
+  unsigned int n);
+static int ShmFifoBytePop(struct ShmFifo *fifo, unsigned int n);
+static ssize_t ShmFifoBytePopData(struct ShmFifo *fifo, char* const buf,
+  const size_t buf_size);
+static void *ShmFifoByteReserve(struct ShmFifo *fifo, const size_t size);
+static ssize_t ShmFifoByteCommit(struct ShmFifo *fifo, void *buf, const size_t size);
+static int ShmFifoByteAbort(struct ShmFifo *fifo, void *buf);
+static ssize_t ShmFifoCellPush(struct ShmFifo *fifo, const struct iovec *iov,
+  unsigned int n, int behavior);
+static unsigned int ShmFifoCellPeek(struct ShmFifo *fifo, struct iovec *iov,
+  unsigned int n);
+static int ShmFifoCellPop(struct ShmFifo *fifo, unsigned int n);
+static ssize_t ShmFifoCellPopData(struct ShmFifo *fifo, char* const buf,
+  const size_t buf_size);
+static void *ShmFifoCellReserve(struct ShmFifo *fifo, const size_t size);
+static ssize_t ShmFifoCellCommit(struct ShmFifo *fifo, void *buf, const size_t size);
+static int ShmFifoCellAbort(struct ShmFifo *fifo, void *buf);
 
 //#pragma GCC push_options
 //#pragma GCC optimize("O0")
+void ShmFifoAttrInit(struct ShmFifoAttr *attr)
+{
+  attr->flags = 0;
+  attr->spin_cycles = SHMFIFO_SPIN_CYCLES;
+  attr->nt_threshold = 0;
+  attr->prefetch = 0;
+  attr->prefault = SHMFIFO_PREFAULT_TOUCH;
+  attr->prefault_threads = 0;
+  attr->page_size = 0;
+  attr->numa_node = SHMFIFO_NUMA_NONE;
+  attr->numa_interleave = 0;
+  memset(attr->class_size, 0, sizeof(attr->class_size));
+  memset(attr->class_count, 0, sizeof(attr->class_count));
+}
+
 struct ShmFifo* ShmFifoOpen(const char *path, size_t msg_size, size_t msg_count)
+{
+  return ShmFifoOpenAttr(path, msg_size, msg_count, NULL);
+}
+
+struct ShmFifo* ShmFifoOpenAttr(const char *path, size_t msg_size, size_t msg_count,
+  const struct ShmFifoAttr *attr)
 {
   struct ShmFifo   *fifo = NULL;
+  struct ShmFifoHeader *header;
+  struct ShmFifoAttr def_attr;
   size_t         list_size;
+  size_t         ring_size;
+  size_t         data_size;
   size_t         total_size;
-  size_t         i;
+  size_t         map_size;
+  size_t         record;
+  size_t         pool_size;
+  uint32_t       align;
+  uint32_t       list_count = 0;
+  uint32_t       class_num = 0;
+  uint32_t       c;
+  uint32_t       prefault;
+  struct ShmFifoClass classes[SHMFIFO_CLASS_MAX];
+  size_t         page;
+  int            hugetlb = 0;
   int            fd;
   int            ready;
+  int            ret = SHMFIFO_ERR_NO;
 
-  msg_size = SHMFIFO_SIZE_ALIGN(msg_size, 1024);
-  msg_count = Power2Align32(msg_count + 1);
-  list_size = sizeof(struct ShmFifoObj) * msg_count + sizeof(struct ShmFifoRing);
-  list_size = SHMFIFO_SIZE_ALIGN(list_size, SHMFIFO_CACHE_LINE);
-  total_size = msg_size * msg_count;
-  total_size += sizeof(struct ShmFifo) + (list_size << 1);
-  total_size = SHMFIFO_SIZE_ALIGN(total_size, SHMFIFO_PAGE_SIZE);
+  if (!attr) {
+    ShmFifoAttrInit(&def_attr);
+    attr = &def_attr;
+  }
+  if (ShmFifoCheckFlags(attr->flags) != SHMFIFO_ERR_NO) {
+    return NULL;
+  }
+  if ((attr->prefault & SHMFIFO_PREFAULT_MODE) > SHMFIFO_PREFAULT_LAZY ||
+      (attr->prefault & ~(SHMFIFO_PREFAULT_MODE | SHMFIFO_PREFAULT_NOLOCK))) {
+    SHMFIFO_ERR_OUT("ShmFifoOpen failed, prefault %x error", attr->prefault);
+    return NULL;
+  }
+  if (msg_size > UINT32_MAX) {
+    SHMFIFO_ERR_OUT("ShmFifoOpen failed, msg size %lu, max %u error", msg_size, UINT32_MAX);
+    return NULL;
+  }
+  if (ShmFifoCheckPageSize(path, attr->page_size) != SHMFIFO_ERR_NO) {
+    return NULL;
+  }
+  if (attr->numa_node < SHMFIFO_NUMA_LOCAL) {
+    SHMFIFO_ERR_OUT("ShmFifoOpen failed, numa node %d error", attr->numa_node);
+    return NULL;
+  }
+  if (!path && (attr->flags & SHMFIFO_FLAG_EVENT)) {
+    SHMFIFO_ERR_OUT("ShmFifoOpen failed, event mode requires a path, flags %x", attr->flags);
+    return NULL;
+  }
 
-  fd = open(path, O_CREAT | O_RDWR, 0666);
+  fd = ShmFifoOpenFile(path, attr->page_size);
   if (fd < 0) {
-    SHMFIFO_ERR_OUT("ShmFifoOpen failed, open error %s, err %d", path, errno);
+    SHMFIFO_ERR_OUT("ShmFifoOpen failed, open error %s, err %d", path ? path : "memfd", errno);
     return NULL;
   }
-  ready = ShmFifoFileReady(fd, total_size); 
+  page = ShmFifoPageSize(fd, attr->page_size, &hugetlb);
+  if (!page) {
+    goto SHMFIFO_DO_CLOSE;
+  }
+  align = (attr->flags & SHMFIFO_FLAG_ALIGN64) ? SHMFIFO_CACHE_LINE : sizeof(uint64_t);
+  if (attr->flags & SHMFIFO_FLAG_VARLEN) {
+    if (ShmFifoClassInit(attr, msg_size, msg_count, classes, &class_num) != SHMFIFO_ERR_NO) {
+      goto SHMFIFO_DO_CLOSE;
+    }
+    /* msg_count records of msg_size fit, plus one record of filler slack */
+    record = SHMFIFO_SIZE_ALIGN(SHMFIFO_BYTE_HDR_SIZE + msg_size, align);
+    data_size = Power2Align64(record * (msg_count + 1));
+    if ((attr->flags & SHMFIFO_FLAG_MIRROR) && data_size < page) {
+      data_size = page;
+    }
+    list_size = sizeof(struct ShmFifoByteRing);
+    ring_size = list_size;
+  } else if (attr->flags & SHMFIFO_FLAG_INLINE) {
+    if (msg_size > SHMFIFO_CELL_DATA) {
+      SHMFIFO_ERR_OUT("ShmFifoOpen failed, msg size %lu, inline max %lu error", msg_size,
+        SHMFIFO_CELL_DATA);
+      goto SHMFIFO_DO_CLOSE;
+    }
+    if (ShmFifoClassInit(attr, msg_size, msg_count, classes, &class_num) != SHMFIFO_ERR_NO) {
+      goto SHMFIFO_DO_CLOSE;
+    }
+    /* the cells are the data, nothing follows the list */
+    msg_count = Power2Align32(msg_count);
+    list_count = msg_count;
+    data_size = 0;
+    list_size = ShmFifoCellRingMemSize(list_count);
+    ring_size = list_size;
+  } else {
+    msg_size = SHMFIFO_SIZE_ALIGN(msg_size, 1024);
+    /* the slot size and its offsets go into 32 bit descriptor fields */
+    if (msg_size > UINT32_MAX) {
+      SHMFIFO_ERR_OUT("ShmFifoOpen failed, slot size %lu, max %u error", msg_size, UINT32_MAX);
+      goto SHMFIFO_DO_CLOSE;
+    }
+    msg_count = Power2Align32(msg_count + 1);
+    while ((attr->flags & SHMFIFO_FLAG_MIRROR) && (msg_size * msg_count) % page) {
+      msg_count <<= 1;
+    }
+    if (ShmFifoClassInit(attr, msg_size, msg_count, classes, &class_num) != SHMFIFO_ERR_NO) {
+      goto SHMFIFO_DO_CLOSE;
+    }
+    /* the list carries every slot of every class, each class has its own pool */
+    list_count = msg_count;
+    data_size = msg_size * msg_count;
+    pool_size = ShmFifoRingMemSize(msg_count);
+    for (c = 0; c + 1 < class_num; ++c) {
+      list_count += classes[c].msg_count;
+      data_size += classes[c].msg_size * classes[c].msg_count;
+      pool_size += ShmFifoRingMemSize(classes[c].msg_count);
+    }
+    if (data_size > SHMFIFO_OBJ_DATA_MAX) {
+      SHMFIFO_ERR_OUT("ShmFifoOpen failed, data size %lu, max %lu error", data_size,
+        SHMFIFO_OBJ_DATA_MAX);
+      goto SHMFIFO_DO_CLOSE;
+    }
+    list_count = Power2Align32(list_count);
+    list_size = ShmFifoRingMemSize(list_count);
+    if (attr->flags & SHMFIFO_FLAG_BROADCAST) {
+      ring_size = list_size + sizeof(struct ShmFifoCursorTable);
+    } else if (attr->flags & SHMFIFO_FLAG_DIRECT) {
+      ring_size = list_size;
+    } else {
+      ring_size = list_size + pool_size;
+    }
+  }
+  if (attr->flags & SHMFIFO_FLAG_MIRROR) {
+    /* the data region must start on a page and end the file to be mapped twice */
+    ring_size = SHMFIFO_SIZE_ALIGN(sizeof(struct ShmFifoHeader) + ring_size,
+      page) - sizeof(struct ShmFifoHeader);
+  }
+  total_size = data_size;
+  total_size += sizeof(struct ShmFifoHeader) + ring_size;
+  total_size = SHMFIFO_SIZE_ALIGN(total_size, page);
+  map_size = (attr->flags & SHMFIFO_FLAG_MIRROR) ? total_size + data_size : total_size;
+
+  ready = ShmFifoFileReady(fd, total_size, attr->flags); 
+  if (ready < 0) {
+    goto SHMFIFO_DO_CLOSE;
+  }
+  /*
+   * the creator already brought every page into the page cache, attaching
+   * only maps it and takes the minor faults on first use
+   */
+  prefault = attr->prefault;
   if (ready == SHMFIFO_TRUE) {
+    prefault = SHMFIFO_PREFAULT_LAZY | (prefault & SHMFIFO_PREFAULT_NOLOCK);
     goto SHMFIFO_DO_MAP;
   }
   if (ShmFifoFormat(fd, total_size) != SHMFIFO_ERR_NO) {
-    close(fd);
-    goto SHMFIFO_DO_EXIT;
+    goto SHMFIFO_DO_CLOSE;
   }
 
 SHMFIFO_DO_MAP:
-  fifo = (struct ShmFifo *)mmap(NULL, total_size, PROT_READ | PROT_WRITE,
-    MAP_SHARED, fd, 0); 
-  if (!fifo || fifo == (void *)MAP_FAILED) {
-    SHMFIFO_ERR_OUT("ShmFifoOpen failed, mmap error %s, err %d", path, errno);
-    close(fd);
-    goto SHMFIFO_DO_EXIT;
+  header = (struct ShmFifoHeader *)ShmFifoMap(fd, total_size, data_size, page, attr->flags,
+    (prefault & SHMFIFO_PREFAULT_MODE) == SHMFIFO_PREFAULT_POPULATE);
+  if (!header || header == (void *)MAP_FAILED) {
+    SHMFIFO_ERR_OUT("ShmFifoOpen failed, mmap error %s, err %d", path ? path : "memfd", errno);
+    goto SHMFIFO_DO_CLOSE;
   }
 
-  if (madvise(fifo, total_size, MADV_SEQUENTIAL) < 0) {
-    SHMFIFO_ERR_OUT("ShmFifoOpen failed, madvise failed, err %d", errno);
-    munmap(fifo, total_size);
-    close(fd);
-    goto SHMFIFO_DO_EXIT;
+  /* placement is only set on creation, attaching finds the pages where they are */
+  if (ready != SHMFIFO_TRUE && (attr->numa_node != SHMFIFO_NUMA_NONE ||
+      attr->numa_interleave) && ShmFifoNumaBind(header, sizeof(struct ShmFifoHeader) +
+      ring_size, total_size, page, attr->numa_node, attr->numa_interleave) < 0) {
+    goto SHMFIFO_DO_UNMAP;
   }
 
-  if (mlock(fifo, total_size) < 0) {
-    SHMFIFO_ERR_OUT("ShmFifoOpen failed, mlock failed, err %d", errno);
-    munmap(fifo, total_size);
-    close(fd);
-    goto SHMFIFO_DO_EXIT;
+  /* outside hugetlbfs a page above the base one asks for transparent huge pages */
+  if (!hugetlb && page > (size_t)sysconf(_SC_PAGESIZE) &&
+      madvise(header, map_size, MADV_HUGEPAGE) < 0) {
+    SHMFIFO_DEBUG_OUT("ShmFifoOpen madvise hugepage failed, err %d", errno);
   }
 
+  if (madvise(header, map_size, MADV_SEQUENTIAL) < 0) {
+    SHMFIFO_ERR_OUT("ShmFifoOpen failed, madvise failed, err %d", errno);
+    goto SHMFIFO_DO_UNMAP;
+  }
 
-  fifo->list = (struct ShmFifoRing *)&fifo[1];
-  fifo->obj_pool = (struct ShmFifoRing *)((char *)fifo->list + list_size);
-  fifo->start_addr = (char *)fifo->obj_pool + list_size;
+  /* threads fault the pages in first so mlock finds them present */
+  if ((prefault & SHMFIFO_PREFAULT_MODE) == SHMFIFO_PREFAULT_THREADS) {
+    ShmFifoPrefault(header, total_size, page, attr->prefault_threads);
+  }
+  if (!(prefault & SHMFIFO_PREFAULT_NOLOCK) && ShmFifoLock(header, map_size,
+      (prefault & SHMFIFO_PREFAULT_MODE) == SHMFIFO_PREFAULT_LAZY) < 0) {
+    SHMFIFO_ERR_OUT("ShmFifoOpen failed, mlock failed, err %d", errno);
+    goto SHMFIFO_DO_UNMAP;
+  }
 
   if (ready != SHMFIFO_TRUE) {
-    ShmFifoReset(fifo, total_size, list_size, msg_size, msg_count, fd);
-    ShmFifoObjPoolInit(fifo->obj_pool, msg_size, msg_count);
-    ShmFifoRingInit(fifo->list, msg_count, SHMFIFO_RING_SP_ENQ | SHMFIFO_RING_SC_DEQ);
-  } else if (fifo->msg_size != msg_size || fifo->msg_count != msg_count) {
+    ShmFifoReset(header, total_size, list_size, ring_size, msg_size, msg_count, data_size,
+      attr->flags, classes, class_num);
+    header->page_size = (uint32_t)page;
+    for (c = 0; c < class_num && ret == SHMFIFO_ERR_NO; ++c) {
+      ret = ShmFifoObjPoolInit(
+        (struct ShmFifoRing *)((char *)header + header->classes[c].pool_offset),
+        header->classes[c].data_offset, header->classes[c].msg_size,
+        header->classes[c].msg_count, ShmFifoRingFlags(attr->flags,
+          attr->flags & SHMFIFO_SYNC_MPMC, attr->flags & SHMFIFO_FLAG_MP));
+    }
+    if (ret == SHMFIFO_ERR_NO && header->obj_pool_offset && !class_num) {
+      ret = ShmFifoObjPoolInit((struct ShmFifoRing *)((char *)header + header->obj_pool_offset),
+        0, msg_size, msg_count, ShmFifoRingFlags(attr->flags,
+          attr->flags & SHMFIFO_SYNC_MPMC, attr->flags & SHMFIFO_FLAG_MP));
+    }
+    if (ret != SHMFIFO_ERR_NO) {
+      SHMFIFO_ERR_OUT("ShmFifoOpen failed, obj pool init err %d", ret);
+      /* a half filled pool must not pass for a formatted fifo on the next open */
+      header->magic = 0;
+      goto SHMFIFO_DO_UNLOCK;
+    }
+    if (header->cursor_offset) {
+      ShmFifoCursorTableInit(
+        (struct ShmFifoCursorTable *)((char *)header + header->cursor_offset));
+    }
+    if (attr->flags & SHMFIFO_FLAG_VARLEN) {
+      ShmFifoByteRingInit((struct ShmFifoByteRing *)((char *)header + header->list_offset),
+        data_size, align, !!(attr->flags & SHMFIFO_FLAG_MIRROR));
+    } else {
+      ShmFifoRingInit((struct ShmFifoRing *)((char *)header + header->list_offset),
+        list_count, ShmFifoRingFlags(attr->flags,
+          attr->flags & SHMFIFO_FLAG_MP, attr->flags & SHMFIFO_FLAG_MC));
+    }
+  } else if (header->msg_size != msg_size || header->msg_count != msg_count) {
     SHMFIFO_ERR_OUT("ShmFifoOpen capacity error, %lu * %lu != %lu * %lu",
-      msg_size, msg_count, fifo->msg_size, fifo->msg_count);
-    ShmFifoClose(fifo);
-    goto SHMFIFO_DO_EXIT;
+      msg_size, msg_count, header->msg_size, header->msg_count);
+    goto SHMFIFO_DO_UNLOCK;
+  } else if (!ShmFifoClassMatch(header, classes, class_num)) {
+    goto SHMFIFO_DO_UNLOCK;
+  }
+  if ((prefault & SHMFIFO_PREFAULT_MODE) == SHMFIFO_PREFAULT_TOUCH) {
+    ShmFifoPrefault(header, total_size, page, 1);
   }
-  for (i = 0; i < total_size; i += SHMFIFO_PAGE_SIZE) {
-    (void)(((char *)fifo)[i]);
-  }  
 
+  fifo = ShmFifoHandle(header, fd);
+  if (fifo) {
+    fifo->map_size = map_size;
+    fifo->spin_cycles = attr->spin_cycles;
+    fifo->nt_threshold = attr->nt_threshold;
+    fifo->prefetch = attr->prefetch;
+    if (!(attr->flags & SHMFIFO_FLAG_EVENT)) {
+      goto SHMFIFO_DO_EXIT;
+    }
+    fifo->event_fd = ShmFifoEventOpen(path);
+    if (fifo->event_fd >= 0) {
+      goto SHMFIFO_DO_EXIT;
+    }
+    free(fifo);
+    fifo = NULL;
+  }
+
+SHMFIFO_DO_UNLOCK:
+  munlock(header, map_size);
+SHMFIFO_DO_UNMAP:
+  munmap(header, map_size);
+SHMFIFO_DO_CLOSE:
+  close(fd);
 SHMFIFO_DO_EXIT:
   return fifo;  
 }
@@ -142,109 +446,1590 @@ SHMFIFO_DO_EXIT:
 
 void ShmFifoClose(struct ShmFifo *fifo)
 {
-  int fd = fifo->fd;
-  munlock(fifo, fifo->total_size);  
-  munmap(fifo, fifo->total_size);
-  close(fd);
+  if (fifo->cursor) {
+    ShmFifoCursorRelease(fifo->cursor);
+  }
+  munlock(fifo->header, fifo->map_size);
+  munmap(fifo->header, fifo->map_size);
+  close(fifo->fd);
+  if (fifo->event_fd != SHMFIFO_INVALID_FD) {
+    close(fifo->event_fd);
+  }
+  free(fifo);
 }
 
 ssize_t ShmFifoPush(struct ShmFifo *fifo, const char *buf, const size_t buf_size)
 {
   size_t            size;    
   struct ShmFifoObj    obj = {0, 0};
+  struct iovec         iov;
+  ssize_t              ret;
 
-  if (shmfifo_unlikely(ShmFifoRingFull(fifo->list))) {
-    SHMFIFO_DEBUG_OUT("ShmFifo full");
-    return -SHMFIFO_ERR_FULL;
+  if (fifo->flags & SHMFIFO_FLAG_VARLEN) {
+    iov.iov_base = (void *)buf;
+    iov.iov_len = buf_size;
+    ret = ShmFifoBytePush(fifo, &iov, 1, SHMFIFO_RING_QUEUE_FIXED);
+    return (ret < 0) ? ret : (ssize_t)SHMFIFO_MIN(fifo->msg_size, buf_size);
   }
-  if (shmfifo_unlikely(!ShmFifoObjAlloc(fifo->obj_pool, &obj))) {
-    SHMFIFO_ERR_OUT("ShmFifoPush failed, ShmFifoObjAlloc error");
-    return -SHMFIFO_ERR_PUSH_OBJ_ALLOC;
+  if (fifo->flags & SHMFIFO_FLAG_INLINE) {
+    iov.iov_base = (void *)buf;
+    iov.iov_len = buf_size;
+    ret = ShmFifoCellPush(fifo, &iov, 1, SHMFIFO_RING_QUEUE_FIXED);
+    return (ret < 0) ? ret : (ssize_t)SHMFIFO_MIN(fifo->msg_size, buf_size);
   }
   size = SHMFIFO_MIN(fifo->msg_size, buf_size);
-  shmfifo_memcpy(SHMFIFO_OBJ_DATA(fifo, obj), buf, size);
+  if (shmfifo_unlikely(!ShmFifoSlotAllocSize(fifo, &obj, size))) {
+    ShmFifoStatFull(fifo);
+    SHMFIFO_DEBUG_OUT("ShmFifo full");
+    return -SHMFIFO_ERR_FULL;
+  }
+  ShmFifoPutData(fifo, SHMFIFO_OBJ_DATA(fifo, obj), buf, size);
   SHMFIFO_OBJ_SIZE(obj) = size;
-  if (shmfifo_unlikely(!ShmFifoRingEnqueueBulk(fifo->list, &obj, 1, NULL))) {
+  if (shmfifo_unlikely(!ShmFifoRingEnqueueCached(fifo->list, &fifo->prod.list_tail,
+      &obj, 1, SHMFIFO_RING_QUEUE_FIXED))) {
     SHMFIFO_ERR_OUT("ShmFifoPush failed, Enqueue error");
-    ShmFifoObjFree(fifo->obj_pool, &obj);
+    ShmFifoSlotUnalloc(fifo, &obj, 1);
     return -SHMFIFO_ERR_PUSH_OBJ_ENQUEUE;
   }
+  ShmFifoNotifyConsumer(fifo, 1, size);
   return (ssize_t)size;
 }
 
+ssize_t ShmFifoPushBulk(struct ShmFifo *fifo, const struct iovec *iov, const unsigned int n)
+{
+  if (shmfifo_unlikely(n > SHMFIFO_BULK_MAX)) {
+    SHMFIFO_ERR_OUT("ShmFifoPushBulk failed, n %u, max %u error", n, SHMFIFO_BULK_MAX);
+    return -SHMFIFO_ERR_PUSH_BULK_SIZE;
+  }
+  return ShmFifoDoPushBulk(fifo, iov, n, SHMFIFO_RING_QUEUE_FIXED);
+}
+
+ssize_t ShmFifoPushBurst(struct ShmFifo *fifo, const struct iovec *iov, const unsigned int n)
+{
+  return ShmFifoDoPushBulk(fifo, iov, SHMFIFO_MIN(n, SHMFIFO_BULK_MAX),
+    SHMFIFO_RING_QUEUE_VARIABLE);
+}
+
 int ShmFifoPop(struct ShmFifo *fifo)
 {
   struct ShmFifoObj obj;
 
-  if (shmfifo_unlikely(!ShmFifoRingDequeueBulk(fifo->list, &obj, 1, NULL))) {
-    SHMFIFO_ERR_OUT("ShmFifoPop failed, fifo empty");
+  if (fifo->flags & SHMFIFO_FLAG_VARLEN) {
+    return ShmFifoBytePop(fifo, 1);
+  }
+  if (fifo->flags & SHMFIFO_FLAG_INLINE) {
+    return ShmFifoCellPop(fifo, 1);
+  }
+  if (fifo->flags & SHMFIFO_FLAG_BROADCAST) {
+    return ShmFifoCursorPop(fifo, 1);
+  }
+  if (shmfifo_unlikely(!ShmFifoRingDequeueCached(fifo->list, &fifo->cons.list_tail,
+      &obj, 1, SHMFIFO_RING_QUEUE_FIXED))) {
+    ShmFifoStatEmpty(fifo);
+    SHMFIFO_DEBUG_OUT("ShmFifoPop failed, fifo empty");
     return -SHMFIFO_ERR_EMPTY;
   }
 
-  if (shmfifo_unlikely(!ShmFifoObjFree(fifo->obj_pool, &obj))) {
-    SHMFIFO_ERR_OUT("ShmFifoPop failed, ShmFifoObjFree error");
+  if (shmfifo_unlikely(!ShmFifoSlotFree(fifo, &obj, 1))) {
+    SHMFIFO_ERR_OUT("ShmFifoPop failed, ShmFifoSlotFree error");
     return -SHMFIFO_ERR_POP_OBJ_FREE;
   }
+  ShmFifoNotifyProducer(fifo, 1);
 
   return SHMFIFO_ERR_NO;
 }
 
 ssize_t ShmFifoPopData(struct ShmFifo *fifo, char* const buf, const size_t buf_size)
 {
+  size_t            size;
   struct ShmFifoObj obj;
-  
-  if (shmfifo_unlikely(!ShmFifoRingDequeueBulk(fifo->list, &obj, 1, NULL))) {
-    SHMFIFO_ERR_OUT("ShmFifoPop failed, fifo empty");
+
+  if (fifo->flags & SHMFIFO_FLAG_VARLEN) {
+    return ShmFifoBytePopData(fifo, buf, buf_size);
+  }
+  if (fifo->flags & SHMFIFO_FLAG_INLINE) {
+    return ShmFifoCellPopData(fifo, buf, buf_size);
+  }
+  if (fifo->flags & SHMFIFO_FLAG_SLOT_MAPPED) {
+    return ShmFifoDirectPopData(fifo, buf, buf_size);
+  }
+  /* a too small buffer leaves the message in the fifo */
+  if (ShmFifoRingPeekCached(fifo->list, &fifo->cons.list_tail, &obj, 1) &&
+      shmfifo_unlikely(buf_size < SHMFIFO_OBJ_SIZE(obj))) {
+    SHMFIFO_ERR_OUT("ShmFifoPop failed, obj size %u, buf size %lu error",
+      SHMFIFO_OBJ_SIZE(obj), buf_size);
+    return -SHMFIFO_ERR_POP_DATA_BUF_SIZE;
+  }
+  ShmFifoListPrefetch(fifo);
+  if (shmfifo_unlikely(!ShmFifoRingDequeueCached(fifo->list, &fifo->cons.list_tail,
+      &obj, 1, SHMFIFO_RING_QUEUE_FIXED))) {
+    ShmFifoStatEmpty(fifo);
+    SHMFIFO_DEBUG_OUT("ShmFifoPop failed, fifo empty");
     return -SHMFIFO_ERR_EMPTY;
   }
+  /*
+   * with several consumers another one may take the peeked message first,
+   * the dequeued one cannot go back so it is dropped with its slot, and the
+   * caller told apart from a buffer that merely left the message in place
+   */
   if (shmfifo_unlikely(buf_size < SHMFIFO_OBJ_SIZE(obj))) {
-    SHMFIFO_ERR_OUT("ShmFifoPop failed, obj size %lu, buf size %lu error",
+    SHMFIFO_ERR_OUT("ShmFifoPop failed, obj size %u, buf size %lu error, message dropped",
       SHMFIFO_OBJ_SIZE(obj), buf_size);
-    return -SHMFIFO_ERR_POP_DATA_BUF_SIZE;
+    if (ShmFifoSlotFree(fifo, &obj, 1)) {
+      ShmFifoNotifyProducer(fifo, 1);
+    }
+    return -SHMFIFO_ERR_POP_DATA_DROP;
   }
-  shmfifo_memcpy(buf, SHMFIFO_OBJ_DATA(fifo, obj), SHMFIFO_OBJ_SIZE(obj));  
+  size = SHMFIFO_OBJ_SIZE(obj);
+  shmfifo_memcpy(buf, SHMFIFO_OBJ_DATA(fifo, obj), size);  
   
-  if (shmfifo_unlikely(!ShmFifoObjFree(fifo->obj_pool, &obj))) {
-    SHMFIFO_ERR_OUT("ShmFifoPop failed, ShmFifoObjFree error");
+  if (shmfifo_unlikely(!ShmFifoSlotFree(fifo, &obj, 1))) {
+    SHMFIFO_ERR_OUT("ShmFifoPop failed, ShmFifoSlotFree error");
     return -SHMFIFO_ERR_POP_DATA_OBJ_FREE;
   }
+  ShmFifoNotifyProducer(fifo, 1);
   
-  return (ssize_t)obj.size;
+  return (ssize_t)size;
 }
 
 void *ShmFifoTop(struct ShmFifo *fifo, size_t *size)
 {
   struct ShmFifoObj obj = {0, 0};
-  
-  if (shmfifo_unlikely(!ShmFifoRingHead(fifo->list, &obj))) {
+  struct iovec      iov;
+
+  if (fifo->flags & SHMFIFO_FLAG_VARLEN) {
+    if (shmfifo_unlikely(!ShmFifoBytePeek(fifo, &iov, 1))) {
+      ShmFifoStatEmpty(fifo);
+      SHMFIFO_DEBUG_OUT("ShmFifoTop failed, fifo empty");
+      return NULL;
+    }
+    ShmFifoBytePrefetch(fifo, __atomic_load_n(&fifo->bytes->cons_tail, __ATOMIC_RELAXED));
+    *size = iov.iov_len;
+    return iov.iov_base;
+  }
+  if (fifo->flags & SHMFIFO_FLAG_INLINE) {
+    if (shmfifo_unlikely(!ShmFifoCellPeek(fifo, &iov, 1))) {
+      ShmFifoStatEmpty(fifo);
+      SHMFIFO_DEBUG_OUT("ShmFifoTop failed, fifo empty");
+      return NULL;
+    }
+    *size = iov.iov_len;
+    return iov.iov_base;
+  }
+  if (shmfifo_unlikely(!ShmFifoListPeek(fifo, &obj, 1))) {
+    ShmFifoStatEmpty(fifo);
     SHMFIFO_DEBUG_OUT("ShmFifoTop failed, fifo empty");
     return NULL;
   }
+  ShmFifoListPrefetch(fifo);
   *size = SHMFIFO_OBJ_SIZE(obj);
   return SHMFIFO_OBJ_DATA(fifo, obj);
 }
 
-static void ShmFifoReset(struct ShmFifo *fifo, size_t total_size, size_t list_size, size_t msg_size,
-  size_t msg_count, int fd)
+ssize_t ShmFifoTopBurst(struct ShmFifo *fifo, struct iovec *iov, const unsigned int n)
+{
+  unsigned int      i;
+  unsigned int      count;
+  struct ShmFifoObj obj_list[SHMFIFO_BULK_MAX];
+
+  if (fifo->flags & SHMFIFO_FLAG_VARLEN) {
+    return (ssize_t)ShmFifoBytePeek(fifo, iov, SHMFIFO_MIN(n, SHMFIFO_BULK_MAX));
+  }
+  if (fifo->flags & SHMFIFO_FLAG_INLINE) {
+    return (ssize_t)ShmFifoCellPeek(fifo, iov, SHMFIFO_MIN(n, SHMFIFO_BULK_MAX));
+  }
+  count = ShmFifoListPeek(fifo, obj_list, SHMFIFO_MIN(n, SHMFIFO_BULK_MAX));
+  for (i = 0; i < count; ++i) {
+    iov[i].iov_base = SHMFIFO_OBJ_DATA(fifo, obj_list[i]);
+    iov[i].iov_len = SHMFIFO_OBJ_SIZE(obj_list[i]);
+  }
+  return (ssize_t)count;
+}
+
+/*
+ * the next messages as one linear byte range, slot mapped modes give slots
+ * of msg_size stride, varlen gives the records with their headers, without
+ * SHMFIFO_FLAG_MIRROR the span stops at the end of the data region
+ */
+ssize_t ShmFifoTopSpan(struct ShmFifo *fifo, struct iovec *span, const unsigned int n)
+{
+  unsigned int      count;
+  uint64_t          slot;
+  struct ShmFifoObj obj_list[SHMFIFO_BULK_MAX];
+
+  if (fifo->flags & SHMFIFO_FLAG_VARLEN) {
+    return (ssize_t)ShmFifoByteSpan(fifo, span, n);
+  }
+  if (shmfifo_unlikely(!(fifo->flags & SHMFIFO_FLAG_SLOT_MAPPED))) {
+    SHMFIFO_ERR_OUT("ShmFifoTopSpan failed, fifo flags %x, pool slots are not linear",
+      fifo->flags);
+    return -SHMFIFO_ERR_SPAN_FLAGS;
+  }
+  count = ShmFifoListPeek(fifo, obj_list, SHMFIFO_MIN(n, SHMFIFO_BULK_MAX));
+  if (!count) {
+    return 0;
+  }
+  slot = SHMFIFO_OBJ_OFFSET(obj_list[0]) / fifo->msg_size;
+  if (!(fifo->flags & SHMFIFO_FLAG_MIRROR)) {
+    count = (unsigned int)SHMFIFO_MIN(count, fifo->mask + 1 - slot);
+  }
+  span->iov_base = SHMFIFO_OBJ_DATA(fifo, obj_list[0]);
+  span->iov_len = (count - 1) * fifo->msg_size + SHMFIFO_OBJ_SIZE(obj_list[count - 1]);
+  return (ssize_t)count;
+}
+
+int ShmFifoPopBulk(struct ShmFifo *fifo, const unsigned int n)
+{
+  struct ShmFifoObj obj_list[SHMFIFO_BULK_MAX];
+
+  if (shmfifo_unlikely(n > SHMFIFO_BULK_MAX)) {
+    SHMFIFO_ERR_OUT("ShmFifoPopBulk failed, n %u, max %u error", n, SHMFIFO_BULK_MAX);
+    return -SHMFIFO_ERR_POP_BULK_SIZE;
+  }
+  if (fifo->flags & SHMFIFO_FLAG_VARLEN) {
+    return ShmFifoBytePop(fifo, n);
+  }
+  if (fifo->flags & SHMFIFO_FLAG_INLINE) {
+    return ShmFifoCellPop(fifo, n);
+  }
+  if (fifo->flags & SHMFIFO_FLAG_BROADCAST) {
+    return ShmFifoCursorPop(fifo, n);
+  }
+  if (shmfifo_unlikely(ShmFifoRingDequeueCached(fifo->list, &fifo->cons.list_tail,
+      obj_list, n, SHMFIFO_RING_QUEUE_FIXED) != n)) {
+    ShmFifoStatEmpty(fifo);
+    SHMFIFO_DEBUG_OUT("ShmFifoPopBulk failed, fifo empty");
+    return -SHMFIFO_ERR_EMPTY;
+  }
+  if (shmfifo_unlikely(ShmFifoSlotFree(fifo, obj_list, n) != n)) {
+    SHMFIFO_ERR_OUT("ShmFifoPopBulk failed, ShmFifoSlotFree error");
+    return -SHMFIFO_ERR_POP_BULK_OBJ_FREE;
+  }
+  ShmFifoNotifyProducer(fifo, n);
+  return SHMFIFO_ERR_NO;
+}
+
+void *ShmFifoReserve(struct ShmFifo *fifo, const size_t size)
+{
+  struct ShmFifoObj obj = {0, 0};
+
+  if (shmfifo_unlikely(size > fifo->msg_size)) {
+    SHMFIFO_ERR_OUT("ShmFifoReserve failed, size %lu, msg size %lu error",
+      size, fifo->msg_size);
+    return NULL;
+  }
+  if (fifo->flags & SHMFIFO_FLAG_VARLEN) {
+    return ShmFifoByteReserve(fifo, size);
+  }
+  if (fifo->flags & SHMFIFO_FLAG_INLINE) {
+    return ShmFifoCellReserve(fifo, size);
+  }
+  if (shmfifo_unlikely(!ShmFifoSlotAllocSize(fifo, &obj, size))) {
+    ShmFifoStatFull(fifo);
+    SHMFIFO_DEBUG_OUT("ShmFifo full");
+    return NULL;
+  }
+  return SHMFIFO_OBJ_DATA(fifo, obj);
+}
+
+ssize_t ShmFifoCommit(struct ShmFifo *fifo, void *buf, const size_t size)
+{
+  struct ShmFifoObj obj = {0, 0};
+
+  if (fifo->flags & SHMFIFO_FLAG_VARLEN) {
+    return ShmFifoByteCommit(fifo, buf, size);
+  }
+  if (fifo->flags & SHMFIFO_FLAG_INLINE) {
+    return ShmFifoCellCommit(fifo, buf, size);
+  }
+  if (shmfifo_unlikely(!ShmFifoDataObj(fifo, buf, &obj))) {
+    SHMFIFO_ERR_OUT("ShmFifoCommit failed, buf %p not reserved", buf);
+    return -SHMFIFO_ERR_COMMIT_ADDR;
+  }
+  if (shmfifo_unlikely(size > ShmFifoSlotSize(fifo, SHMFIFO_OBJ_OFFSET(obj)))) {
+    SHMFIFO_ERR_OUT("ShmFifoCommit failed, size %lu, slot size %lu error",
+      size, ShmFifoSlotSize(fifo, SHMFIFO_OBJ_OFFSET(obj)));
+    return -SHMFIFO_ERR_COMMIT_SIZE;
+  }
+  if (shmfifo_unlikely((fifo->flags & SHMFIFO_FLAG_SLOT_MAPPED) &&
+      SHMFIFO_OBJ_OFFSET(obj) != (__atomic_load_n(&fifo->list->prod.head,
+        __ATOMIC_RELAXED) & fifo->mask) * fifo->msg_size)) {
+    SHMFIFO_ERR_OUT("ShmFifoCommit failed, buf %p is not the reserved slot", buf);
+    return -SHMFIFO_ERR_COMMIT_ADDR;
+  }
+  SHMFIFO_OBJ_SIZE(obj) = size;
+  if (shmfifo_unlikely(!ShmFifoRingEnqueueCached(fifo->list, &fifo->prod.list_tail,
+      &obj, 1, SHMFIFO_RING_QUEUE_FIXED))) {
+    SHMFIFO_ERR_OUT("ShmFifoCommit failed, Enqueue error");
+    ShmFifoSlotUnalloc(fifo, &obj, 1);
+    return -SHMFIFO_ERR_COMMIT_OBJ_ENQUEUE;
+  }
+  ShmFifoNotifyConsumer(fifo, 1, size);
+  return (ssize_t)size;
+}
+
+int ShmFifoAbort(struct ShmFifo *fifo, void *buf)
+{
+  struct ShmFifoObj obj = {0, 0};
+
+  if (fifo->flags & SHMFIFO_FLAG_VARLEN) {
+    return ShmFifoByteAbort(fifo, buf);
+  }
+  if (fifo->flags & SHMFIFO_FLAG_INLINE) {
+    return ShmFifoCellAbort(fifo, buf);
+  }
+  if (shmfifo_unlikely(!ShmFifoDataObj(fifo, buf, &obj))) {
+    SHMFIFO_ERR_OUT("ShmFifoAbort failed, buf %p not reserved", buf);
+    return -SHMFIFO_ERR_ABORT_ADDR;
+  }
+  if (shmfifo_unlikely(!ShmFifoSlotUnalloc(fifo, &obj, 1))) {
+    SHMFIFO_ERR_OUT("ShmFifoAbort failed, slot %p free error", buf);
+    return -SHMFIFO_ERR_ABORT_OBJ_FREE;
+  }
+  return SHMFIFO_ERR_NO;
+}
+
+ssize_t ShmFifoPushWait(struct ShmFifo *fifo, const char *buf, const size_t buf_size,
+  int timeout_us)
+{
+  ssize_t             ret;
+  struct ShmFifoWaiter waiter;
+
+  ret = ShmFifoPush(fifo, buf, buf_size);
+  if (ret != -SHMFIFO_ERR_FULL) {
+    return ret;
+  }
+  if (shmfifo_unlikely(!(fifo->flags & SHMFIFO_FLAG_WAIT))) {
+    SHMFIFO_ERR_OUT("ShmFifoPushWait failed, fifo flags %x without wait", fifo->flags);
+    return -SHMFIFO_ERR_WAIT_FLAGS;
+  }
+  ShmFifoWaitBegin(&waiter, &fifo->header->not_full, fifo->spin_cycles, timeout_us);
+  do {
+    ret = ShmFifoWaitNext(&waiter);
+    if (ret != SHMFIFO_ERR_NO) {
+      break;
+    }
+    ret = ShmFifoPush(fifo, buf, buf_size);
+  } while (ret == -SHMFIFO_ERR_FULL);
+  ShmFifoWaitEnd(&waiter);
+  return ret;
+}
+
+ssize_t ShmFifoPopDataWait(struct ShmFifo *fifo, char* const buf, const size_t buf_size,
+  int timeout_us)
+{
+  ssize_t             ret;
+  struct ShmFifoWaiter waiter;
+
+  ret = ShmFifoPopData(fifo, buf, buf_size);
+  if (ret != -SHMFIFO_ERR_EMPTY) {
+    return ret;
+  }
+  if (shmfifo_unlikely(!(fifo->flags & SHMFIFO_FLAG_WAIT))) {
+    SHMFIFO_ERR_OUT("ShmFifoPopDataWait failed, fifo flags %x without wait", fifo->flags);
+    return -SHMFIFO_ERR_WAIT_FLAGS;
+  }
+  ShmFifoWaitBegin(&waiter, &fifo->header->not_empty, fifo->spin_cycles, timeout_us);
+  do {
+    ret = ShmFifoWaitNext(&waiter);
+    if (ret != SHMFIFO_ERR_NO) {
+      break;
+    }
+    ret = ShmFifoPopData(fifo, buf, buf_size);
+  } while (ret == -SHMFIFO_ERR_EMPTY);
+  ShmFifoWaitEnd(&waiter);
+  return ret;
+}
+
+void *ShmFifoTopWait(struct ShmFifo *fifo, size_t *size, int timeout_us)
+{
+  void               *data;
+  struct ShmFifoWaiter waiter;
+
+  data = ShmFifoTop(fifo, size);
+  if (data) {
+    return data;
+  }
+  if (shmfifo_unlikely(!(fifo->flags & SHMFIFO_FLAG_WAIT))) {
+    SHMFIFO_ERR_OUT("ShmFifoTopWait failed, fifo flags %x without wait", fifo->flags);
+    return NULL;
+  }
+  ShmFifoWaitBegin(&waiter, &fifo->header->not_empty, fifo->spin_cycles, timeout_us);
+  do {
+    if (ShmFifoWaitNext(&waiter) != SHMFIFO_ERR_NO) {
+      break;
+    }
+    data = ShmFifoTop(fifo, size);
+  } while (!data);
+  ShmFifoWaitEnd(&waiter);
+  return data;
+}
+
+int ShmFifoEventFd(struct ShmFifo *fifo)
+{
+  if (shmfifo_unlikely(!(fifo->flags & SHMFIFO_FLAG_EVENT))) {
+    SHMFIFO_ERR_OUT("ShmFifoEventFd failed, fifo flags %x without event", fifo->flags);
+    return -SHMFIFO_ERR_EVENT_FLAGS;
+  }
+  return fifo->event_fd;
+}
+
+int ShmFifoFd(struct ShmFifo *fifo)
+{
+  return fifo->fd;
+}
+
+/* node of the header and ring control lines, the data may be interleaved */
+int ShmFifoNumaNode(struct ShmFifo *fifo)
+{
+  return ShmFifoNumaNodeOf(fifo->header);
+}
+
+int ShmFifoEventArm(struct ShmFifo *fifo)
+{
+  struct ShmFifoEvent *event = &fifo->header->event;
+  struct iovec         iov;
+  unsigned int         count;
+
+  if (shmfifo_unlikely(!(fifo->flags & SHMFIFO_FLAG_EVENT))) {
+    SHMFIFO_ERR_OUT("ShmFifoEventArm failed, fifo flags %x without event", fifo->flags);
+    return -SHMFIFO_ERR_EVENT_FLAGS;
+  }
+  ShmFifoEventDrain(fifo->event_fd);
+  __atomic_store_n(&event->armed, 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (fifo->flags & SHMFIFO_FLAG_VARLEN) {
+    /* walk past fillers, a published filler alone is not a message */
+    count = ShmFifoBytePeek(fifo, &iov, 1);
+  } else {
+    count = fifo->cursor ? ShmFifoCursorCount(fifo->cursor, fifo->list) :
+      ShmFifoRingCount(fifo->list);
+  }
+  if (count) {
+    __atomic_store_n(&event->armed, 0, __ATOMIC_RELAXED);
+    return SHMFIFO_FALSE;
+  }
+  return SHMFIFO_TRUE;
+}
+
+int ShmFifoSubscribe(struct ShmFifo *fifo)
+{
+  int idx;
+
+  if (shmfifo_unlikely(!(fifo->flags & SHMFIFO_FLAG_BROADCAST))) {
+    SHMFIFO_ERR_OUT("ShmFifoSubscribe failed, fifo flags %x without broadcast", fifo->flags);
+    return -SHMFIFO_ERR_BROADCAST_FLAGS;
+  }
+  if (fifo->cursor && ShmFifoCursorLive(fifo->cursor)) {
+    return (int)(fifo->cursor - fifo->cursors->cursor);
+  }
+  if (fifo->cursor) {
+    ShmFifoCursorRelease(fifo->cursor);
+    fifo->cursor = NULL;
+  }
+  idx = ShmFifoCursorClaim(fifo->cursors);
+  if (idx < 0) {
+    SHMFIFO_ERR_OUT("ShmFifoSubscribe failed, all %d cursors taken", SHMFIFO_CURSOR_MAX);
+    return idx;
+  }
+  fifo->cursor = &fifo->cursors->cursor[idx];
+  ShmFifoCursorJoin(fifo->cursor, fifo->list);
+  fifo->cons.list_tail = __atomic_load_n(&fifo->list->prod.tail, __ATOMIC_ACQUIRE);
+  return idx;
+}
+
+int ShmFifoUnsubscribe(struct ShmFifo *fifo)
+{
+  if (shmfifo_unlikely(!fifo->cursor)) {
+    SHMFIFO_ERR_OUT("ShmFifoUnsubscribe failed, not subscribed");
+    return -SHMFIFO_ERR_CURSOR_NONE;
+  }
+  ShmFifoCursorRelease(fifo->cursor);
+  fifo->cursor = NULL;
+  return SHMFIFO_ERR_NO;
+}
+
+/* producers retry on the list and on the pools they allocate from, consumers the reverse */
+int ShmFifoStatsGet(struct ShmFifo *fifo, struct ShmFifoStats *stats)
+{
+  struct ShmFifoStatsBlock *block = &fifo->header->stats;
+  struct ShmFifoRing       *pool;
+  uint32_t                  c;
+
+  if (shmfifo_unlikely(!(fifo->flags & SHMFIFO_FLAG_STATS))) {
+    SHMFIFO_ERR_OUT("ShmFifoStatsGet failed, fifo flags %x without stats", fifo->flags);
+    return -SHMFIFO_ERR_STATS_FLAGS;
+  }
+  stats->pushes = __atomic_load_n(&block->prod.pushes, __ATOMIC_RELAXED);
+  stats->push_bytes = __atomic_load_n(&block->prod.bytes, __ATOMIC_RELAXED);
+  stats->full = __atomic_load_n(&block->prod.full, __ATOMIC_RELAXED);
+  stats->max_depth = __atomic_load_n(&block->prod.max_depth, __ATOMIC_RELAXED);
+  stats->pops = __atomic_load_n(&block->cons.pops, __ATOMIC_RELAXED);
+  stats->empty = __atomic_load_n(&block->cons.empty, __ATOMIC_RELAXED);
+  if (fifo->bytes) {
+    stats->depth = __atomic_load_n(&fifo->bytes->prod_tail, __ATOMIC_ACQUIRE) -
+      __atomic_load_n(&fifo->bytes->cons_tail, __ATOMIC_ACQUIRE);
+    stats->prod_retries = 0;
+    stats->cons_retries = 0;
+    return SHMFIFO_ERR_NO;
+  }
+  stats->depth = ShmFifoRingCount(fifo->list);
+  stats->prod_retries = __atomic_load_n(&fifo->list->prod_retries, __ATOMIC_RELAXED);
+  stats->cons_retries = __atomic_load_n(&fifo->list->cons_retries, __ATOMIC_RELAXED);
+  for (c = 0; c < fifo->class_num || (c == 0 && fifo->obj_pool); ++c) {
+    pool = fifo->class_num ? fifo->classes[c].pool : fifo->obj_pool;
+    stats->prod_retries += __atomic_load_n(&pool->cons_retries, __ATOMIC_RELAXED);
+    stats->cons_retries += __atomic_load_n(&pool->prod_retries, __ATOMIC_RELAXED);
+  }
+  return SHMFIFO_ERR_NO;
+}
+
+static inline ssize_t ShmFifoDoPushBulk(struct ShmFifo *fifo, const struct iovec *iov,
+  unsigned int n, int behavior)
+{
+  size_t            size;
+  size_t            bytes = 0;
+  unsigned int      i;
+  struct ShmFifoObj obj_list[SHMFIFO_BULK_MAX];
+
+  if (fifo->flags & SHMFIFO_FLAG_VARLEN) {
+    return ShmFifoBytePush(fifo, iov, n, behavior);
+  }
+  if (fifo->flags & SHMFIFO_FLAG_INLINE) {
+    return ShmFifoCellPush(fifo, iov, n, behavior);
+  }
+  if (fifo->class_num) {
+    for (i = 0; i < n; ++i) {
+      if (!ShmFifoClassAlloc(fifo, &obj_list[i], SHMFIFO_MIN(fifo->msg_size, iov[i].iov_len))) {
+        break;
+      }
+    }
+    if (i < n && behavior == SHMFIFO_RING_QUEUE_FIXED) {
+      ShmFifoClassUnalloc(fifo, obj_list, i);
+      i = 0;
+    }
+    n = i;
+  } else {
+    n = ShmFifoSlotAlloc(fifo, obj_list, n, behavior);
+  }
+  if (shmfifo_unlikely(!n)) {
+    ShmFifoStatFull(fifo);
+    SHMFIFO_DEBUG_OUT("ShmFifo full");
+    return (behavior == SHMFIFO_RING_QUEUE_FIXED) ? -SHMFIFO_ERR_FULL : 0;
+  }
+  for (i = 0; i < n; ++i) {
+    size = SHMFIFO_MIN(fifo->msg_size, iov[i].iov_len);
+    ShmFifoPutData(fifo, SHMFIFO_OBJ_DATA(fifo, obj_list[i]), iov[i].iov_base, size);
+    SHMFIFO_OBJ_SIZE(obj_list[i]) = size;
+    bytes += size;
+  }
+  if (shmfifo_unlikely(ShmFifoRingEnqueueCached(fifo->list, &fifo->prod.list_tail,
+      obj_list, n, SHMFIFO_RING_QUEUE_FIXED) != n)) {
+    SHMFIFO_ERR_OUT("ShmFifoPushBulk failed, Enqueue error");
+    ShmFifoSlotUnalloc(fifo, obj_list, n);
+    return -SHMFIFO_ERR_PUSH_BULK_OBJ_ENQUEUE;
+  }
+  ShmFifoNotifyConsumer(fifo, n, bytes);
+  return (ssize_t)n;
+}
+
+static inline unsigned int ShmFifoSlotAlloc(struct ShmFifo *fifo,
+  struct ShmFifoObj *obj_list, unsigned int n, int behavior)
+{
+  unsigned int got;
+
+  if (fifo->flags & SHMFIFO_FLAG_SLOT_MAPPED) {
+    got = ShmFifoDirectAlloc(fifo->list, fifo->mask, fifo->msg_size,
+      &fifo->prod.list_tail, obj_list, n, behavior);
+    if (shmfifo_likely(got == n) || !(fifo->flags & SHMFIFO_FLAG_BROADCAST)) {
+      return got;
+    }
+    fifo->prod.list_tail = ShmFifoCursorGate(fifo->cursors, fifo->list,
+      (behavior == SHMFIFO_RING_QUEUE_FIXED) ? n : 1, fifo->flags & SHMFIFO_FLAG_EVICT);
+    return ShmFifoDirectAlloc(fifo->list, fifo->mask, fifo->msg_size,
+      &fifo->prod.list_tail, obj_list, n, behavior);
+  }
+  return ShmFifoObjAllocBulk(fifo->obj_pool, &fifo->prod.pool_tail, obj_list, n, behavior);
+}
+
+static inline unsigned int ShmFifoSlotFree(struct ShmFifo *fifo,
+  struct ShmFifoObj *obj_list, unsigned int n)
+{
+  if (fifo->flags & SHMFIFO_FLAG_SLOT_MAPPED) {
+    return n;
+  }
+  if (fifo->class_num) {
+    return ShmFifoClassFree(fifo, obj_list, n);
+  }
+  return ShmFifoObjFreeBulk(fifo->obj_pool, &fifo->cons.pool_tail, obj_list, n);
+}
+
+/*
+ * producer side give back, a single producer owns the pool's dequeue side,
+ * multi producer fifos have a multi producer pool so any side may free into it
+ */
+/* slots given back, short only when a multi producer pool refuses a double free */
+static inline unsigned int ShmFifoSlotUnalloc(struct ShmFifo *fifo,
+  struct ShmFifoObj *obj_list, unsigned int n)
+{
+  if (fifo->flags & SHMFIFO_FLAG_SLOT_MAPPED) {
+    return n;
+  }
+  if (fifo->class_num) {
+    return ShmFifoClassUnalloc(fifo, obj_list, n);
+  }
+  if (fifo->flags & SHMFIFO_FLAG_MP) {
+    return ShmFifoObjFreeBulk(fifo->obj_pool, NULL, obj_list, n);
+  }
+  ShmFifoObjUnalloc(fifo->obj_pool, obj_list, n);
+  return n;
+}
+
+static inline unsigned int ShmFifoSlotAllocSize(struct ShmFifo *fifo,
+  struct ShmFifoObj *obj, size_t size)
+{
+  if (fifo->class_num) {
+    return ShmFifoClassAlloc(fifo, obj, size);
+  }
+  return ShmFifoSlotAlloc(fifo, obj, 1, SHMFIFO_RING_QUEUE_FIXED);
+}
+
+static inline size_t ShmFifoSlotSize(const struct ShmFifo *fifo, size_t offset)
+{
+  if (fifo->class_num) {
+    return fifo->classes[ShmFifoClassOf(fifo, offset)].msg_size;
+  }
+  return fifo->msg_size;
+}
+
+static inline uint32_t ShmFifoClassOf(const struct ShmFifo *fifo, size_t offset)
+{
+  uint32_t c = 0;
+
+  while (c + 1 < fifo->class_num && offset >= fifo->classes[c].data_end) {
+    ++c;
+  }
+  return c;
+}
+
+/* smallest class the message fits in, larger classes take over when it runs dry */
+static unsigned int ShmFifoClassAlloc(struct ShmFifo *fifo, struct ShmFifoObj *obj,
+  size_t size)
+{
+  uint32_t c;
+
+  for (c = 0; c < fifo->class_num; ++c) {
+    if (fifo->classes[c].msg_size >= size &&
+        ShmFifoObjAllocBulk(fifo->classes[c].pool, &fifo->prod.class_tail[c], obj, 1,
+          SHMFIFO_RING_QUEUE_FIXED)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* runs of slots from the same class go back to their pool in one enqueue */
+static unsigned int ShmFifoClassFree(struct ShmFifo *fifo, struct ShmFifoObj *obj_list,
+  unsigned int n)
+{
+  unsigned int i;
+  unsigned int run;
+  uint32_t     c;
+
+  for (i = 0; i < n; i += run) {
+    c = ShmFifoClassOf(fifo, SHMFIFO_OBJ_OFFSET(obj_list[i]));
+    for (run = 1; i + run < n &&
+        ShmFifoClassOf(fifo, SHMFIFO_OBJ_OFFSET(obj_list[i + run])) == c; ++run);
+    if (ShmFifoObjFreeBulk(fifo->classes[c].pool, &fifo->cons.class_tail[c],
+        &obj_list[i], run) != run) {
+      return i;
+    }
+  }
+  return n;
+}
+
+static unsigned int ShmFifoClassUnalloc(struct ShmFifo *fifo, struct ShmFifoObj *obj_list,
+  unsigned int n)
+{
+  unsigned int i;
+  unsigned int run;
+  unsigned int done = 0;
+  uint32_t     c;
+
+  for (i = 0; i < n; i += run) {
+    c = ShmFifoClassOf(fifo, SHMFIFO_OBJ_OFFSET(obj_list[i]));
+    for (run = 1; i + run < n &&
+        ShmFifoClassOf(fifo, SHMFIFO_OBJ_OFFSET(obj_list[i + run])) == c; ++run);
+    if (fifo->flags & SHMFIFO_FLAG_MP) {
+      done += ShmFifoObjFreeBulk(fifo->classes[c].pool, NULL, &obj_list[i], run);
+    } else {
+      ShmFifoObjUnalloc(fifo->classes[c].pool, &obj_list[i], run);
+      done += run;
+    }
+  }
+  return done;
+}
+
+/*
+ * extra classes from the attr, ascending and below msg_size, the msg_size
+ * class itself goes last, no extra classes leaves class_num at 0
+ */
+static int ShmFifoClassInit(const struct ShmFifoAttr *attr, size_t msg_size, size_t msg_count,
+  struct ShmFifoClass *classes, uint32_t *class_num)
+{
+  uint32_t i;
+  uint32_t n = 0;
+  size_t   size;
+
+  for (i = 0; i < SHMFIFO_CLASS_MAX - 1 && attr->class_size[i]; ++i) {
+    /* checked before aligning, a size near SIZE_MAX would wrap to a small one */
+    size = (attr->class_size[i] > UINT32_MAX) ? SIZE_MAX :
+      SHMFIFO_SIZE_ALIGN(attr->class_size[i], SHMFIFO_CACHE_LINE);
+    if (!attr->class_count[i] || size > UINT32_MAX || size >= msg_size ||
+        (n && size <= classes[n - 1].msg_size)) {
+      SHMFIFO_ERR_OUT("ShmFifoOpen failed, class %u size %lu count %lu error, classes "
+        "must ascend below msg size %lu", i, attr->class_size[i], attr->class_count[i],
+        msg_size);
+      return -SHMFIFO_ERR_OPEN_ATTR;
+    }
+    memset(&classes[n], 0, sizeof(struct ShmFifoClass));
+    classes[n].msg_size = size;
+    classes[n].msg_count = Power2Align32((uint32_t)attr->class_count[i]);
+    ++n;
+  }
+  *class_num = 0;
+  if (!n) {
+    return SHMFIFO_ERR_NO;
+  }
+  if (attr->flags & SHMFIFO_FLAG_NO_POOL) {
+    SHMFIFO_ERR_OUT("ShmFifoOpen failed, size classes need the obj pool, flags %x",
+      attr->flags);
+    return -SHMFIFO_ERR_OPEN_ATTR;
+  }
+  memset(&classes[n], 0, sizeof(struct ShmFifoClass));
+  classes[n].msg_size = msg_size;
+  classes[n].msg_count = msg_count;
+  *class_num = n + 1;
+  return SHMFIFO_ERR_NO;
+}
+
+static int ShmFifoClassMatch(const struct ShmFifoHeader *header,
+  const struct ShmFifoClass *classes, uint32_t class_num)
+{
+  uint32_t c;
+
+  if (header->class_num == class_num) {
+    for (c = 0; c < class_num; ++c) {
+      if (header->classes[c].msg_size != classes[c].msg_size ||
+          header->classes[c].msg_count != classes[c].msg_count) {
+        break;
+      }
+    }
+    if (c == class_num) {
+      return SHMFIFO_TRUE;
+    }
+  }
+  /* the sizes above can agree while the classes differ, show both tables */
+  SHMFIFO_ERR_OUT("ShmFifoOpen class error, %u classes != %lu", class_num, header->class_num);
+  for (c = 0; c < class_num || c < header->class_num; ++c) {
+    SHMFIFO_ERR_OUT("ShmFifoOpen class %u, %lu * %lu != %lu * %lu", c,
+      c < class_num ? classes[c].msg_size : 0, c < class_num ? classes[c].msg_count : 0,
+      c < header->class_num ? header->classes[c].msg_size : 0,
+      c < header->class_num ? header->classes[c].msg_count : 0);
+  }
+  return SHMFIFO_FALSE;
+}
+
+static inline size_t ShmFifoRingMemSize(uint32_t count)
+{
+  return SHMFIFO_SIZE_ALIGN(sizeof(struct ShmFifoObj) * count + sizeof(struct ShmFifoRing),
+    SHMFIFO_CACHE_LINE);
+}
+
+static ssize_t ShmFifoDirectPopData(struct ShmFifo *fifo, char* const buf,
+  const size_t buf_size)
+{
+  int               ret;
+  size_t            size;
+  struct ShmFifoObj obj;
+
+  if (shmfifo_unlikely(!ShmFifoListPeek(fifo, &obj, 1))) {
+    ShmFifoStatEmpty(fifo);
+    SHMFIFO_DEBUG_OUT("ShmFifoPop failed, fifo empty");
+    return -SHMFIFO_ERR_EMPTY;
+  }
+  size = SHMFIFO_OBJ_SIZE(obj);
+  if (shmfifo_unlikely(buf_size < size)) {
+    SHMFIFO_ERR_OUT("ShmFifoPop failed, obj size %lu, buf size %lu error",
+      size, buf_size);
+    return -SHMFIFO_ERR_POP_DATA_BUF_SIZE;
+  }
+  ShmFifoListPrefetch(fifo);
+  shmfifo_memcpy(buf, SHMFIFO_OBJ_DATA(fifo, obj), size);
+  if (fifo->flags & SHMFIFO_FLAG_BROADCAST) {
+    ret = ShmFifoCursorPop(fifo, 1);
+    return (ret == SHMFIFO_ERR_NO) ? (ssize_t)size : ret;
+  }
+  ShmFifoRingDequeueCached(fifo->list, &fifo->cons.list_tail, &obj, 1,
+    SHMFIFO_RING_QUEUE_FIXED);
+  ShmFifoNotifyProducer(fifo, 1);
+
+  return (ssize_t)size;
+}
+
+static inline unsigned int ShmFifoListPeek(struct ShmFifo *fifo,
+  struct ShmFifoObj *obj_list, unsigned int n)
+{
+  if (!(fifo->flags & SHMFIFO_FLAG_BROADCAST)) {
+    return ShmFifoRingPeekCached(fifo->list, &fifo->cons.list_tail, obj_list, n);
+  }
+  if (shmfifo_unlikely(!fifo->cursor)) {
+    return 0;
+  }
+  return ShmFifoCursorPeek(fifo->cursor, fifo->list, &fifo->cons.list_tail, obj_list, n);
+}
+
+/*
+ * broadcast consume, the state check after the acquire fence tells whether
+ * the producer evicted this cursor, and may have reused the slots, while
+ * the caller was reading them
+ */
+static int ShmFifoCursorPop(struct ShmFifo *fifo, unsigned int n)
+{
+  struct ShmFifoCursor *cursor = fifo->cursor;
+  uint32_t              pos;
+
+  if (shmfifo_unlikely(!cursor)) {
+    SHMFIFO_ERR_OUT("ShmFifoPop failed, not subscribed");
+    return -SHMFIFO_ERR_CURSOR_NONE;
+  }
+  pos = __atomic_load_n(&cursor->pos, __ATOMIC_RELAXED);
+  if (fifo->cons.list_tail - pos < n) {
+    fifo->cons.list_tail = __atomic_load_n(&fifo->list->prod.tail, __ATOMIC_ACQUIRE);
+    if (fifo->cons.list_tail - pos < n) {
+      ShmFifoStatEmpty(fifo);
+      SHMFIFO_DEBUG_OUT("ShmFifoPop failed, fifo empty");
+      return -SHMFIFO_ERR_EMPTY;
+    }
+  }
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if (shmfifo_unlikely(!ShmFifoCursorLive(cursor))) {
+    SHMFIFO_DEBUG_OUT("ShmFifoPop failed, cursor evicted");
+    return -SHMFIFO_ERR_EVICTED;
+  }
+  ShmFifoCursorAdvance(cursor, n);
+  ShmFifoNotifyProducer(fifo, n);
+  return SHMFIFO_ERR_NO;
+}
+
+/*
+ * varlen produce, records are laid out at a local position and go out with
+ * one release store, a FIXED batch that does not fit publishes nothing
+ */
+static ssize_t ShmFifoBytePush(struct ShmFifo *fifo, const struct iovec *iov,
+  unsigned int n, int behavior)
+{
+  struct ShmFifoByteRing *ring = fifo->bytes;
+  struct ShmFifoByteHdr  *hdr;
+  uint64_t                pos;
+  size_t                  size;
+  size_t                  bytes = 0;
+  unsigned int            i;
+
+  pos = __atomic_load_n(&ring->prod_tail, __ATOMIC_RELAXED);
+  for (i = 0; i < n; ++i) {
+    size = SHMFIFO_MIN(fifo->msg_size, iov[i].iov_len);
+    hdr = ShmFifoByteRingReserve(ring, fifo->start_addr, &pos, &fifo->prod.byte_tail, size);
+    if (!hdr) {
+      break;
+    }
+    ShmFifoPutData(fifo, hdr + 1, iov[i].iov_base, size);
+    hdr->len = (uint32_t)size;
+    hdr->flags = 0;
+    pos += ShmFifoByteRecordSize(ring, size);
+    bytes += size;
+  }
+  if (shmfifo_unlikely(!i || (i < n && behavior == SHMFIFO_RING_QUEUE_FIXED))) {
+    ShmFifoStatFull(fifo);
+    SHMFIFO_DEBUG_OUT("ShmFifo full");
+    return (behavior == SHMFIFO_RING_QUEUE_FIXED) ? -SHMFIFO_ERR_FULL : 0;
+  }
+  ShmFifoByteRingPublish(ring, pos);
+  ShmFifoNotifyConsumer(fifo, i, bytes);
+  return (ssize_t)i;
+}
+
+static unsigned int ShmFifoBytePeek(struct ShmFifo *fifo, struct iovec *iov,
+  unsigned int n)
+{
+  struct ShmFifoByteRing *ring = fifo->bytes;
+  struct ShmFifoByteHdr  *hdr;
+  uint64_t                pos;
+  unsigned int            i;
+
+  pos = __atomic_load_n(&ring->cons_tail, __ATOMIC_RELAXED);
+  for (i = 0; i < n; ++i) {
+    hdr = ShmFifoByteRingAt(ring, fifo->start_addr, &pos, &fifo->cons.byte_tail);
+    if (!hdr) {
+      break;
+    }
+    iov[i].iov_base = hdr + 1;
+    iov[i].iov_len = hdr->len;
+    pos += ShmFifoByteRecordSize(ring, hdr->len);
+  }
+  return i;
+}
+
+static unsigned int ShmFifoByteSpan(struct ShmFifo *fifo, struct iovec *span,
+  unsigned int n)
+{
+  struct ShmFifoByteRing *ring = fifo->bytes;
+  struct ShmFifoByteHdr  *hdr;
+  uint64_t                start;
+  uint64_t                end;
+  uint64_t                pos;
+  unsigned int            i;
+
+  /*
+   * positions, not addresses, tell whether records follow each other: the
+   * ring hands out records by offset in the first mapping even when mirrored
+   */
+  start = end = pos = __atomic_load_n(&ring->cons_tail, __ATOMIC_RELAXED);
+  for (i = 0; i < n; ++i) {
+    hdr = ShmFifoByteRingAt(ring, fifo->start_addr, &pos, &fifo->cons.byte_tail);
+    if (!hdr || (i && (pos != end || (!ring->mirror && !(pos & ring->mask))))) {
+      break;
+    }
+    if (!i) {
+      span->iov_base = hdr;
+      start = pos;
+    }
+    pos += ShmFifoByteRecordSize(ring, hdr->len);
+    end = pos;
+  }
+  span->iov_len = i ? (size_t)(end - start) : 0;
+  return i;
+}
+
+static int ShmFifoBytePop(struct ShmFifo *fifo, unsigned int n)
+{
+  struct ShmFifoByteRing *ring = fifo->bytes;
+  struct ShmFifoByteHdr  *hdr;
+  uint64_t                pos;
+  unsigned int            i;
+
+  pos = __atomic_load_n(&ring->cons_tail, __ATOMIC_RELAXED);
+  for (i = 0; i < n; ++i) {
+    hdr = ShmFifoByteRingAt(ring, fifo->start_addr, &pos, &fifo->cons.byte_tail);
+    if (!hdr) {
+      ShmFifoStatEmpty(fifo);
+      SHMFIFO_DEBUG_OUT("ShmFifoPop failed, fifo empty");
+      return -SHMFIFO_ERR_EMPTY;
+    }
+    pos += ShmFifoByteRecordSize(ring, hdr->len);
+  }
+  ShmFifoByteRingRelease(ring, pos);
+  ShmFifoNotifyProducer(fifo, n);
+  return SHMFIFO_ERR_NO;
+}
+
+static ssize_t ShmFifoBytePopData(struct ShmFifo *fifo, char* const buf,
+  const size_t buf_size)
 {
-  fifo->magic = SHMFIFO_MAGIC;
-  fifo->version = SHMFIFO_VERSION;
-  fifo->total_size = total_size;
-  fifo->list_size = list_size;
-  fifo->msg_size = msg_size;
-  fifo->msg_count = msg_count;
-  fifo->create_time = time(NULL);
-  fifo->creator = getpid();
+  struct ShmFifoByteRing *ring = fifo->bytes;
+  struct ShmFifoByteHdr  *hdr;
+  uint64_t                pos;
+  size_t                  size;
+
+  pos = __atomic_load_n(&ring->cons_tail, __ATOMIC_RELAXED);
+  hdr = ShmFifoByteRingAt(ring, fifo->start_addr, &pos, &fifo->cons.byte_tail);
+  if (shmfifo_unlikely(!hdr)) {
+    ShmFifoStatEmpty(fifo);
+    SHMFIFO_DEBUG_OUT("ShmFifoPop failed, fifo empty");
+    return -SHMFIFO_ERR_EMPTY;
+  }
+  size = hdr->len;
+  if (shmfifo_unlikely(buf_size < size)) {
+    SHMFIFO_ERR_OUT("ShmFifoPop failed, obj size %lu, buf size %lu error",
+      size, buf_size);
+    return -SHMFIFO_ERR_POP_DATA_BUF_SIZE;
+  }
+  ShmFifoBytePrefetch(fifo, pos);
+  shmfifo_memcpy(buf, hdr + 1, size);
+  ShmFifoByteRingRelease(ring, pos + ShmFifoByteRecordSize(ring, size));
+  ShmFifoNotifyProducer(fifo, 1);
+  return (ssize_t)size;
+}
+
+/*
+ * a filler in front of the reservation is published right away so that
+ * the record always starts at prod_tail when it is committed
+ */
+static void *ShmFifoByteReserve(struct ShmFifo *fifo, const size_t size)
+{
+  struct ShmFifoByteRing *ring = fifo->bytes;
+  struct ShmFifoByteHdr  *hdr;
+  uint64_t                tail;
+  uint64_t                pos;
+
+  tail = __atomic_load_n(&ring->prod_tail, __ATOMIC_RELAXED);
+  pos = tail;
+  hdr = ShmFifoByteRingReserve(ring, fifo->start_addr, &pos, &fifo->prod.byte_tail, size);
+  if (shmfifo_unlikely(!hdr)) {
+    ShmFifoStatFull(fifo);
+    SHMFIFO_DEBUG_OUT("ShmFifo full");
+    return NULL;
+  }
+  if (pos != tail) {
+    ShmFifoByteRingPublish(ring, pos);
+  }
+  fifo->reserve_size = size;
+  return hdr + 1;
+}
+
+static ssize_t ShmFifoByteCommit(struct ShmFifo *fifo, void *buf, const size_t size)
+{
+  struct ShmFifoByteRing *ring = fifo->bytes;
+  struct ShmFifoByteHdr  *hdr;
+  uint64_t                pos;
+
+  pos = __atomic_load_n(&ring->prod_tail, __ATOMIC_RELAXED);
+  hdr = (struct ShmFifoByteHdr *)(fifo->start_addr + (pos & ring->mask));
+  if (shmfifo_unlikely(buf != (void *)(hdr + 1) || !fifo->reserve_size)) {
+    SHMFIFO_ERR_OUT("ShmFifoCommit failed, buf %p is not the reserved record", buf);
+    return -SHMFIFO_ERR_COMMIT_ADDR;
+  }
+  if (shmfifo_unlikely(size > fifo->reserve_size)) {
+    SHMFIFO_ERR_OUT("ShmFifoCommit failed, size %lu, reserved size %lu error",
+      size, fifo->reserve_size);
+    return -SHMFIFO_ERR_COMMIT_SIZE;
+  }
+  hdr->len = (uint32_t)size;
+  hdr->flags = 0;
+  ShmFifoByteRingPublish(ring, pos + ShmFifoByteRecordSize(ring, size));
+  fifo->reserve_size = 0;
+  ShmFifoNotifyConsumer(fifo, 1, size);
+  return (ssize_t)size;
+}
+
+/* nothing was published for the record, dropping the reservation is enough */
+static int ShmFifoByteAbort(struct ShmFifo *fifo, void *buf)
+{
+  uint64_t pos = __atomic_load_n(&fifo->bytes->prod_tail, __ATOMIC_RELAXED);
+
+  if (shmfifo_unlikely(buf != (void *)(fifo->start_addr +
+      (pos & fifo->bytes->mask) + SHMFIFO_BYTE_HDR_SIZE) || !fifo->reserve_size)) {
+    SHMFIFO_ERR_OUT("ShmFifoAbort failed, buf %p not reserved", buf);
+    return -SHMFIFO_ERR_ABORT_ADDR;
+  }
+  fifo->reserve_size = 0;
+  return SHMFIFO_ERR_NO;
+}
+
+/*
+ * inline produce, messages are laid out in local cells and go into the
+ * ring with aligned 64 byte moves, no obj_pool or data region is touched
+ */
+static ssize_t ShmFifoCellPush(struct ShmFifo *fifo, const struct iovec *iov,
+  unsigned int n, int behavior)
+{
+  size_t bytes;
+
+  n = ShmFifoCellRingEnqueueIov(fifo->list, &fifo->prod.list_tail, iov, n, fifo->msg_size,
+    behavior, &bytes);
+  if (shmfifo_unlikely(!n)) {
+    ShmFifoStatFull(fifo);
+    SHMFIFO_DEBUG_OUT("ShmFifo full");
+    return (behavior == SHMFIFO_RING_QUEUE_FIXED) ? -SHMFIFO_ERR_FULL : 0;
+  }
+  ShmFifoNotifyConsumer(fifo, n, bytes);
+  return (ssize_t)n;
+}
+
+/* the cells stay in the ring until popped, like a slot they are read in place */
+static unsigned int ShmFifoCellPeek(struct ShmFifo *fifo, struct iovec *iov,
+  unsigned int n)
+{
+  struct ShmFifoCell *cell;
+  uint32_t            head;
+  unsigned int        i;
+
+  n = ShmFifoCellRingPeek(fifo->list, &fifo->cons.list_tail, &head, n);
+  for (i = 0; i < n; ++i) {
+    cell = ShmFifoCellRingAt(fifo->list, head + i);
+    iov[i].iov_base = cell->data;
+    iov[i].iov_len = cell->len;
+  }
+  return n;
+}
+
+static int ShmFifoCellPop(struct ShmFifo *fifo, unsigned int n)
+{
+  if (shmfifo_unlikely(ShmFifoCellRingDequeue(fifo->list, &fifo->cons.list_tail, NULL, n,
+      SHMFIFO_RING_QUEUE_FIXED) != n)) {
+    ShmFifoStatEmpty(fifo);
+    SHMFIFO_DEBUG_OUT("ShmFifoPop failed, fifo empty");
+    return -SHMFIFO_ERR_EMPTY;
+  }
+  ShmFifoNotifyProducer(fifo, n);
+  return SHMFIFO_ERR_NO;
+}
+
+/*
+ * a single consumer checks the length in place and leaves a message its
+ * buffer cannot take, with several consumers the cell is copied out before
+ * the slot is released so the buffer has to take any message up to msg_size
+ */
+static ssize_t ShmFifoCellPopData(struct ShmFifo *fifo, char* const buf,
+  const size_t buf_size)
+{
+  struct ShmFifoCell *peek;
+  struct ShmFifoCell  cell;
+  uint32_t            head;
+  uint32_t            len;
+
+  if (fifo->list->cons.sync_type == SHMFIFO_RING_SYNC_ST) {
+    if (shmfifo_unlikely(!ShmFifoCellRingPeek(fifo->list, &fifo->cons.list_tail, &head, 1))) {
+      ShmFifoStatEmpty(fifo);
+      SHMFIFO_DEBUG_OUT("ShmFifoPop failed, fifo empty");
+      return -SHMFIFO_ERR_EMPTY;
+    }
+    peek = ShmFifoCellRingAt(fifo->list, head);
+    len = peek->len;
+    if (shmfifo_unlikely(buf_size < len)) {
+      SHMFIFO_ERR_OUT("ShmFifoPop failed, obj size %u, buf size %lu error", len, buf_size);
+      return -SHMFIFO_ERR_POP_DATA_BUF_SIZE;
+    }
+    memcpy(buf, peek->data, len);
+    ShmFifoCellRingDequeue(fifo->list, &fifo->cons.list_tail, NULL, 1,
+      SHMFIFO_RING_QUEUE_FIXED);
+    ShmFifoNotifyProducer(fifo, 1);
+    return (ssize_t)len;
+  }
+  if (shmfifo_unlikely(buf_size < fifo->msg_size)) {
+    SHMFIFO_ERR_OUT("ShmFifoPop failed, msg size %lu, buf size %lu error",
+      fifo->msg_size, buf_size);
+    return -SHMFIFO_ERR_POP_DATA_BUF_SIZE;
+  }
+  if (shmfifo_unlikely(!ShmFifoCellRingDequeue(fifo->list, &fifo->cons.list_tail, &cell, 1,
+      SHMFIFO_RING_QUEUE_FIXED))) {
+    ShmFifoStatEmpty(fifo);
+    SHMFIFO_DEBUG_OUT("ShmFifoPop failed, fifo empty");
+    return -SHMFIFO_ERR_EMPTY;
+  }
+  ShmFifoNotifyProducer(fifo, 1);
+  memcpy(buf, cell.data, cell.len);
+  return (ssize_t)cell.len;
+}
+
+/*
+ * the message is built in the handle and goes in as one cell on commit,
+ * only a single producer is sure the room seen here is still there then
+ */
+static void *ShmFifoCellReserve(struct ShmFifo *fifo, const size_t size)
+{
+  struct ShmFifoRing *ring = fifo->list;
+  uint32_t            head = __atomic_load_n(&ring->prod.head, __ATOMIC_RELAXED);
+
+  if (ring->capacity + fifo->prod.list_tail - head == 0) {
+    fifo->prod.list_tail = __atomic_load_n(&ring->cons.tail, __ATOMIC_ACQUIRE);
+    if (ring->capacity + fifo->prod.list_tail - head == 0) {
+      ShmFifoStatFull(fifo);
+      SHMFIFO_DEBUG_OUT("ShmFifo full");
+      return NULL;
+    }
+  }
+  fifo->reserve_size = size;
+  return fifo->stage.data;
+}
+
+static ssize_t ShmFifoCellCommit(struct ShmFifo *fifo, void *buf, const size_t size)
+{
+  if (shmfifo_unlikely(buf != (void *)fifo->stage.data || !fifo->reserve_size)) {
+    SHMFIFO_ERR_OUT("ShmFifoCommit failed, buf %p not reserved", buf);
+    return -SHMFIFO_ERR_COMMIT_ADDR;
+  }
+  if (shmfifo_unlikely(size > fifo->reserve_size)) {
+    SHMFIFO_ERR_OUT("ShmFifoCommit failed, size %lu, reserved size %lu error",
+      size, fifo->reserve_size);
+    return -SHMFIFO_ERR_COMMIT_SIZE;
+  }
+  fifo->stage.len = (uint32_t)size;
+  if (shmfifo_unlikely(!ShmFifoCellRingEnqueue(fifo->list, &fifo->prod.list_tail,
+      &fifo->stage, 1, SHMFIFO_RING_QUEUE_FIXED))) {
+    ShmFifoStatFull(fifo);
+    SHMFIFO_DEBUG_OUT("ShmFifo full");
+    return -SHMFIFO_ERR_FULL;
+  }
+  fifo->reserve_size = 0;
+  ShmFifoNotifyConsumer(fifo, 1, size);
+  return (ssize_t)size;
+}
+
+static int ShmFifoCellAbort(struct ShmFifo *fifo, void *buf)
+{
+  if (shmfifo_unlikely(buf != (void *)fifo->stage.data || !fifo->reserve_size)) {
+    SHMFIFO_ERR_OUT("ShmFifoAbort failed, buf %p not reserved", buf);
+    return -SHMFIFO_ERR_ABORT_ADDR;
+  }
+  fifo->reserve_size = 0;
+  return SHMFIFO_ERR_NO;
+}
+
+/* producer copy, large messages are streamed past the producer's caches */
+static inline void ShmFifoPutData(const struct ShmFifo *fifo, void *dst,
+  const void *src, size_t size)
+{
+  if (fifo->nt_threshold && size >= fifo->nt_threshold) {
+    ShmFifoCopyStream(dst, src, size);
+    return;
+  }
+  shmfifo_memcpy(dst, src, size);
+}
+
+/*
+ * consumer, warms the slot prefetch messages ahead of the head, only
+ * messages already seen as published through the cached tail are touched
+ * so the producer's lines are left alone
+ */
+static inline void ShmFifoListPrefetch(const struct ShmFifo *fifo)
+{
+  const struct ShmFifoObj *obj;
+  uint32_t                 pos;
+
+  if (shmfifo_likely(!fifo->prefetch)) {
+    return;
+  }
+  if (fifo->cursor) {
+    pos = __atomic_load_n(&fifo->cursor->pos, __ATOMIC_RELAXED);
+  } else if (!(fifo->flags & SHMFIFO_FLAG_BROADCAST)) {
+    pos = __atomic_load_n(&fifo->list->cons.head, __ATOMIC_RELAXED);
+  } else {
+    return;
+  }
+  if (fifo->cons.list_tail - pos <= fifo->prefetch) {
+    return;
+  }
+  obj = (const struct ShmFifoObj *)&fifo->list[1] + ((pos + fifo->prefetch) & fifo->mask);
+  ShmFifoPrefetchRange(SHMFIFO_OBJ_DATA(fifo, *obj), SHMFIFO_OBJ_SIZE(*obj));
+}
+
+/* varlen, one max sized record worth of lines prefetch records ahead of pos */
+static inline void ShmFifoBytePrefetch(const struct ShmFifo *fifo, uint64_t pos)
+{
+  uint64_t record;
+  uint64_t end;
+
+  if (shmfifo_likely(!fifo->prefetch)) {
+    return;
+  }
+  record = ShmFifoByteRecordSize(fifo->bytes, fifo->msg_size);
+  pos += fifo->prefetch * record;
+  end = SHMFIFO_MIN(pos + record, fifo->cons.byte_tail);
+  for (pos &= ~(uint64_t)(SHMFIFO_CACHE_LINE - 1); pos < end; pos += SHMFIFO_CACHE_LINE) {
+    __builtin_prefetch(fifo->start_addr + (pos & fifo->bytes->mask), 0, 3);
+  }
+}
+
+/*
+ * after publishing n messages, one fence covers both the futex waiters and
+ * the doorbell
+ */
+static inline void ShmFifoNotifyConsumer(struct ShmFifo *fifo, unsigned int n,
+  size_t bytes)
+{
+  struct ShmFifoHeader *header = fifo->header;
+
+  if (shmfifo_likely(!(fifo->flags &
+      (SHMFIFO_FLAG_WAIT | SHMFIFO_FLAG_EVENT | SHMFIFO_FLAG_STATS)))) {
+    return;
+  }
+  if (fifo->flags & SHMFIFO_FLAG_STATS) {
+    ShmFifoStatPush(fifo, n, bytes);
+  }
+  if (!(fifo->flags & (SHMFIFO_FLAG_WAIT | SHMFIFO_FLAG_EVENT))) {
+    return;
+  }
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if ((fifo->flags & SHMFIFO_FLAG_WAIT) &&
+      __atomic_load_n(&header->not_empty.waiters, __ATOMIC_RELAXED)) {
+    ShmFifoWaitWakeAll(&header->not_empty);
+  }
+  if ((fifo->flags & SHMFIFO_FLAG_EVENT) &&
+      __atomic_load_n(&header->event.armed, __ATOMIC_RELAXED) &&
+      __atomic_exchange_n(&header->event.armed, 0, __ATOMIC_RELAXED)) {
+    ShmFifoEventKick(fifo->event_fd);
+  }
+}
+
+/* after consuming n messages */
+static inline void ShmFifoNotifyProducer(struct ShmFifo *fifo, unsigned int n)
+{
+  if (fifo->flags & SHMFIFO_FLAG_STATS) {
+    ShmFifoStatAdd(&fifo->header->stats.cons.pops, n,
+      fifo->flags & (SHMFIFO_FLAG_MC | SHMFIFO_FLAG_BROADCAST));
+  }
+  if (fifo->flags & SHMFIFO_FLAG_WAIT) {
+    ShmFifoWaitWake(&fifo->header->not_full);
+  }
+}
+
+/*
+ * depth in messages, or bytes for varlen, against the cached consumer tail,
+ * which only lags so the estimate is never too low, the real tail is only
+ * loaded when the estimate beats the max, and cached back unless producers
+ * share the handle
+ */
+static void ShmFifoStatPush(struct ShmFifo *fifo, unsigned int n, size_t bytes)
+{
+  struct ShmFifoProdStats *stats = &fifo->header->stats.prod;
+  int                      shared = fifo->flags & SHMFIFO_FLAG_MP;
+  uint64_t                 depth;
+  uint64_t                 pos;
+  uint32_t                 head;
+
+  ShmFifoStatAdd(&stats->pushes, n, shared);
+  ShmFifoStatAdd(&stats->bytes, bytes, shared);
+  if (fifo->bytes) {
+    pos = __atomic_load_n(&fifo->bytes->prod_tail, __ATOMIC_RELAXED);
+    if (pos - fifo->prod.byte_tail > __atomic_load_n(&stats->max_depth, __ATOMIC_RELAXED)) {
+      fifo->prod.byte_tail = __atomic_load_n(&fifo->bytes->cons_tail, __ATOMIC_ACQUIRE);
+      ShmFifoStatMax(&stats->max_depth, pos - fifo->prod.byte_tail);
+    }
+    return;
+  }
+  head = __atomic_load_n(&fifo->list->prod.tail, __ATOMIC_RELAXED);
+  depth = (uint32_t)(head - fifo->prod.list_tail);
+  if (depth > __atomic_load_n(&stats->max_depth, __ATOMIC_RELAXED)) {
+    depth = (uint32_t)(head - __atomic_load_n(&fifo->list->cons.tail, __ATOMIC_ACQUIRE));
+    if (!shared) {
+      fifo->prod.list_tail = head - (uint32_t)depth;
+    }
+    ShmFifoStatMax(&stats->max_depth, depth);
+  }
+}
+
+static inline void ShmFifoStatFull(struct ShmFifo *fifo)
+{
+  if (fifo->flags & SHMFIFO_FLAG_STATS) {
+    ShmFifoStatAdd(&fifo->header->stats.prod.full, 1, fifo->flags & SHMFIFO_FLAG_MP);
+  }
+}
+
+static inline void ShmFifoStatEmpty(struct ShmFifo *fifo)
+{
+  if (fifo->flags & SHMFIFO_FLAG_STATS) {
+    ShmFifoStatAdd(&fifo->header->stats.cons.empty, 1,
+      fifo->flags & (SHMFIFO_FLAG_MC | SHMFIFO_FLAG_BROADCAST));
+  }
+}
+
+static int ShmFifoCheckFlags(uint32_t flags)
+{
+  if ((flags & SHMFIFO_FLAG_DIRECT) && (flags & SHMFIFO_SYNC_MPMC)) {
+    SHMFIFO_ERR_OUT("ShmFifoOpen failed, direct mode requires SPSC, flags %x", flags);
+    return -SHMFIFO_ERR_OPEN_FLAGS;
+  }
+  if ((flags & SHMFIFO_FLAG_BROADCAST) &&
+      (flags & (SHMFIFO_FLAG_DIRECT | SHMFIFO_SYNC_MPMC | SHMFIFO_FLAG_RTS))) {
+    SHMFIFO_ERR_OUT("ShmFifoOpen failed, broadcast mode has one producer and "
+      "subscribed consumers only, flags %x", flags);
+    return -SHMFIFO_ERR_OPEN_FLAGS;
+  }
+  if ((flags & SHMFIFO_FLAG_EVICT) && !(flags & SHMFIFO_FLAG_BROADCAST)) {
+    SHMFIFO_ERR_OUT("ShmFifoOpen failed, evict requires broadcast, flags %x", flags);
+    return -SHMFIFO_ERR_OPEN_FLAGS;
+  }
+  if ((flags & SHMFIFO_FLAG_VARLEN) && (flags & (SHMFIFO_FLAG_DIRECT |
+      SHMFIFO_SYNC_MPMC | SHMFIFO_FLAG_RTS | SHMFIFO_FLAG_BROADCAST))) {
+    SHMFIFO_ERR_OUT("ShmFifoOpen failed, varlen mode requires SPSC, flags %x", flags);
+    return -SHMFIFO_ERR_OPEN_FLAGS;
+  }
+  if ((flags & SHMFIFO_FLAG_INLINE) &&
+      (flags & (SHMFIFO_FLAG_DIRECT | SHMFIFO_FLAG_BROADCAST | SHMFIFO_FLAG_VARLEN))) {
+    SHMFIFO_ERR_OUT("ShmFifoOpen failed, inline mode uses neither slots nor a byte ring, "
+      "flags %x", flags);
+    return -SHMFIFO_ERR_OPEN_FLAGS;
+  }
+  if ((flags & SHMFIFO_FLAG_ALIGN64) && !(flags & SHMFIFO_FLAG_VARLEN)) {
+    SHMFIFO_ERR_OUT("ShmFifoOpen failed, align64 requires varlen, flags %x", flags);
+    return -SHMFIFO_ERR_OPEN_FLAGS;
+  }
+  if ((flags & SHMFIFO_FLAG_MIRROR) &&
+      !(flags & (SHMFIFO_FLAG_SLOT_MAPPED | SHMFIFO_FLAG_VARLEN))) {
+    SHMFIFO_ERR_OUT("ShmFifoOpen failed, mirror requires direct, broadcast or varlen, "
+      "flags %x", flags);
+    return -SHMFIFO_ERR_OPEN_FLAGS;
+  }
+  return SHMFIFO_ERR_NO;
+}
+
+/* a memfd only takes huge page sizes the kernel has a pool for */
+static int ShmFifoCheckPageSize(const char *path, size_t page)
+{
+  char pool[64];
+
+  if (page & (page - 1)) {
+    SHMFIFO_ERR_OUT("ShmFifoOpen failed, page size %lu is not a power of 2", page);
+    return -SHMFIFO_ERR_PAGE_SIZE;
+  }
+  if (path || page <= SHMFIFO_PAGE_SIZE) {
+    return SHMFIFO_ERR_NO;
+  }
+  snprintf(pool, sizeof(pool), SHMFIFO_HUGEPAGES_DIR "/hugepages-%lukB", page >> 10);
+  if (access(pool, F_OK)) {
+    SHMFIFO_ERR_OUT("ShmFifoOpen failed, page size %lu is not a supported huge page size",
+      page);
+    return -SHMFIFO_ERR_PAGE_SIZE;
+  }
+  return SHMFIFO_ERR_NO;
+}
+
+static int ShmFifoRingFlags(uint32_t flags, int mp, int mc)
+{
+  int ring_flags = 0;
+
+  if (!mp) {
+    ring_flags |= SHMFIFO_RING_SP_ENQ;
+  } else if (flags & SHMFIFO_FLAG_RTS) {
+    ring_flags |= SHMFIFO_RING_MP_RTS_ENQ;
+  }
+  if (!mc) {
+    ring_flags |= SHMFIFO_RING_SC_DEQ;
+  } else if (flags & SHMFIFO_FLAG_RTS) {
+    ring_flags |= SHMFIFO_RING_MC_RTS_DEQ;
+  }
+  return ring_flags;
+}
+
+static inline int ShmFifoDataObj(const struct ShmFifo *fifo, const void *buf,
+  struct ShmFifoObj *obj)
+{
+  size_t offset = (size_t)((const char *)buf - fifo->start_addr);
+
+  if (shmfifo_unlikely(offset >= fifo->data_size ||
+      (offset & ((1UL << SHMFIFO_OBJ_SHIFT) - 1)))) {
+    return SHMFIFO_FALSE;
+  }
+  obj->index = SHMFIFO_OBJ_INDEX(offset);
+  obj->size = 0;
+  return SHMFIFO_TRUE;
+}
+
+static void ShmFifoReset(struct ShmFifoHeader *header, size_t total_size, size_t list_size,
+  size_t ring_size, size_t msg_size, size_t msg_count, size_t data_size, uint32_t flags,
+  const struct ShmFifoClass *classes, uint32_t class_num)
+{
+  uint32_t c;
+  size_t   pool_offset;
+  size_t   data_offset = 0;
+
+  header->magic = SHMFIFO_MAGIC;
+  header->version = SHMFIFO_VERSION;
+  header->flags = flags;
+  header->total_size = total_size;
+  header->list_size = list_size;
+  header->msg_size = msg_size;
+  header->msg_count = msg_count;
+  header->data_size = data_size;
+  header->list_offset = sizeof(struct ShmFifoHeader);
+  header->obj_pool_offset = (flags & SHMFIFO_FLAG_NO_POOL) ?
+    0 : header->list_offset + list_size;
+  header->cursor_offset = (flags & SHMFIFO_FLAG_BROADCAST) ?
+    header->list_offset + list_size : 0;
+  header->data_offset = header->list_offset + ring_size;
+  /* the msg_size class keeps the first pool, the smaller ones follow it */
+  header->class_num = class_num;
+  memset(header->classes, 0, sizeof(header->classes));
+  memset(&header->stats, 0, sizeof(header->stats));
+  pool_offset = header->obj_pool_offset + ShmFifoRingMemSize(msg_count);
+  for (c = 0; c < class_num; ++c) {
+    header->classes[c].msg_size = classes[c].msg_size;
+    header->classes[c].msg_count = classes[c].msg_count;
+    if (c + 1 == class_num) {
+      header->classes[c].pool_offset = header->obj_pool_offset;
+    } else {
+      header->classes[c].pool_offset = pool_offset;
+      pool_offset += ShmFifoRingMemSize(classes[c].msg_count);
+    }
+    header->classes[c].data_offset = data_offset;
+    data_offset += classes[c].msg_size * classes[c].msg_count;
+  }
+  header->create_time = time(NULL);
+  header->creator = getpid();
+  ShmFifoWaitInit(&header->not_empty);
+  ShmFifoWaitInit(&header->not_full);
+  ShmFifoEventInit(&header->event);
+}
+
+static struct ShmFifo *ShmFifoHandle(struct ShmFifoHeader *header, int fd)
+{
+  struct ShmFifo *fifo = NULL;
+  uint32_t        c;
+
+  if (posix_memalign((void **)&fifo, SHMFIFO_CACHE_LINE, sizeof(struct ShmFifo)) != 0) {
+    SHMFIFO_ERR_OUT("ShmFifoOpen failed, alloc handle error");
+    return NULL;
+  }
+  memset(fifo, 0, sizeof(struct ShmFifo));
+  fifo->header = header;
+  if (header->flags & SHMFIFO_FLAG_VARLEN) {
+    fifo->bytes = (struct ShmFifoByteRing *)((char *)header + header->list_offset);
+  } else {
+    fifo->list = (struct ShmFifoRing *)((char *)header + header->list_offset);
+  }
+  if (header->obj_pool_offset) {
+    fifo->obj_pool = (struct ShmFifoRing *)((char *)header + header->obj_pool_offset);
+  }
+  if (header->cursor_offset) {
+    fifo->cursors = (struct ShmFifoCursorTable *)((char *)header + header->cursor_offset);
+  }
+  fifo->start_addr = (char *)header + header->data_offset;
+  fifo->msg_size = header->msg_size;
+  fifo->data_size = header->data_size;
+  fifo->total_size = header->total_size;
+  fifo->class_num = (uint32_t)header->class_num;
+  for (c = 0; c < fifo->class_num; ++c) {
+    fifo->classes[c].pool = (struct ShmFifoRing *)((char *)header +
+      header->classes[c].pool_offset);
+    fifo->classes[c].msg_size = header->classes[c].msg_size;
+    fifo->classes[c].data_end = header->classes[c].data_offset +
+      header->classes[c].msg_size * header->classes[c].msg_count;
+    fifo->prod.class_tail[c] = __atomic_load_n(&fifo->classes[c].pool->prod.tail,
+      __ATOMIC_ACQUIRE);
+    fifo->cons.class_tail[c] = __atomic_load_n(&fifo->classes[c].pool->cons.tail,
+      __ATOMIC_ACQUIRE);
+  }
+  fifo->flags = header->flags;
   fifo->fd = fd;
+  fifo->event_fd = SHMFIFO_INVALID_FD;
+
+  /* caches must never run ahead of the real tails */
+  if (fifo->bytes) {
+    fifo->prod.byte_tail = __atomic_load_n(&fifo->bytes->cons_tail, __ATOMIC_ACQUIRE);
+    fifo->cons.byte_tail = __atomic_load_n(&fifo->bytes->prod_tail, __ATOMIC_ACQUIRE);
+    return fifo;
+  }
+  fifo->mask = fifo->list->mask;
+  fifo->prod.list_tail = __atomic_load_n(&fifo->list->cons.tail, __ATOMIC_ACQUIRE);
+  fifo->cons.list_tail = __atomic_load_n(&fifo->list->prod.tail, __ATOMIC_ACQUIRE);
+  if (fifo->obj_pool) {
+    fifo->prod.pool_tail = __atomic_load_n(&fifo->obj_pool->prod.tail, __ATOMIC_ACQUIRE);
+    fifo->cons.pool_tail = __atomic_load_n(&fifo->obj_pool->cons.tail, __ATOMIC_ACQUIRE);
+  }
+  return fifo;
 }
 
-static int ShmFifoLoadVersion(int fd, uint32_t *magic, uint32_t *version)
+static int ShmFifoLoadVersion(int fd, uint32_t *magic, uint32_t *version, uint32_t *flags,
+  uint32_t *page_size)
 {
   ssize_t ret = SHMFIFO_ERR_NO;
   struct ShmFifoMeta {
     uint32_t  magic;
     uint32_t  version;
-  }meta = {0, 0};
+    uint32_t  flags;
+    uint32_t  page_size;
+  }meta = {0, 0, 0, 0};
   
   ret = pread(fd, &meta, sizeof(struct ShmFifoMeta), 0); 
   if (!ret) {
@@ -263,18 +2048,22 @@ static int ShmFifoLoadVersion(int fd, uint32_t *magic, uint32_t *version)
 SHMFIFO_DO_EXIT:
   *magic = meta.magic;
   *version = meta.version; 
+  *flags = meta.flags;
+  *page_size = meta.page_size;
 
   return SHMFIFO_ERR_NO;
 }
 
-static int ShmFifoFileReady(int fd, size_t size)
+static int ShmFifoFileReady(int fd, size_t size, uint32_t flags)
 {
   int         ret = SHMFIFO_ERR_NO;
   uint32_t    magic;
   uint32_t    version;
+  uint32_t    file_flags;
+  uint32_t    page_size;
   struct stat st;
 
-  ret = ShmFifoLoadVersion(fd, &magic, &version);
+  ret = ShmFifoLoadVersion(fd, &magic, &version, &file_flags, &page_size);
   if (ret != SHMFIFO_ERR_NO) {
     return SHMFIFO_FALSE;
   }
@@ -284,6 +2073,11 @@ static int ShmFifoFileReady(int fd, size_t size)
     return SHMFIFO_FALSE;
   }
 
+  if (file_flags != flags) {
+    SHMFIFO_ERR_OUT("fifo flags %x, %x error", file_flags, flags);
+    return -SHMFIFO_ERR_OPEN_FLAGS;
+  }
+
   if (fstat(fd, &st) < 0) {
     SHMFIFO_ERR_OUT("fstat failed, err %d", errno);
     return SHMFIFO_FALSE;
@@ -297,6 +2091,49 @@ static int ShmFifoFileReady(int fd, size_t size)
   return SHMFIFO_TRUE;
 }
 
+/* path NULL creates an anonymous memfd, on hugetlbfs when page is a huge page */
+static int ShmFifoOpenFile(const char *path, size_t page)
+{
+  unsigned int mfd_flags = 0;
+
+  if (path) {
+    return open(path, O_CREAT | O_RDWR, 0666);
+  }
+  if (page > SHMFIFO_PAGE_SIZE) {
+    mfd_flags = MFD_HUGETLB | ((unsigned int)__builtin_ctzl(page) << MFD_HUGE_SHIFT);
+  }
+  return memfd_create("shmfifo", mfd_flags);
+}
+
+/*
+ * page size the layout is aligned to, 0 on error: an initialized file keeps
+ * the one recorded in its header, hugetlbfs forces its own, otherwise the
+ * requested one, never below SHMFIFO_PAGE_SIZE
+ */
+static size_t ShmFifoPageSize(int fd, size_t page, int *hugetlb)
+{
+  struct statfs fs;
+  uint32_t      magic;
+  uint32_t      version;
+  uint32_t      flags;
+  uint32_t      file_page;
+
+  if (ShmFifoLoadVersion(fd, &magic, &version, &flags, &file_page) == SHMFIFO_ERR_NO &&
+      magic == SHMFIFO_MAGIC && version == SHMFIFO_VERSION && file_page) {
+    page = file_page;
+  }
+  if (fstatfs(fd, &fs) == 0 && fs.f_type == HUGETLBFS_MAGIC) {
+    if (page > SHMFIFO_PAGE_SIZE && page != (size_t)fs.f_bsize) {
+      SHMFIFO_ERR_OUT("ShmFifoOpen failed, page size %lu, hugetlbfs page %lu error", page,
+        (size_t)fs.f_bsize);
+      return 0;
+    }
+    *hugetlb = SHMFIFO_TRUE;
+    page = fs.f_bsize;
+  }
+  return page > SHMFIFO_PAGE_SIZE ? page : SHMFIFO_PAGE_SIZE;
+}
+
 static int ShmFifoFormat(int fd, size_t size)
 {
   if (ftruncate(fd, 0) < 0) {
@@ -311,3 +2148,43 @@ static int ShmFifoFormat(int fd, size_t size)
   return SHMFIFO_ERR_NO;
 }
 
+
+/*
+ * with SHMFIFO_FLAG_MIRROR the data region, which ends the file, is mapped a
+ * second time right behind itself so any run of slots or records is linear
+ */
+static void *ShmFifoMap(int fd, size_t total_size, size_t data_size, size_t page,
+  uint32_t flags, int populate)
+{
+  char  *base;
+  char  *start;
+  size_t slack;
+  int    share = populate ? MAP_SHARED | MAP_POPULATE : MAP_SHARED;
+
+  if (!(flags & SHMFIFO_FLAG_MIRROR)) {
+    return mmap(NULL, total_size, PROT_READ | PROT_WRITE, share, fd, 0);
+  }
+  /* fixed huge page mappings need a huge page aligned address */
+  slack = page > SHMFIFO_PAGE_SIZE ? page : 0;
+  start = (char *)mmap(NULL, total_size + data_size + slack, PROT_NONE,
+    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (start == (char *)MAP_FAILED) {
+    return MAP_FAILED;
+  }
+  base = (char *)SHMFIFO_SIZE_ALIGN((uintptr_t)start, slack ? page : SHMFIFO_PAGE_SIZE);
+  if (base != start) {
+    munmap(start, base - start);
+  }
+  if (slack > (size_t)(base - start)) {
+    munmap(base + total_size + data_size, slack - (base - start));
+  }
+  if (mmap(base, total_size, PROT_READ | PROT_WRITE, share | MAP_FIXED,
+      fd, 0) == MAP_FAILED ||
+      mmap(base + total_size, data_size, PROT_READ | PROT_WRITE, share | MAP_FIXED,
+      fd, (off_t)(total_size - data_size)) == MAP_FAILED) {
+    SHMFIFO_ERR_OUT("ShmFifoMap failed, mirror mmap error %d", errno);
+    munmap(base, total_size + data_size);
+    return MAP_FAILED;
+  }
+  return base;
+}
@@ -0,0 +1,12 @@
+#include "shmfifo_byte_ring.h"
+
+void ShmFifoByteRingInit(struct ShmFifoByteRing *ring, uint64_t size, uint32_t align,
+  uint32_t mirror)
+{
+  ring->size = size;
+  ring->mask = size - 1;
+  ring->align = align;
+  ring->mirror = mirror;
+  ring->prod_tail = 0;
+  ring->cons_tail = 0;
+}
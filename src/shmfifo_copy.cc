@@ -0,0 +1,119 @@
+#include "shmfifo_copy.h"
+
+#include <string.h>
+
+#include "shmfifo.h"
+#include "shmfifo_log.h"
+#include "shmfifo_error.h"
+#include "shmfifo_define.h"
+
+static void *ShmFifoCopyLibc(void *dst, const void *src, size_t n);
+static void *ShmFifoCopyResolve(void *dst, const void *src, size_t n);
+static void *ShmFifoCopyStreamResolve(void *dst, const void *src, size_t n);
+static void *ShmFifoCopyCellResolve(void *dst, const void *src, size_t n);
+
+/* the first copy resolves the kernel, like an ifunc that can be re-pointed */
+ShmFifoCopyFn shmfifo_copy_fn = ShmFifoCopyResolve;
+ShmFifoCopyFn shmfifo_copy_stream_fn = ShmFifoCopyStreamResolve;
+ShmFifoCopyFn shmfifo_copy_cell_fn = ShmFifoCopyCellResolve;
+static int    shmfifo_copy_kind = SHMFIFO_MEMCPY_AUTO;
+
+static const ShmFifoCopyFn shmfifo_copy_table[] = {
+  NULL,
+  ShmFifoCopyLibc,
+  ShmFifoCopySse,
+  ShmFifoCopyAvx2,
+  ShmFifoCopyAvx512,
+};
+
+/* libc has no streaming variant, forcing it keeps plain stores */
+static const ShmFifoCopyFn shmfifo_copy_stream_table[] = {
+  NULL,
+  ShmFifoCopyLibc,
+  ShmFifoCopyStreamSse,
+  ShmFifoCopyStreamAvx2,
+  ShmFifoCopyStreamAvx512,
+};
+
+static const ShmFifoCopyFn shmfifo_copy_cell_table[] = {
+  NULL,
+  ShmFifoCopyLibc,
+  ShmFifoCopyCellSse,
+  ShmFifoCopyCellAvx2,
+  ShmFifoCopyCellAvx512,
+};
+
+static int ShmFifoCopySupported(int kind)
+{
+  __builtin_cpu_init();
+  switch (kind) {
+  case SHMFIFO_MEMCPY_LIBC:
+    return SHMFIFO_TRUE;
+  case SHMFIFO_MEMCPY_SSE:
+    return __builtin_cpu_supports("ssse3");
+  case SHMFIFO_MEMCPY_AVX2:
+    return __builtin_cpu_supports("avx2");
+  case SHMFIFO_MEMCPY_AVX512:
+    return __builtin_cpu_supports("avx512f");
+  default:
+    return SHMFIFO_FALSE;
+  }
+}
+
+static int ShmFifoCopyBest(void)
+{
+  int kind;
+
+  for (kind = SHMFIFO_MEMCPY_AVX512; kind > SHMFIFO_MEMCPY_LIBC; --kind) {
+    if (ShmFifoCopySupported(kind)) {
+      break;
+    }
+  }
+  return kind;
+}
+
+static void *ShmFifoCopyLibc(void *dst, const void *src, size_t n)
+{
+  return memcpy(dst, src, n);
+}
+
+static void *ShmFifoCopyResolve(void *dst, const void *src, size_t n)
+{
+  ShmFifoMemcpySelect(SHMFIFO_MEMCPY_AUTO);
+  return shmfifo_copy_fn(dst, src, n);
+}
+
+static void *ShmFifoCopyStreamResolve(void *dst, const void *src, size_t n)
+{
+  ShmFifoMemcpySelect(SHMFIFO_MEMCPY_AUTO);
+  return shmfifo_copy_stream_fn(dst, src, n);
+}
+
+static void *ShmFifoCopyCellResolve(void *dst, const void *src, size_t n)
+{
+  ShmFifoMemcpySelect(SHMFIFO_MEMCPY_AUTO);
+  return shmfifo_copy_cell_fn(dst, src, n);
+}
+
+int ShmFifoMemcpySelect(int kind)
+{
+  if (kind == SHMFIFO_MEMCPY_AUTO) {
+    kind = ShmFifoCopyBest();
+  } else if (!ShmFifoCopySupported(kind)) {
+    SHMFIFO_ERR_OUT("ShmFifoMemcpySelect failed, kind %d not supported by this cpu", kind);
+    return -SHMFIFO_ERR_MEMCPY_KIND;
+  }
+  __atomic_store_n(&shmfifo_copy_kind, kind, __ATOMIC_RELAXED);
+  __atomic_store_n(&shmfifo_copy_fn, shmfifo_copy_table[kind], __ATOMIC_RELAXED);
+  __atomic_store_n(&shmfifo_copy_stream_fn, shmfifo_copy_stream_table[kind], __ATOMIC_RELAXED);
+  __atomic_store_n(&shmfifo_copy_cell_fn, shmfifo_copy_cell_table[kind], __ATOMIC_RELAXED);
+  return kind;
+}
+
+int ShmFifoMemcpyKind(void)
+{
+  if (__atomic_load_n(&shmfifo_copy_kind, __ATOMIC_RELAXED) == SHMFIFO_MEMCPY_AUTO) {
+    ShmFifoMemcpySelect(SHMFIFO_MEMCPY_AUTO);
+  }
+  return __atomic_load_n(&shmfifo_copy_kind, __ATOMIC_RELAXED);
+}
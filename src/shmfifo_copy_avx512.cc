@@ -0,0 +1,18 @@
+/* built with -mavx512f, only called after cpuid reported support */
+#include "shmfifo_memcpy.h"
+#include "shmfifo_copy.h"
+
+void *ShmFifoCopyAvx512(void *dst, const void *src, size_t n)
+{
+  return shmfifo_fast_memcpy(dst, src, n);
+}
+
+void *ShmFifoCopyStreamAvx512(void *dst, const void *src, size_t n)
+{
+  return shmfifo_stream_memcpy(dst, src, n);
+}
+
+void *ShmFifoCopyCellAvx512(void *dst, const void *src, size_t n)
+{
+  return shmfifo_cell_memcpy(dst, src, n);
+}
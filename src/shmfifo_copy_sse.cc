@@ -0,0 +1,18 @@
+/* built with -mssse3, only called after cpuid reported support */
+#include "shmfifo_memcpy.h"
+#include "shmfifo_copy.h"
+
+void *ShmFifoCopySse(void *dst, const void *src, size_t n)
+{
+  return shmfifo_fast_memcpy(dst, src, n);
+}
+
+void *ShmFifoCopyStreamSse(void *dst, const void *src, size_t n)
+{
+  return shmfifo_stream_memcpy(dst, src, n);
+}
+
+void *ShmFifoCopyCellSse(void *dst, const void *src, size_t n)
+{
+  return shmfifo_cell_memcpy(dst, src, n);
+}
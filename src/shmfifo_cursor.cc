@@ -0,0 +1,155 @@
+#include "shmfifo_cursor.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "shmfifo_error.h"
+
+static uint32_t ShmFifoCursorMin(struct ShmFifoCursorTable *table, uint32_t min);
+static int ShmFifoCursorDead(const struct ShmFifoCursor *cursor);
+
+void ShmFifoCursorTableInit(struct ShmFifoCursorTable *table)
+{
+  uint32_t i;
+
+  table->count = 0;
+  for (i = 0; i < SHMFIFO_CURSOR_MAX; ++i) {
+    table->cursor[i].pos = 0;
+    table->cursor[i].state = SHMFIFO_CURSOR_FREE;
+    table->cursor[i].pid = 0;
+  }
+}
+
+/* take a free cursor, or one left behind by a process that no longer exists */
+int ShmFifoCursorClaim(struct ShmFifoCursorTable *table)
+{
+  uint32_t              i;
+  uint32_t              state;
+  uint32_t              count;
+  struct ShmFifoCursor *cursor;
+
+  for (i = 0; i < SHMFIFO_CURSOR_MAX; ++i) {
+    cursor = &table->cursor[i];
+    state = __atomic_load_n(&cursor->state, __ATOMIC_ACQUIRE);
+    if (state != SHMFIFO_CURSOR_FREE && (state == SHMFIFO_CURSOR_JOINING ||
+        !ShmFifoCursorDead(cursor))) {
+      continue;
+    }
+    if (!__atomic_compare_exchange_n(&cursor->state, &state, SHMFIFO_CURSOR_JOINING,
+        0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      continue;
+    }
+    count = __atomic_load_n(&table->count, __ATOMIC_RELAXED);
+    while (count <= i && !__atomic_compare_exchange_n(&table->count, &count, i + 1,
+        0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+    return (int)i;
+  }
+  return -SHMFIFO_ERR_CURSOR_FULL;
+}
+
+/*
+ * start reading at the producer's tail; if a concurrent gate moved past the
+ * chosen position without seeing this cursor, skip ahead to the gate
+ */
+void ShmFifoCursorJoin(struct ShmFifoCursor *cursor, struct ShmFifoRing *list)
+{
+  uint32_t pos = __atomic_load_n(&list->prod.tail, __ATOMIC_ACQUIRE);
+  uint32_t gate;
+
+  cursor->pid = getpid();
+  __atomic_store_n(&cursor->pos, pos, __ATOMIC_RELAXED);
+  __atomic_store_n(&cursor->state, SHMFIFO_CURSOR_LIVE, __ATOMIC_RELEASE);
+  for (;;) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    gate = __atomic_load_n(&list->cons.tail, __ATOMIC_ACQUIRE);
+    if ((int32_t)(pos - gate) >= 0) {
+      break;
+    }
+    pos = gate;
+    __atomic_store_n(&cursor->pos, pos, __ATOMIC_RELEASE);
+  }
+}
+
+void ShmFifoCursorRelease(struct ShmFifoCursor *cursor)
+{
+  __atomic_store_n(&cursor->state, SHMFIFO_CURSOR_FREE, __ATOMIC_RELEASE);
+}
+
+/*
+ * producer only, publish the slowest live position as list cons.tail; when
+ * that leaves less than n free entries, drop subscribers of dead processes
+ * and, if evict is set, the subscribers holding the slowest position
+ */
+uint32_t ShmFifoCursorGate(struct ShmFifoCursorTable *table, struct ShmFifoRing *list,
+  unsigned int n, int evict)
+{
+  uint32_t              head = __atomic_load_n(&list->prod.head, __ATOMIC_RELAXED);
+  uint32_t              min;
+  uint32_t              pos;
+  uint32_t              count;
+  uint32_t              state;
+  uint32_t              i;
+  int                   changed;
+  struct ShmFifoCursor *cursor;
+
+  do {
+    changed = SHMFIFO_FALSE;
+    min = ShmFifoCursorMin(table, head);
+    if (head + n - min <= list->capacity) {
+      break;
+    }
+    count = __atomic_load_n(&table->count, __ATOMIC_ACQUIRE);
+    for (i = 0; i < count; ++i) {
+      cursor = &table->cursor[i];
+      state = SHMFIFO_CURSOR_LIVE;
+      if (__atomic_load_n(&cursor->state, __ATOMIC_ACQUIRE) != state ||
+          __atomic_load_n(&cursor->pos, __ATOMIC_ACQUIRE) != min) {
+        continue;
+      }
+      if (ShmFifoCursorDead(cursor)) {
+        changed |= __atomic_compare_exchange_n(&cursor->state, &state,
+          SHMFIFO_CURSOR_FREE, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+      } else if (evict) {
+        changed |= __atomic_compare_exchange_n(&cursor->state, &state,
+          SHMFIFO_CURSOR_EVICTED, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+      }
+    }
+  } while (changed);
+
+  __atomic_store_n(&list->cons.tail, min, __ATOMIC_RELEASE);
+  /* orders evictions before slot reuse, and pairs with ShmFifoCursorJoin */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  pos = ShmFifoCursorMin(table, min);
+  if (pos != min) {
+    min = pos;
+    __atomic_store_n(&list->cons.tail, min, __ATOMIC_RELEASE);
+  }
+  return min;
+}
+
+static uint32_t ShmFifoCursorMin(struct ShmFifoCursorTable *table, uint32_t min)
+{
+  uint32_t              i;
+  uint32_t              pos;
+  uint32_t              count = __atomic_load_n(&table->count, __ATOMIC_ACQUIRE);
+  struct ShmFifoCursor *cursor;
+
+  for (i = 0; i < count; ++i) {
+    cursor = &table->cursor[i];
+    if (!ShmFifoCursorLive(cursor)) {
+      continue;
+    }
+    pos = __atomic_load_n(&cursor->pos, __ATOMIC_ACQUIRE);
+    if ((int32_t)(pos - min) < 0) {
+      min = pos;
+    }
+  }
+  return min;
+}
+
+static int ShmFifoCursorDead(const struct ShmFifoCursor *cursor)
+{
+  return cursor->pid > 0 && kill(cursor->pid, 0) < 0 && errno == ESRCH;
+}
@@ -0,0 +1,60 @@
+#include "shmfifo_event.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "shmfifo_log.h"
+
+void ShmFifoEventInit(struct ShmFifoEvent *event)
+{
+  event->armed = 0;
+}
+
+/*
+ * the doorbell is a named fifo next to the fifo file, opened read-write so
+ * the open never blocks, a write never raises SIGPIPE and the read end
+ * never reports EPOLLHUP when the last producer goes away
+ */
+int ShmFifoEventOpen(const char *path)
+{
+  int  fd;
+  char event_path[SHMFIFO_PATH_MAX];
+
+  if (snprintf(event_path, sizeof(event_path), "%s" SHMFIFO_EVENT_SUFFIX, path) >=
+      (int)sizeof(event_path)) {
+    SHMFIFO_ERR_OUT("event open failed, path %s too long", path);
+    return -SHMFIFO_ERR_EVENT_PATH;
+  }
+  if (mkfifo(event_path, 0666) < 0 && errno != EEXIST) {
+    SHMFIFO_ERR_OUT("event open failed, mkfifo %s error %d", event_path, errno);
+    return -SHMFIFO_ERR_EVENT_MKFIFO;
+  }
+  fd = open(event_path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) {
+    SHMFIFO_ERR_OUT("event open failed, open %s error %d", event_path, errno);
+    return -SHMFIFO_ERR_EVENT_OPEN;
+  }
+  return fd;
+}
+
+void ShmFifoEventKick(int fd)
+{
+  char c = 0;
+
+  /* EAGAIN means the doorbell is already readable */
+  if (write(fd, &c, sizeof(c)) < 0 && errno != EAGAIN) {
+    SHMFIFO_ERR_OUT("event kick failed, write error %d", errno);
+  }
+}
+
+void ShmFifoEventDrain(int fd)
+{
+  char buf[64];
+
+  while (read(fd, buf, sizeof(buf)) == (ssize_t)sizeof(buf)) {
+  }
+}
@@ -0,0 +1,99 @@
+#include "shmfifo_numa.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#ifndef FIFO_DISABLE_NUMA
+#include <numa.h>
+#include <numaif.h>
+#endif
+
+#include "shmfifo.h"
+#include "shmfifo_log.h"
+#include "shmfifo_error.h"
+
+#ifndef FIFO_DISABLE_NUMA
+#define SHMFIFO_NUMA_MASK_BITS (1024)
+
+static int ShmFifoNumaPolicy(void *addr, size_t size, int mode, const unsigned long *mask)
+{
+  if (!size) {
+    return SHMFIFO_ERR_NO;
+  }
+  if (mbind(addr, size, mode, mask, SHMFIFO_NUMA_MASK_BITS, MPOL_MF_MOVE) < 0) {
+    SHMFIFO_ERR_OUT("numa bind failed, mbind %p size %lu mode %d error %d", addr, size,
+      mode, errno);
+    return -SHMFIFO_ERR_NUMA;
+  }
+  return SHMFIFO_ERR_NO;
+}
+
+int ShmFifoNumaBind(void *addr, size_t ctrl_size, size_t size, size_t page, int node,
+  int interleave)
+{
+  unsigned long mask[SHMFIFO_NUMA_MASK_BITS / (8 * sizeof(unsigned long))];
+  struct bitmask *allowed;
+  int            ret;
+  int            i;
+
+  if (numa_available() < 0) {
+    SHMFIFO_ERR_OUT("numa bind failed, numa not available");
+    return -SHMFIFO_ERR_NUMA;
+  }
+  if (node == SHMFIFO_NUMA_LOCAL) {
+    node = numa_node_of_cpu(sched_getcpu());
+  }
+  if (node >= SHMFIFO_NUMA_MASK_BITS || node > numa_max_node()) {
+    SHMFIFO_ERR_OUT("numa bind failed, node %d, max %d error", node, numa_max_node());
+    return -SHMFIFO_ERR_NUMA;
+  }
+  /* the page shared by the control lines and the first slots stays local */
+  ctrl_size = interleave ? SHMFIFO_SIZE_ALIGN(ctrl_size, page) : size;
+  if (ctrl_size > size) {
+    ctrl_size = size;
+  }
+  if (node >= 0) {
+    memset(mask, 0, sizeof(mask));
+    mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+    ret = ShmFifoNumaPolicy(addr, ctrl_size, MPOL_BIND, mask);
+    if (ret != SHMFIFO_ERR_NO) {
+      return ret;
+    }
+  }
+  if (!interleave) {
+    return SHMFIFO_ERR_NO;
+  }
+  memset(mask, 0, sizeof(mask));
+  allowed = numa_get_mems_allowed();
+  for (i = 0; i <= numa_max_node() && i < SHMFIFO_NUMA_MASK_BITS; ++i) {
+    if (numa_bitmask_isbitset(allowed, i)) {
+      mask[i / (8 * sizeof(unsigned long))] |= 1UL << (i % (8 * sizeof(unsigned long)));
+    }
+  }
+  numa_bitmask_free(allowed);
+  return ShmFifoNumaPolicy((char *)addr + ctrl_size, size - ctrl_size, MPOL_INTERLEAVE, mask);
+}
+
+int ShmFifoNumaNodeOf(const void *addr)
+{
+  int node = -1;
+
+  if (get_mempolicy(&node, NULL, 0, (void *)addr, MPOL_F_NODE | MPOL_F_ADDR) < 0) {
+    SHMFIFO_ERR_OUT("numa node failed, get_mempolicy %p error %d", addr, errno);
+    return -SHMFIFO_ERR_NUMA;
+  }
+  return node;
+}
+#else
+int ShmFifoNumaBind(void *addr, size_t ctrl_size, size_t size, size_t page, int node,
+  int interleave)
+{
+  SHMFIFO_ERR_OUT("numa bind failed, built without libnuma");
+  return -SHMFIFO_ERR_NUMA;
+}
+
+int ShmFifoNumaNodeOf(const void *addr)
+{
+  return -SHMFIFO_ERR_NUMA;
+}
+#endif
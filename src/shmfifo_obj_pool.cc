@@ -5,16 +5,21 @@
 
 #include "shmfifo_error.h"
 
-int ShmFifoObjPoolInit(struct ShmFifoRing *obj_pool, size_t msg_size, uint32_t msg_count)
+int ShmFifoObjPoolInit(struct ShmFifoRing *obj_pool, size_t offset, size_t msg_size,
+  uint32_t msg_count, int flags)
 {
   uint32_t        i;
   unsigned int    n;
   struct ShmFifoObj *obj_list;
   
-  ShmFifoRingInit(obj_pool, msg_count, SHMFIFO_RING_SP_ENQ | SHMFIFO_RING_SC_DEQ);
+  ShmFifoRingInit(obj_pool, msg_count, flags);
   obj_list = (struct ShmFifoObj *)malloc(sizeof(struct ShmFifoObj) * msg_count);
+  if (!obj_list) {
+    SHMFIFO_ERR_OUT("ShmFifoObjPoolInit failed, malloc %u objs error", msg_count);
+    return -SHMFIFO_ERR_OBJ_POOL_INIT_ENQUEUE;
+  }
   for (i = 0; i < msg_count; ++i) {
-    obj_list[i].offset = i * msg_size;
+    obj_list[i].index = SHMFIFO_OBJ_INDEX(offset + i * msg_size);
     obj_list[i].size = 0;
   }
   n = ShmFifoRingEnqueueBulk(obj_pool, obj_list, msg_count, NULL);
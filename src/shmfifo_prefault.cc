@@ -0,0 +1,86 @@
+#include "shmfifo_prefault.h"
+
+#include <pthread.h>
+#include <sys/mman.h>
+
+struct ShmFifoPrefaultRange {
+  char     *addr;
+  size_t    size;
+  size_t    page;
+  pthread_t tid;
+  int       started;
+};
+
+static void *ShmFifoPrefaultRun(void *arg)
+{
+  struct ShmFifoPrefaultRange *range = (struct ShmFifoPrefaultRange *)arg;
+  size_t                       i;
+
+  for (i = 0; i < range->size; i += range->page) {
+    (void)((volatile char *)range->addr)[i];
+  }
+  return NULL;
+}
+
+void ShmFifoPrefault(void *addr, size_t size, size_t page, uint32_t threads)
+{
+  struct ShmFifoPrefaultRange range[SHMFIFO_PREFAULT_THREADS_MAX];
+  size_t                      pages = (size + page - 1) / page;
+  size_t                      per;
+  size_t                      off = 0;
+  long                        cpus;
+  uint32_t                    i;
+
+  if (!threads) {
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 0 ? (uint32_t)cpus : 1;
+  }
+  if (threads > SHMFIFO_PREFAULT_THREADS_MAX) {
+    threads = SHMFIFO_PREFAULT_THREADS_MAX;
+  }
+  if (threads > size / SHMFIFO_PREFAULT_CHUNK) {
+    threads = (uint32_t)(size / SHMFIFO_PREFAULT_CHUNK);
+  }
+  if (threads <= 1) {
+    range[0].addr = (char *)addr;
+    range[0].size = size;
+    range[0].page = page;
+    ShmFifoPrefaultRun(&range[0]);
+    return;
+  }
+  /* the calling thread takes the last run itself */
+  per = (pages + threads - 1) / threads * page;
+  for (i = 0; i < threads; ++i) {
+    range[i].addr = (char *)addr + off;
+    range[i].size = SHMFIFO_MIN(per, size - off);
+    range[i].page = page;
+    range[i].started = 0;
+    off += range[i].size;
+    if (i + 1 < threads) {
+      range[i].started = !pthread_create(&range[i].tid, NULL, ShmFifoPrefaultRun, &range[i]);
+    }
+    if (!range[i].started) {
+      ShmFifoPrefaultRun(&range[i]);
+    }
+  }
+  for (i = 0; i < threads; ++i) {
+    if (range[i].started) {
+      pthread_join(range[i].tid, NULL);
+    }
+  }
+}
+
+int ShmFifoLock(void *addr, size_t size, int lazy)
+{
+#ifdef MLOCK_ONFAULT
+  if (lazy) {
+    return mlock2(addr, size, MLOCK_ONFAULT);
+  }
+#else
+  /* without MLOCK_ONFAULT locking would fault the whole range in again */
+  if (lazy) {
+    return 0;
+  }
+#endif
+  return mlock(addr, size);
+}
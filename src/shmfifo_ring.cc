@@ -7,14 +7,26 @@ void ShmFifoRingInit(struct ShmFifoRing *ring, uint32_t count, int flags)
   ring->capacity = count;
   ring->prod.head = ring->prod.tail = 0;
   ring->cons.head = ring->cons.tail = 0;
+  ring->rts_prod.head.raw = 0;
+  ring->rts_cons.head.raw = 0;
+  ring->rts_prod.htd_max = 0;
+  ring->rts_cons.htd_max = 0;
+  ring->prod_retries = 0;
+  ring->cons_retries = 0;
   if (flags & SHMFIFO_RING_SP_ENQ) {
-    ring->prod.single = 1;
+    ring->prod.sync_type = SHMFIFO_RING_SYNC_ST;
+  } else if (flags & SHMFIFO_RING_MP_RTS_ENQ) {
+    ring->prod.sync_type = SHMFIFO_RING_SYNC_MT_RTS;
+    ring->rts_prod.htd_max = count >> 3;
   } else {
-    ring->prod.single = 0;
+    ring->prod.sync_type = SHMFIFO_RING_SYNC_MT;
   }
   if (flags & SHMFIFO_RING_SC_DEQ) {
-    ring->cons.single = 1;
+    ring->cons.sync_type = SHMFIFO_RING_SYNC_ST;
+  } else if (flags & SHMFIFO_RING_MC_RTS_DEQ) {
+    ring->cons.sync_type = SHMFIFO_RING_SYNC_MT_RTS;
+    ring->rts_cons.htd_max = count >> 3;
   } else {
-    ring->cons.single = 0;
+    ring->cons.sync_type = SHMFIFO_RING_SYNC_MT;
   }
 }
@@ -0,0 +1,38 @@
+#include "shmfifo_wait.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "shmfifo_log.h"
+
+void ShmFifoWaitInit(struct ShmFifoWaitQueue *wq)
+{
+  wq->seq = 0;
+  wq->waiters = 0;
+}
+
+/* deadline is absolute CLOCK_MONOTONIC, NULL waits forever */
+int ShmFifoWaitSleep(struct ShmFifoWaitQueue *wq, uint32_t seq,
+  const struct timespec *deadline)
+{
+  if (syscall(SYS_futex, &wq->seq, FUTEX_WAIT_BITSET, seq, deadline, NULL,
+      FUTEX_BITSET_MATCH_ANY) < 0) {
+    if (errno == ETIMEDOUT) {
+      return -SHMFIFO_ERR_TIMEOUT;
+    }
+    if (errno != EAGAIN && errno != EINTR) {
+      SHMFIFO_ERR_OUT("futex wait failed, err %d", errno);
+      return -SHMFIFO_ERR_WAIT_FUTEX;
+    }
+  }
+  return SHMFIFO_ERR_NO;
+}
+
+void ShmFifoWaitWakeAll(struct ShmFifoWaitQueue *wq)
+{
+  __atomic_fetch_add(&wq->seq, 1, __ATOMIC_RELEASE);
+  syscall(SYS_futex, &wq->seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
@@ -0,0 +1,195 @@
+#include <string>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "shmfifo.h"
+#include "shmfifo_error.h"
+#include "shmfifo_log.h"
+#include "test_check.h"
+
+#define TEST_BROADCAST_SIZE  (64)
+#define TEST_BROADCAST_COUNT (8)
+
+static struct ShmFifo *BroadcastOpen(const std::string &fifo_name, uint32_t flags)
+{
+  struct ShmFifoAttr attr;
+
+  ShmFifoAttrInit(&attr);
+  attr.flags = SHMFIFO_FLAG_BROADCAST | flags;
+  return ShmFifoOpenAttr(fifo_name.c_str(), TEST_BROADCAST_SIZE, TEST_BROADCAST_COUNT, &attr);
+}
+
+static ssize_t BroadcastPush(struct ShmFifo *fifo, uint64_t seq)
+{
+  return ShmFifoPush(fifo, (const char *)&seq, sizeof(seq));
+}
+
+/* pops one message and checks it is the next one this subscriber expects */
+static int BroadcastExpect(struct ShmFifo *fifo, uint64_t seq)
+{
+  uint64_t got = ~0ULL;
+
+  TEST_CHECK(ShmFifoPopData(fifo, (char *)&got, sizeof(got)) == sizeof(got));
+  if (got != seq) {
+    SHMFIFO_ERR_OUT("subscriber got seq %lu, expected %lu", got, seq);
+    return TEST_FAIL;
+  }
+  return SHMFIFO_ERR_NO;
+}
+
+#define TEST_EXPECT(fifo_, seq_) TEST_CHECK(BroadcastExpect(fifo_, seq_) == SHMFIFO_ERR_NO)
+
+/* every subscriber reads every message, the producer waits for the slowest */
+static int BroadcastGate(const std::string &fifo_name)
+{
+  struct ShmFifo *prod;
+  struct ShmFifo *a;
+  struct ShmFifo *b;
+  uint64_t        seq = 0;
+  uint64_t        first;
+  uint64_t        got;
+
+  unlink(fifo_name.c_str());
+  prod = BroadcastOpen(fifo_name, 0);
+  a = BroadcastOpen(fifo_name, 0);
+  b = BroadcastOpen(fifo_name, 0);
+  TEST_CHECK(prod && a && b);
+
+  /* nobody subscribed, nothing holds the producer back */
+  for (int i = 0; i < TEST_BROADCAST_COUNT * 3; ++i) {
+    TEST_CHECK(BroadcastPush(prod, seq++) == sizeof(seq));
+  }
+  TEST_CHECK(ShmFifoSubscribe(a) >= 0);
+  TEST_CHECK(ShmFifoSubscribe(b) >= 0);
+  TEST_CHECK(ShmFifoPopData(a, (char *)&got, sizeof(got)) == -SHMFIFO_ERR_EMPTY);
+
+  first = seq;
+  while (BroadcastPush(prod, seq) == sizeof(seq)) {
+    ++seq;
+  }
+  TEST_CHECK(seq - first >= TEST_BROADCAST_COUNT);
+  for (uint64_t i = first; i < seq; ++i) {
+    TEST_EXPECT(a, i);
+  }
+  /* a is drained, b still holds every slot */
+  TEST_CHECK(BroadcastPush(prod, seq) == -SHMFIFO_ERR_FULL);
+  TEST_EXPECT(b, first);
+  TEST_CHECK(BroadcastPush(prod, seq) == sizeof(seq));
+  TEST_CHECK(BroadcastPush(prod, seq + 1) == -SHMFIFO_ERR_FULL);
+  TEST_EXPECT(a, seq);
+  for (uint64_t i = first + 1; i <= seq; ++i) {
+    TEST_EXPECT(b, i);
+  }
+  TEST_CHECK(ShmFifoPopData(b, (char *)&got, sizeof(got)) == -SHMFIFO_ERR_EMPTY);
+  ++seq;
+
+  /* an unsubscribed reader no longer gates the producer */
+  TEST_CHECK(ShmFifoUnsubscribe(b) == SHMFIFO_ERR_NO);
+  for (int i = 0; i < TEST_BROADCAST_COUNT * 3; ++i) {
+    TEST_CHECK(BroadcastPush(prod, seq) == sizeof(seq));
+    TEST_EXPECT(a, seq);
+    ++seq;
+  }
+
+  ShmFifoClose(b);
+  ShmFifoClose(a);
+  ShmFifoClose(prod);
+  unlink(fifo_name.c_str());
+  return SHMFIFO_ERR_NO;
+}
+
+/* a full fifo evicts the slowest subscriber, which has to subscribe again */
+static int BroadcastEvict(const std::string &fifo_name)
+{
+  struct ShmFifo *prod;
+  struct ShmFifo *a;
+  struct ShmFifo *b;
+  uint64_t        seq = 0;
+  uint64_t        got;
+
+  unlink(fifo_name.c_str());
+  prod = BroadcastOpen(fifo_name, SHMFIFO_FLAG_EVICT);
+  a = BroadcastOpen(fifo_name, SHMFIFO_FLAG_EVICT);
+  b = BroadcastOpen(fifo_name, SHMFIFO_FLAG_EVICT);
+  TEST_CHECK(prod && a && b);
+  TEST_CHECK(ShmFifoSubscribe(a) >= 0);
+  TEST_CHECK(ShmFifoSubscribe(b) >= 0);
+
+  for (int i = 0; i < TEST_BROADCAST_COUNT * 3; ++i) {
+    TEST_CHECK(BroadcastPush(prod, seq) == sizeof(seq));
+    TEST_EXPECT(a, seq);
+    ++seq;
+  }
+  TEST_CHECK(ShmFifoPopData(b, (char *)&got, sizeof(got)) == -SHMFIFO_ERR_EVICTED);
+  TEST_CHECK(ShmFifoPopData(b, (char *)&got, sizeof(got)) == -SHMFIFO_ERR_EVICTED);
+
+  TEST_CHECK(ShmFifoSubscribe(b) >= 0);
+  TEST_CHECK(BroadcastPush(prod, seq) == sizeof(seq));
+  TEST_EXPECT(a, seq);
+  TEST_EXPECT(b, seq);
+
+  ShmFifoClose(b);
+  ShmFifoClose(a);
+  ShmFifoClose(prod);
+  unlink(fifo_name.c_str());
+  return SHMFIFO_ERR_NO;
+}
+
+/* a subscriber whose process exited without closing is dropped once it blocks */
+static int BroadcastDead(const std::string &fifo_name)
+{
+  struct ShmFifo *prod;
+  struct ShmFifo *a;
+  pid_t           pid;
+  int             status;
+  uint64_t        seq = 0;
+
+  unlink(fifo_name.c_str());
+  prod = BroadcastOpen(fifo_name, 0);
+  a = BroadcastOpen(fifo_name, 0);
+  TEST_CHECK(prod && a);
+  TEST_CHECK(ShmFifoSubscribe(a) >= 0);
+
+  pid = fork();
+  TEST_CHECK(pid >= 0);
+  if (pid == 0) {
+    struct ShmFifo *dead = BroadcastOpen(fifo_name, 0);
+    _exit((dead && ShmFifoSubscribe(dead) >= 0) ? 0 : 1);
+  }
+  TEST_CHECK(waitpid(pid, &status, 0) == pid);
+  TEST_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  for (int i = 0; i < TEST_BROADCAST_COUNT * 3; ++i) {
+    TEST_CHECK(BroadcastPush(prod, seq) == sizeof(seq));
+    TEST_EXPECT(a, seq);
+    ++seq;
+  }
+
+  ShmFifoClose(a);
+  ShmFifoClose(prod);
+  unlink(fifo_name.c_str());
+  return SHMFIFO_ERR_NO;
+}
+
+int TestBroadcast(std::string fifo_name)
+{
+  int ret;
+
+  ret = BroadcastGate(fifo_name);
+  if (ret != SHMFIFO_ERR_NO) {
+    SHMFIFO_ERR_OUT("broadcast gate failed");
+    return ret;
+  }
+  ret = BroadcastEvict(fifo_name);
+  if (ret != SHMFIFO_ERR_NO) {
+    SHMFIFO_ERR_OUT("broadcast evict failed");
+    return ret;
+  }
+  ret = BroadcastDead(fifo_name);
+  if (ret != SHMFIFO_ERR_NO) {
+    SHMFIFO_ERR_OUT("broadcast dead subscriber failed");
+    return ret;
+  }
+  return SHMFIFO_ERR_NO;
+}
@@ -0,0 +1,5 @@
+#ifndef TEST_BROADCAST_H_
+#define TEST_BROADCAST_H_
+#include <string>
+int TestBroadcast(std::string fifo_name);
+#endif
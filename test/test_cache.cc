@@ -0,0 +1,178 @@
+#include <string>
+#include <string.h>
+
+#include "shmfifo.h"
+#include "shmfifo_error.h"
+#include "shmfifo_log.h"
+#include "test_check.h"
+
+#define TEST_CACHE_SIZE  (48)
+#define TEST_CACHE_COUNT (8)
+
+static struct ShmFifo *CacheOpen(const std::string &fifo_name, uint32_t flags)
+{
+  struct ShmFifoAttr attr;
+
+  ShmFifoAttrInit(&attr);
+  attr.flags = flags;
+  return ShmFifoOpenAttr(fifo_name.c_str(), TEST_CACHE_SIZE, TEST_CACHE_COUNT, &attr);
+}
+
+static ssize_t CachePush(struct ShmFifo *fifo, uint64_t seq, size_t size)
+{
+  char buf[TEST_CACHE_SIZE];
+
+  memset(buf, 0, sizeof(buf));
+  memcpy(buf, &seq, sizeof(seq));
+  return ShmFifoPush(fifo, buf, size);
+}
+
+static uint64_t CacheSeq(const void *data)
+{
+  uint64_t seq;
+
+  memcpy(&seq, data, sizeof(seq));
+  return seq;
+}
+
+/*
+ * producer and consumer handles each cache the other side's tail, a full
+ * or empty answer from the cache must be checked against the shared one
+ */
+static int CacheRefresh(const std::string &fifo_name, uint32_t flags)
+{
+  struct ShmFifo *prod;
+  struct ShmFifo *cons;
+  struct iovec    iov[TEST_CACHE_COUNT * 2];
+  size_t          size;
+  void           *data;
+  uint64_t        seq = 0;
+  uint64_t        next = 0;
+  ssize_t         n;
+
+  unlink(fifo_name.c_str());
+  prod = CacheOpen(fifo_name, flags);
+  cons = CacheOpen(fifo_name, flags);
+  TEST_CHECK(prod && cons);
+
+  TEST_CHECK(ShmFifoTop(cons, &size) == NULL);
+  while (CachePush(prod, seq, sizeof(seq)) == sizeof(seq)) {
+    ++seq;
+  }
+  TEST_CHECK(seq >= TEST_CACHE_COUNT);
+  TEST_CHECK(CachePush(prod, seq, sizeof(seq)) == -SHMFIFO_ERR_FULL);
+
+  data = ShmFifoTop(cons, &size);
+  TEST_CHECK(data && size == sizeof(seq) && CacheSeq(data) == next);
+  TEST_CHECK(ShmFifoPop(cons) == SHMFIFO_ERR_NO);
+  ++next;
+  /* the producer's cached consumer tail still says full */
+  TEST_CHECK(CachePush(prod, seq, sizeof(seq)) == sizeof(seq));
+  ++seq;
+  TEST_CHECK(CachePush(prod, seq, sizeof(seq)) == -SHMFIFO_ERR_FULL);
+
+  n = ShmFifoTopBurst(cons, iov, TEST_CACHE_COUNT * 2);
+  TEST_CHECK(n == (ssize_t)(seq - next));
+  for (ssize_t i = 0; i < n; ++i) {
+    TEST_CHECK(CacheSeq(iov[i].iov_base) == next + i);
+  }
+  TEST_CHECK(ShmFifoPopBulk(cons, n) == SHMFIFO_ERR_NO);
+  next += n;
+  TEST_CHECK(ShmFifoTop(cons, &size) == NULL);
+
+  /* the consumer's cached producer tail still says empty */
+  TEST_CHECK(CachePush(prod, seq, sizeof(seq)) == sizeof(seq));
+  data = ShmFifoTop(cons, &size);
+  TEST_CHECK(data && CacheSeq(data) == next);
+  TEST_CHECK(ShmFifoPop(cons) == SHMFIFO_ERR_NO);
+
+  ShmFifoClose(cons);
+  ShmFifoClose(prod);
+  unlink(fifo_name.c_str());
+  SHMFIFO_DEBUG_OUT("flags %x, cached tails ok", flags);
+  return SHMFIFO_ERR_NO;
+}
+
+/*
+ * with several consumers the cached producer tail of an idle one falls
+ * behind the shared head, its peek must not read the stale entries
+ */
+static int CacheMultiConsumer(const std::string &fifo_name, uint32_t flags)
+{
+  struct ShmFifo *prod;
+  struct ShmFifo *a;
+  struct ShmFifo *b;
+  char            buf[TEST_CACHE_SIZE];
+  /* a stale pool entry shows up as a size above the buffer, inline ones copy whole cells */
+  size_t          small = (flags & SHMFIFO_FLAG_INLINE) ? sizeof(buf) : sizeof(uint64_t);
+  ssize_t         ret;
+
+  unlink(fifo_name.c_str());
+  prod = CacheOpen(fifo_name, flags);
+  a = CacheOpen(fifo_name, flags);
+  b = CacheOpen(fifo_name, flags);
+  TEST_CHECK(prod && a && b);
+
+  /* leave full size entries all over the ring for a stale peek to find */
+  for (int i = 0; i < TEST_CACHE_COUNT * 4; ++i) {
+    TEST_CHECK(CachePush(prod, i, TEST_CACHE_SIZE) == TEST_CACHE_SIZE);
+    TEST_CHECK(ShmFifoPopData(b, buf, sizeof(buf)) == TEST_CACHE_SIZE);
+  }
+
+  TEST_CHECK(CachePush(prod, 0, TEST_CACHE_SIZE) == TEST_CACHE_SIZE);
+  TEST_CHECK(CachePush(prod, 1, TEST_CACHE_SIZE) == TEST_CACHE_SIZE);
+  TEST_CHECK(ShmFifoPopData(a, buf, sizeof(buf)) == TEST_CACHE_SIZE && CacheSeq(buf) == 0);
+  TEST_CHECK(ShmFifoPopData(b, buf, sizeof(buf)) == TEST_CACHE_SIZE && CacheSeq(buf) == 1);
+  TEST_CHECK(CachePush(prod, 2, TEST_CACHE_SIZE) == TEST_CACHE_SIZE);
+  TEST_CHECK(CachePush(prod, 3, TEST_CACHE_SIZE) == TEST_CACHE_SIZE);
+  TEST_CHECK(ShmFifoPopData(b, buf, sizeof(buf)) == TEST_CACHE_SIZE && CacheSeq(buf) == 2);
+  TEST_CHECK(ShmFifoPopData(b, buf, sizeof(buf)) == TEST_CACHE_SIZE && CacheSeq(buf) == 3);
+
+  /* a still caches a tail of 2, behind the head of 4 */
+  ret = ShmFifoPopData(a, buf, small);
+  TEST_CHECK(ret == -SHMFIFO_ERR_EMPTY);
+  TEST_CHECK(CachePush(prod, 4, sizeof(uint64_t)) == sizeof(uint64_t));
+  ret = ShmFifoPopData(a, buf, small);
+  TEST_CHECK(ret == sizeof(uint64_t) && CacheSeq(buf) == 4);
+  TEST_CHECK(ShmFifoPopData(b, buf, sizeof(buf)) == -SHMFIFO_ERR_EMPTY);
+
+  ShmFifoClose(b);
+  ShmFifoClose(a);
+  ShmFifoClose(prod);
+  unlink(fifo_name.c_str());
+  SHMFIFO_DEBUG_OUT("flags %x, multi consumer peek ok", flags);
+  return SHMFIFO_ERR_NO;
+}
+
+int TestCache(std::string fifo_name)
+{
+  static const uint32_t single[] = {
+    SHMFIFO_SYNC_SPSC,
+    SHMFIFO_SYNC_MPSC,
+    SHMFIFO_FLAG_DIRECT,
+    SHMFIFO_FLAG_INLINE,
+    SHMFIFO_FLAG_INLINE | SHMFIFO_SYNC_MPSC,
+  };
+  static const uint32_t multi[] = {
+    SHMFIFO_SYNC_SPMC,
+    SHMFIFO_SYNC_MPMC,
+    SHMFIFO_SYNC_SPMC | SHMFIFO_FLAG_RTS,
+    SHMFIFO_FLAG_INLINE | SHMFIFO_SYNC_SPMC,
+    SHMFIFO_FLAG_INLINE | SHMFIFO_SYNC_MPMC | SHMFIFO_FLAG_RTS,
+  };
+  int ret;
+
+  for (size_t i = 0; i < sizeof(single) / sizeof(single[0]); ++i) {
+    ret = CacheRefresh(fifo_name, single[i]);
+    if (ret != SHMFIFO_ERR_NO) {
+      return ret;
+    }
+  }
+  for (size_t i = 0; i < sizeof(multi) / sizeof(multi[0]); ++i) {
+    ret = CacheMultiConsumer(fifo_name, multi[i]);
+    if (ret != SHMFIFO_ERR_NO) {
+      return ret;
+    }
+  }
+  return SHMFIFO_ERR_NO;
+}
@@ -0,0 +1,5 @@
+#ifndef TEST_CACHE_H_
+#define TEST_CACHE_H_
+#include <string>
+int TestCache(std::string fifo_name);
+#endif
@@ -0,0 +1,14 @@
+#ifndef TEST_CHECK_H_
+#define TEST_CHECK_H_
+#include "shmfifo_log.h"
+
+#define TEST_FAIL (-1)
+
+#define TEST_CHECK(cond_) do { \
+  if (!(cond_)) { \
+    SHMFIFO_ERR_OUT("check failed: %s", #cond_); \
+    return TEST_FAIL; \
+  } \
+} while (0)
+
+#endif
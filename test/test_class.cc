@@ -0,0 +1,189 @@
+#include <string>
+#include <string.h>
+
+#include "shmfifo.h"
+#include "shmfifo_error.h"
+#include "shmfifo_log.h"
+#include "test_check.h"
+
+#define TEST_CLASS_SIZE   (4096)
+#define TEST_CLASS_COUNT  (8)
+#define TEST_CLASS_SMALL  (64)
+#define TEST_CLASS_SMALLS (16)
+#define TEST_CLASS_MID    (512)
+#define TEST_CLASS_MIDS   (8)
+
+static void ClassAttr(struct ShmFifoAttr *attr, uint32_t flags)
+{
+  ShmFifoAttrInit(attr);
+  attr->flags = flags;
+  attr->class_size[0] = TEST_CLASS_SMALL;
+  attr->class_count[0] = TEST_CLASS_SMALLS;
+  attr->class_size[1] = TEST_CLASS_MID;
+  attr->class_count[1] = TEST_CLASS_MIDS;
+}
+
+static ssize_t ClassPush(struct ShmFifo *fifo, uint32_t seq, size_t size)
+{
+  char buf[TEST_CLASS_SIZE];
+
+  memset(buf, (char)seq, size);
+  memcpy(buf, &seq, sizeof(seq));
+  return ShmFifoPush(fifo, buf, size);
+}
+
+static int ClassPop(struct ShmFifo *fifo, uint32_t seq, size_t size, char **addr)
+{
+  char   *data;
+  size_t  got;
+
+  data = (char *)ShmFifoTop(fifo, &got);
+  TEST_CHECK(data && got == size);
+  TEST_CHECK(memcmp(data, &seq, size < sizeof(seq) ? size : sizeof(seq)) == 0);
+  TEST_CHECK(size <= sizeof(seq) || data[size - 1] == (char)seq);
+  if (addr) {
+    *addr = data;
+  }
+  TEST_CHECK(ShmFifoPop(fifo) == SHMFIFO_ERR_NO);
+  return SHMFIFO_ERR_NO;
+}
+
+/* the slots of a class are packed together, whatever order its pool hands them out */
+static int ClassSpan(char * const *addr, uint32_t n, size_t size, char **low, char **high)
+{
+  *low = addr[0];
+  *high = addr[0];
+  for (uint32_t i = 1; i < n; ++i) {
+    *low = (addr[i] < *low) ? addr[i] : *low;
+    *high = (addr[i] > *high) ? addr[i] : *high;
+  }
+  TEST_CHECK((size_t)(*high - *low) == size * (n - 1));
+  return SHMFIFO_ERR_NO;
+}
+
+/* small messages fill their own class first, then spill into larger ones */
+static int ClassFill(struct ShmFifo *fifo, size_t size, uint32_t *filled)
+{
+  char     *addr[TEST_CLASS_SMALLS + TEST_CLASS_MIDS];
+  char     *small_low;
+  char     *small_high;
+  char     *mid_low;
+  char     *mid_high;
+  uint32_t  n = 0;
+
+  while (ClassPush(fifo, n, size) == (ssize_t)size) {
+    ++n;
+  }
+  TEST_CHECK(n > TEST_CLASS_SMALLS + TEST_CLASS_MIDS);
+  for (uint32_t i = 0; i < n; ++i) {
+    TEST_CHECK(ClassPop(fifo, i, size,
+      (i < TEST_CLASS_SMALLS + TEST_CLASS_MIDS) ? &addr[i] : NULL) == SHMFIFO_ERR_NO);
+  }
+  TEST_CHECK(ClassSpan(addr, TEST_CLASS_SMALLS, TEST_CLASS_SMALL,
+    &small_low, &small_high) == SHMFIFO_ERR_NO);
+  TEST_CHECK(ClassSpan(addr + TEST_CLASS_SMALLS, TEST_CLASS_MIDS, TEST_CLASS_MID,
+    &mid_low, &mid_high) == SHMFIFO_ERR_NO);
+  TEST_CHECK(small_high < mid_low);
+  *filled = n;
+  return SHMFIFO_ERR_NO;
+}
+
+static int ClassRun(const std::string &fifo_name, uint32_t flags)
+{
+  static const size_t sizes[] = {1, 40, TEST_CLASS_SMALL, 65, 300, TEST_CLASS_MID, 513,
+    TEST_CLASS_SIZE};
+  struct ShmFifoAttr attr;
+  struct ShmFifo    *fifo;
+  uint32_t           filled;
+  uint32_t           refilled;
+  uint32_t           seq = 0;
+  void              *slot;
+
+  unlink(fifo_name.c_str());
+  ClassAttr(&attr, flags);
+  fifo = ShmFifoOpenAttr(fifo_name.c_str(), TEST_CLASS_SIZE, TEST_CLASS_COUNT, &attr);
+  TEST_CHECK(fifo != NULL);
+
+  TEST_CHECK(ClassFill(fifo, sizeof(seq), &filled) == SHMFIFO_ERR_NO);
+
+  /* every size class in turn, each slot has to come back to its own pool */
+  for (int round = 0; round < 1000; ++round) {
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+      TEST_CHECK(ClassPush(fifo, seq, sizes[i]) == (ssize_t)sizes[i]);
+      TEST_CHECK(ClassPop(fifo, seq, sizes[i], NULL) == SHMFIFO_ERR_NO);
+      ++seq;
+    }
+    slot = ShmFifoReserve(fifo, sizes[round % (sizeof(sizes) / sizeof(sizes[0]))]);
+    TEST_CHECK(slot && ShmFifoAbort(fifo, slot) == SHMFIFO_ERR_NO);
+  }
+  TEST_CHECK(ClassFill(fifo, sizeof(seq), &refilled) == SHMFIFO_ERR_NO);
+  TEST_CHECK(refilled == filled);
+
+  /* a message only goes to a class it fits in */
+  while (ClassPush(fifo, seq, TEST_CLASS_SIZE) == TEST_CLASS_SIZE) {
+    ++seq;
+  }
+  TEST_CHECK(ClassPush(fifo, seq, TEST_CLASS_SMALL) == TEST_CLASS_SMALL);
+
+  ShmFifoClose(fifo);
+  unlink(fifo_name.c_str());
+  SHMFIFO_DEBUG_OUT("flags %x, %u slots across classes ok", flags, filled);
+  return SHMFIFO_ERR_NO;
+}
+
+/* classes are part of the layout, a mismatch or a mode without a pool is refused */
+static int ClassAttrCheck(const std::string &fifo_name)
+{
+  struct ShmFifoAttr attr;
+  struct ShmFifo    *fifo;
+
+  unlink(fifo_name.c_str());
+  ClassAttr(&attr, 0);
+  fifo = ShmFifoOpenAttr(fifo_name.c_str(), TEST_CLASS_SIZE, TEST_CLASS_COUNT, &attr);
+  TEST_CHECK(fifo != NULL);
+  /* same file size, so only the class table tells the layouts apart */
+  attr.class_size[0] = TEST_CLASS_SMALL * 2;
+  attr.class_size[1] = TEST_CLASS_MID - TEST_CLASS_SMALL * 2;
+  TEST_CHECK(ShmFifoOpenAttr(fifo_name.c_str(), TEST_CLASS_SIZE, TEST_CLASS_COUNT, &attr) == NULL);
+  ShmFifoClose(fifo);
+  unlink(fifo_name.c_str());
+
+  ClassAttr(&attr, 0);
+  attr.class_size[1] = TEST_CLASS_SMALL;
+  TEST_CHECK(ShmFifoOpenAttr(fifo_name.c_str(), TEST_CLASS_SIZE, TEST_CLASS_COUNT, &attr) == NULL);
+  ClassAttr(&attr, 0);
+  attr.class_size[1] = TEST_CLASS_SIZE;
+  TEST_CHECK(ShmFifoOpenAttr(fifo_name.c_str(), TEST_CLASS_SIZE, TEST_CLASS_COUNT, &attr) == NULL);
+  ClassAttr(&attr, SHMFIFO_FLAG_DIRECT);
+  TEST_CHECK(ShmFifoOpenAttr(fifo_name.c_str(), TEST_CLASS_SIZE, TEST_CLASS_COUNT, &attr) == NULL);
+  ClassAttr(&attr, SHMFIFO_FLAG_VARLEN);
+  TEST_CHECK(ShmFifoOpenAttr(fifo_name.c_str(), TEST_CLASS_SIZE, TEST_CLASS_COUNT, &attr) == NULL);
+  ClassAttr(&attr, SHMFIFO_FLAG_INLINE);
+  TEST_CHECK(ShmFifoOpenAttr(fifo_name.c_str(), TEST_CLASS_SMALL / 2, TEST_CLASS_COUNT, &attr) == NULL);
+  unlink(fifo_name.c_str());
+  return SHMFIFO_ERR_NO;
+}
+
+int TestClass(std::string fifo_name)
+{
+  static const uint32_t modes[] = {
+    SHMFIFO_SYNC_SPSC,
+    SHMFIFO_SYNC_MPSC,
+    SHMFIFO_SYNC_MPSC | SHMFIFO_FLAG_RTS,
+  };
+  int ret;
+
+  ret = ClassAttrCheck(fifo_name);
+  if (ret != SHMFIFO_ERR_NO) {
+    SHMFIFO_ERR_OUT("size class attr check failed");
+    return ret;
+  }
+  for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i) {
+    ret = ClassRun(fifo_name, modes[i]);
+    if (ret != SHMFIFO_ERR_NO) {
+      SHMFIFO_ERR_OUT("size class flags %x failed", modes[i]);
+      return ret;
+    }
+  }
+  return SHMFIFO_ERR_NO;
+}
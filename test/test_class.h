@@ -0,0 +1,5 @@
+#ifndef TEST_CLASS_H_
+#define TEST_CLASS_H_
+#include <string>
+int TestClass(std::string fifo_name);
+#endif
@@ -0,0 +1,340 @@
+#include <string>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <vector>
+
+#include "shmfifo.h"
+#include "shmfifo_error.h"
+#include "shmfifo_log.h"
+#include "test_check.h"
+
+#define TEST_INLINE_SIZE    (60)
+#define TEST_INLINE_COUNT   (64)
+#define TEST_INLINE_BURST   (8)
+#define TEST_INLINE_THREADS (2)
+
+/* producer id and sequence up front, the rest filled with a byte both sides can derive */
+struct TestInlineHdr {
+  uint32_t id;
+  uint32_t seq;
+};
+
+struct TestInlineCtx {
+  std::string          fifo_name;
+  struct ShmFifoAttr   attr;
+  int                  producers;
+  int                  n;
+  int                  total;
+  int                  popped;
+  int                  errors;
+  std::vector<int>     seen;
+};
+
+/* plain multi thread sides only get company with a cpu each, as in test_stress */
+static int InlineThreads(uint32_t flags, uint32_t side)
+{
+  if (!(flags & side)) {
+    return 1;
+  }
+  if ((flags & SHMFIFO_FLAG_RTS) || sysconf(_SC_NPROCESSORS_ONLN) >= TEST_INLINE_THREADS * 2) {
+    return TEST_INLINE_THREADS;
+  }
+  return 1;
+}
+
+static size_t InlineLen(uint32_t seq)
+{
+  return sizeof(struct TestInlineHdr) + seq % (TEST_INLINE_SIZE - sizeof(struct TestInlineHdr) + 1);
+}
+
+static void InlineFill(char *buf, size_t size, uint8_t fill)
+{
+  for (size_t i = 0; i < size; ++i) {
+    buf[i] = (char)(fill + i);
+  }
+}
+
+static int InlineCheck(const char *buf, size_t size, uint8_t fill)
+{
+  for (size_t i = 0; i < size; ++i) {
+    TEST_CHECK(buf[i] == (char)(fill + i));
+  }
+  return SHMFIFO_ERR_NO;
+}
+
+/* every size 0..msg_size through each push and pop flavour of one handle */
+static int InlineSizes(const std::string &fifo_name, uint32_t flags)
+{
+  struct ShmFifoAttr attr;
+  struct ShmFifo    *fifo;
+  char               bufs[TEST_INLINE_BURST][TEST_INLINE_SIZE];
+  char               out[TEST_INLINE_SIZE];
+  struct iovec       iov[TEST_INLINE_BURST];
+  char              *slot;
+  size_t             size;
+  size_t             got;
+
+  unlink(fifo_name.c_str());
+  ShmFifoAttrInit(&attr);
+  attr.flags = flags;
+  fifo = ShmFifoOpenAttr(fifo_name.c_str(), TEST_INLINE_SIZE, TEST_INLINE_COUNT, &attr);
+  TEST_CHECK(fifo != NULL);
+
+  for (size = 0; size <= TEST_INLINE_SIZE; ++size) {
+    InlineFill(bufs[0], size, (uint8_t)size);
+    TEST_CHECK(ShmFifoPush(fifo, bufs[0], size) == (ssize_t)size);
+    slot = (char *)ShmFifoTop(fifo, &got);
+    TEST_CHECK(slot && got == size && InlineCheck(slot, size, (uint8_t)size) == SHMFIFO_ERR_NO);
+    TEST_CHECK(ShmFifoPopData(fifo, out, sizeof(out)) == (ssize_t)size);
+    TEST_CHECK(InlineCheck(out, size, (uint8_t)size) == SHMFIFO_ERR_NO);
+
+    /* bulk and burst take the same sizes, a burst of cells per call */
+    for (int i = 0; i < TEST_INLINE_BURST; ++i) {
+      InlineFill(bufs[i], size, (uint8_t)(size + i));
+      iov[i].iov_base = bufs[i];
+      iov[i].iov_len = size;
+    }
+    TEST_CHECK(ShmFifoPushBulk(fifo, iov, TEST_INLINE_BURST) == TEST_INLINE_BURST);
+    TEST_CHECK(ShmFifoPushBurst(fifo, iov, TEST_INLINE_BURST) == TEST_INLINE_BURST);
+    for (int round = 0; round < 2; ++round) {
+      memset(iov, 0, sizeof(iov));
+      TEST_CHECK(ShmFifoTopBurst(fifo, iov, TEST_INLINE_BURST) == TEST_INLINE_BURST);
+      for (int i = 0; i < TEST_INLINE_BURST; ++i) {
+        TEST_CHECK(iov[i].iov_len == size);
+        TEST_CHECK(InlineCheck((char *)iov[i].iov_base, size, (uint8_t)(size + i)) ==
+          SHMFIFO_ERR_NO);
+      }
+      TEST_CHECK(ShmFifoPopBulk(fifo, TEST_INLINE_BURST) == SHMFIFO_ERR_NO);
+    }
+
+    /* reserve builds the cell in the handle, abort leaves nothing behind */
+    if (size) {
+      slot = (char *)ShmFifoReserve(fifo, size);
+      TEST_CHECK(slot != NULL);
+      TEST_CHECK(ShmFifoAbort(fifo, slot) == SHMFIFO_ERR_NO);
+      if (size == TEST_INLINE_SIZE) {
+        TEST_CHECK(ShmFifoCommit(fifo, slot, size) == -SHMFIFO_ERR_COMMIT_ADDR);
+      }
+      slot = (char *)ShmFifoReserve(fifo, size);
+      TEST_CHECK(slot != NULL);
+      if (size == 1) {
+        TEST_CHECK(ShmFifoCommit(fifo, slot, size + 1) == -SHMFIFO_ERR_COMMIT_SIZE);
+      }
+      InlineFill(slot, size, (uint8_t)~size);
+      TEST_CHECK(ShmFifoCommit(fifo, slot, size) == (ssize_t)size);
+      TEST_CHECK(ShmFifoPopData(fifo, out, sizeof(out)) == (ssize_t)size);
+      TEST_CHECK(InlineCheck(out, size, (uint8_t)~size) == SHMFIFO_ERR_NO);
+    }
+    TEST_CHECK(ShmFifoPopData(fifo, out, sizeof(out)) == -SHMFIFO_ERR_EMPTY);
+  }
+
+  /* longer messages are cut at msg_size, a short pop buffer is refused */
+  TEST_CHECK(ShmFifoPush(fifo, bufs[0], sizeof(bufs)) == TEST_INLINE_SIZE);
+  TEST_CHECK(ShmFifoPopData(fifo, out, TEST_INLINE_SIZE - 1) == -SHMFIFO_ERR_POP_DATA_BUF_SIZE);
+  TEST_CHECK(ShmFifoPopData(fifo, out, sizeof(out)) == TEST_INLINE_SIZE);
+
+  /* a single consumer only needs room for the message itself */
+  TEST_CHECK(ShmFifoPush(fifo, bufs[0], 1) == 1);
+  if (flags & SHMFIFO_FLAG_MC) {
+    TEST_CHECK(ShmFifoPopData(fifo, out, 1) == -SHMFIFO_ERR_POP_DATA_BUF_SIZE);
+    TEST_CHECK(ShmFifoPopData(fifo, out, sizeof(out)) == 1);
+  } else {
+    TEST_CHECK(ShmFifoPopData(fifo, out, 0) == -SHMFIFO_ERR_POP_DATA_BUF_SIZE);
+    TEST_CHECK(ShmFifoPopData(fifo, out, 1) == 1 && out[0] == bufs[0][0]);
+  }
+
+  ShmFifoClose(fifo);
+  unlink(fifo_name.c_str());
+
+  /* a message has to fit one cell */
+  TEST_CHECK(ShmFifoOpenAttr(fifo_name.c_str(), TEST_INLINE_SIZE + 1, TEST_INLINE_COUNT,
+    &attr) == NULL);
+  unlink(fifo_name.c_str());
+  return SHMFIFO_ERR_NO;
+}
+
+static void *InlinePush(void *arg)
+{
+  struct TestInlineCtx *ctx = (struct TestInlineCtx *)((void **)arg)[0];
+  uint32_t              id = (uint32_t)(uintptr_t)((void **)arg)[1];
+  struct ShmFifo       *fifo;
+  char                  bufs[TEST_INLINE_BURST][TEST_INLINE_SIZE];
+  struct iovec          iov[TEST_INLINE_BURST];
+  struct TestInlineHdr  hdr;
+  uint32_t              seq = 0;
+  uint32_t              n;
+  ssize_t               ret;
+
+  fifo = ShmFifoOpenAttr(ctx->fifo_name.c_str(), TEST_INLINE_SIZE, TEST_INLINE_COUNT,
+    &ctx->attr);
+  if (!fifo) {
+    __atomic_add_fetch(&ctx->errors, 1, __ATOMIC_RELAXED);
+    return NULL;
+  }
+  while (seq < (uint32_t)ctx->n && !__atomic_load_n(&ctx->errors, __ATOMIC_RELAXED)) {
+    n = 1 + seq % TEST_INLINE_BURST;
+    n = (n < (uint32_t)ctx->n - seq) ? n : (uint32_t)ctx->n - seq;
+    for (uint32_t i = 0; i < n; ++i) {
+      hdr.id = id;
+      hdr.seq = seq + i;
+      iov[i].iov_base = bufs[i];
+      iov[i].iov_len = InlineLen(hdr.seq);
+      InlineFill(bufs[i], iov[i].iov_len, (uint8_t)hdr.seq);
+      memcpy(bufs[i], &hdr, sizeof(hdr));
+    }
+    ret = ShmFifoPushBurst(fifo, iov, n);
+    if (ret < 0) {
+      SHMFIFO_ERR_OUT("ShmFifoPushBurst err %ld", ret);
+      __atomic_add_fetch(&ctx->errors, 1, __ATOMIC_RELAXED);
+      break;
+    }
+    if (!ret) {
+      sched_yield();
+    }
+    seq += (uint32_t)ret;
+  }
+  ShmFifoClose(fifo);
+  return NULL;
+}
+
+static int InlineSeen(struct TestInlineCtx *ctx, const char *buf, size_t size)
+{
+  struct TestInlineHdr hdr;
+
+  TEST_CHECK(size >= sizeof(hdr));
+  memcpy(&hdr, buf, sizeof(hdr));
+  TEST_CHECK(hdr.id < (uint32_t)ctx->producers && hdr.seq < (uint32_t)ctx->n);
+  TEST_CHECK(size == InlineLen(hdr.seq));
+  TEST_CHECK(InlineCheck(buf + sizeof(hdr), size - sizeof(hdr),
+    (uint8_t)(hdr.seq + sizeof(hdr))) == SHMFIFO_ERR_NO);
+  __atomic_add_fetch(&ctx->seen[hdr.id * ctx->n + hdr.seq], 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&ctx->popped, 1, __ATOMIC_RELAXED);
+  return SHMFIFO_ERR_NO;
+}
+
+/* a single consumer reads the cells in place, several copy them out */
+static void *InlinePop(void *arg)
+{
+  struct TestInlineCtx *ctx = (struct TestInlineCtx *)arg;
+  struct ShmFifo       *fifo;
+  char                  buf[TEST_INLINE_SIZE];
+  struct iovec          iov[TEST_INLINE_BURST];
+  ssize_t               ret;
+
+  fifo = ShmFifoOpenAttr(ctx->fifo_name.c_str(), TEST_INLINE_SIZE, TEST_INLINE_COUNT,
+    &ctx->attr);
+  if (!fifo) {
+    __atomic_add_fetch(&ctx->errors, 1, __ATOMIC_RELAXED);
+    return NULL;
+  }
+  while (__atomic_load_n(&ctx->popped, __ATOMIC_RELAXED) < ctx->total &&
+         !__atomic_load_n(&ctx->errors, __ATOMIC_RELAXED)) {
+    if (ctx->attr.flags & SHMFIFO_FLAG_MC) {
+      ret = ShmFifoPopData(fifo, buf, sizeof(buf));
+      if (ret == -SHMFIFO_ERR_EMPTY) {
+        sched_yield();
+        continue;
+      }
+      if (ret < 0 || InlineSeen(ctx, buf, (size_t)ret) != SHMFIFO_ERR_NO) {
+        __atomic_add_fetch(&ctx->errors, 1, __ATOMIC_RELAXED);
+      }
+      continue;
+    }
+    ret = ShmFifoTopBurst(fifo, iov, TEST_INLINE_BURST);
+    if (ret <= 0) {
+      sched_yield();
+      continue;
+    }
+    for (ssize_t i = 0; i < ret; ++i) {
+      if (InlineSeen(ctx, (char *)iov[i].iov_base, iov[i].iov_len) != SHMFIFO_ERR_NO) {
+        __atomic_add_fetch(&ctx->errors, 1, __ATOMIC_RELAXED);
+      }
+    }
+    if (ShmFifoPopBulk(fifo, (unsigned int)ret) != SHMFIFO_ERR_NO) {
+      __atomic_add_fetch(&ctx->errors, 1, __ATOMIC_RELAXED);
+    }
+  }
+  ShmFifoClose(fifo);
+  return NULL;
+}
+
+static int InlineRun(const std::string &fifo_name, uint32_t flags, int n)
+{
+  struct TestInlineCtx ctx;
+  struct ShmFifo      *fifo;
+  pthread_t            tids[TEST_INLINE_THREADS * 2];
+  void                *args[TEST_INLINE_THREADS][2];
+  int                  consumers = InlineThreads(flags, SHMFIFO_FLAG_MC);
+  int                  threads = 0;
+
+  unlink(fifo_name.c_str());
+  ctx.fifo_name = fifo_name;
+  ShmFifoAttrInit(&ctx.attr);
+  ctx.attr.flags = flags;
+  ctx.producers = InlineThreads(flags, SHMFIFO_FLAG_MP);
+  ctx.n = n;
+  ctx.total = ctx.producers * n;
+  ctx.popped = 0;
+  ctx.errors = 0;
+  ctx.seen.assign(ctx.total, 0);
+
+  fifo = ShmFifoOpenAttr(fifo_name.c_str(), TEST_INLINE_SIZE, TEST_INLINE_COUNT, &ctx.attr);
+  TEST_CHECK(fifo != NULL);
+  for (int i = 0; i < consumers; ++i, ++threads) {
+    TEST_CHECK(pthread_create(&tids[threads], NULL, InlinePop, &ctx) == 0);
+  }
+  for (int i = 0; i < ctx.producers; ++i, ++threads) {
+    args[i][0] = &ctx;
+    args[i][1] = (void *)(uintptr_t)i;
+    TEST_CHECK(pthread_create(&tids[threads], NULL, InlinePush, args[i]) == 0);
+  }
+  for (int i = 0; i < threads; ++i) {
+    pthread_join(tids[i], NULL);
+  }
+  ShmFifoClose(fifo);
+  unlink(fifo_name.c_str());
+
+  TEST_CHECK(ctx.errors == 0);
+  TEST_CHECK(ctx.popped == ctx.total);
+  for (int i = 0; i < ctx.total; ++i) {
+    if (ctx.seen[i] != 1) {
+      SHMFIFO_ERR_OUT("flags %x, producer %d seq %d popped %d times", flags, i / n, i % n,
+        ctx.seen[i]);
+      return TEST_FAIL;
+    }
+  }
+  SHMFIFO_DEBUG_OUT("flags %x, %d producers %d consumers, %d msgs ok", flags, ctx.producers,
+    consumers, ctx.total);
+  return SHMFIFO_ERR_NO;
+}
+
+int TestInline(std::string fifo_name, int n)
+{
+  static const uint32_t modes[] = {
+    SHMFIFO_FLAG_INLINE,
+    SHMFIFO_FLAG_INLINE | SHMFIFO_SYNC_MPSC,
+    SHMFIFO_FLAG_INLINE | SHMFIFO_SYNC_MPMC,
+    SHMFIFO_FLAG_INLINE | SHMFIFO_SYNC_MPMC | SHMFIFO_FLAG_RTS,
+  };
+  int ret;
+
+  for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i) {
+    ret = InlineSizes(fifo_name, modes[i]);
+    if (ret != SHMFIFO_ERR_NO) {
+      SHMFIFO_ERR_OUT("inline sizes flags %x failed", modes[i]);
+      return ret;
+    }
+    if (!(modes[i] & SHMFIFO_FLAG_MP)) {
+      continue;
+    }
+    ret = InlineRun(fifo_name, modes[i], n);
+    if (ret != SHMFIFO_ERR_NO) {
+      SHMFIFO_ERR_OUT("inline burst flags %x failed", modes[i]);
+      return ret;
+    }
+  }
+  return SHMFIFO_ERR_NO;
+}
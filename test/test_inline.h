@@ -0,0 +1,5 @@
+#ifndef TEST_INLINE_H_
+#define TEST_INLINE_H_
+#include <string>
+int TestInline(std::string fifo_name, int n);
+#endif
@@ -3,6 +3,15 @@
 
 #include "test_pop.h"
 #include "test_push.h"
+#include "test_stress.h"
+#include "test_cache.h"
+#include "test_wait.h"
+#include "test_broadcast.h"
+#include "test_varlen.h"
+#include "test_mirror.h"
+#include "test_class.h"
+#include "test_obj.h"
+#include "test_inline.h"
 
 int main(int argc, char *argv[])
 {
@@ -14,5 +23,41 @@ int main(int argc, char *argv[])
   if (prog == "test_push") {
     return TestPush(argv[1], atoi(argv[2]));
   }
+
+  if (prog == "test_stress") {
+    return TestStress(argv[1], atoi(argv[2]));
+  }
+
+  if (prog == "test_cache") {
+    return TestCache(argv[1]);
+  }
+
+  if (prog == "test_wait") {
+    return TestWait(argv[1]);
+  }
+
+  if (prog == "test_broadcast") {
+    return TestBroadcast(argv[1]);
+  }
+
+  if (prog == "test_varlen") {
+    return TestVarlen(argv[1], atoi(argv[2]));
+  }
+
+  if (prog == "test_mirror") {
+    return TestMirror(argv[1]);
+  }
+
+  if (prog == "test_class") {
+    return TestClass(argv[1]);
+  }
+
+  if (prog == "test_obj") {
+    return TestObj(argv[1]);
+  }
+
+  if (prog == "test_inline") {
+    return TestInline(argv[1], atoi(argv[2]));
+  }
   return 0;
 }
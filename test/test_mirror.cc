@@ -0,0 +1,186 @@
+#include <string>
+#include <string.h>
+
+#include "shmfifo.h"
+#include "shmfifo_byte_ring.h"
+#include "shmfifo_error.h"
+#include "shmfifo_log.h"
+#include "test_check.h"
+
+#define TEST_MIRROR_SLOT   (64)
+/* slot mapped messages sit msg_size rounded up to 1024 apart */
+#define TEST_MIRROR_STRIDE (1024)
+#define TEST_MIRROR_COUNT  (64)
+#define TEST_MIRROR_RECORD (200)
+#define TEST_MIRROR_BURST  (4)
+/* enough single steps to walk every start position past the end a few times */
+#define TEST_MIRROR_STEPS  (TEST_MIRROR_COUNT * 4)
+
+struct TestMirrorCtx {
+  struct ShmFifo *prod;
+  struct ShmFifo *cons;
+  uint32_t        flags;
+  size_t          msg_size;
+  uint32_t        seq;
+  uint32_t        rnd;
+  int             truncated;
+};
+
+static void MirrorFill(char *data, uint32_t seq, size_t size)
+{
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = (char)(seq * 13 + i);
+  }
+}
+
+static int MirrorMatch(const char *data, uint32_t seq, size_t size)
+{
+  char expect[TEST_MIRROR_RECORD];
+
+  MirrorFill(expect, seq, size);
+  if (memcmp(data, expect, size)) {
+    SHMFIFO_ERR_OUT("seq %u, %lu bytes mismatch", seq, size);
+    return TEST_FAIL;
+  }
+  return SHMFIFO_ERR_NO;
+}
+
+static size_t MirrorSize(struct TestMirrorCtx *ctx, uint32_t seq)
+{
+  if (!(ctx->flags & SHMFIFO_FLAG_VARLEN)) {
+    return ctx->msg_size - seq % 8;
+  }
+  return (seq * 2654435761U >> 16) % ctx->msg_size + 1;
+}
+
+static int MirrorPush(struct TestMirrorCtx *ctx, uint32_t seq)
+{
+  char   buf[TEST_MIRROR_RECORD];
+  size_t size = MirrorSize(ctx, seq);
+
+  MirrorFill(buf, seq, size);
+  TEST_CHECK(ShmFifoPush(ctx->prod, buf, size) == (ssize_t)size);
+  return SHMFIFO_ERR_NO;
+}
+
+/* walks the records of a span, which holds no PAD filler when mirrored */
+static int MirrorCheckSpan(struct TestMirrorCtx *ctx, const struct iovec *span, ssize_t n)
+{
+  const char                  *p = (const char *)span->iov_base;
+  const struct ShmFifoByteHdr *hdr;
+  size_t                       align = (ctx->flags & SHMFIFO_FLAG_ALIGN64) ? 64 : 8;
+  size_t                       size;
+
+  for (ssize_t i = 0; i < n; ++i) {
+    size = MirrorSize(ctx, ctx->seq + i);
+    if (ctx->flags & SHMFIFO_FLAG_VARLEN) {
+      hdr = (const struct ShmFifoByteHdr *)p;
+      TEST_CHECK(hdr->flags == 0 && hdr->len == size);
+      TEST_CHECK(MirrorMatch(p + SHMFIFO_BYTE_HDR_SIZE, ctx->seq + i, size) == SHMFIFO_ERR_NO);
+      p += SHMFIFO_SIZE_ALIGN(SHMFIFO_BYTE_HDR_SIZE + size, align);
+    } else {
+      TEST_CHECK(MirrorMatch(p, ctx->seq + i, size) == SHMFIFO_ERR_NO);
+      p += (i + 1 < n) ? TEST_MIRROR_STRIDE : size;
+    }
+  }
+  TEST_CHECK(p == (const char *)span->iov_base + span->iov_len);
+  return SHMFIFO_ERR_NO;
+}
+
+/*
+ * moves the start one message at a time and reads a burst as one span from
+ * every position, a mirrored span never stops at the end of the data region
+ */
+static int MirrorWalk(struct TestMirrorCtx *ctx)
+{
+  struct iovec span;
+  ssize_t      n;
+
+  for (int step = 0; step < TEST_MIRROR_STEPS; ++step) {
+    for (uint32_t i = 0; i < TEST_MIRROR_BURST; ++i) {
+      TEST_CHECK(MirrorPush(ctx, ctx->seq + i) == SHMFIFO_ERR_NO);
+    }
+    n = ShmFifoTopSpan(ctx->cons, &span, TEST_MIRROR_BURST);
+    TEST_CHECK(n > 0 && n <= TEST_MIRROR_BURST);
+    if (n < TEST_MIRROR_BURST) {
+      TEST_CHECK(!(ctx->flags & SHMFIFO_FLAG_MIRROR));
+      ctx->truncated = 1;
+    }
+    TEST_CHECK(MirrorCheckSpan(ctx, &span, n) == SHMFIFO_ERR_NO);
+    /* leave the start one message further on than the last step */
+    TEST_CHECK(ShmFifoPopBulk(ctx->cons, TEST_MIRROR_BURST) == SHMFIFO_ERR_NO);
+    ctx->seq += TEST_MIRROR_BURST;
+    TEST_CHECK(MirrorPush(ctx, ctx->seq) == SHMFIFO_ERR_NO);
+    TEST_CHECK(ShmFifoPopBulk(ctx->cons, 1) == SHMFIFO_ERR_NO);
+    ++ctx->seq;
+  }
+  return SHMFIFO_ERR_NO;
+}
+
+static int MirrorRun(const std::string &fifo_name, uint32_t flags)
+{
+  struct TestMirrorCtx ctx;
+  struct ShmFifoAttr   attr;
+  size_t               msg_size;
+  int                  ret;
+
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.flags = flags;
+  msg_size = (flags & SHMFIFO_FLAG_VARLEN) ? TEST_MIRROR_RECORD : TEST_MIRROR_SLOT;
+  ctx.msg_size = msg_size;
+  ShmFifoAttrInit(&attr);
+  attr.flags = flags;
+
+  unlink(fifo_name.c_str());
+  ctx.prod = ShmFifoOpenAttr(fifo_name.c_str(), msg_size, TEST_MIRROR_COUNT, &attr);
+  TEST_CHECK(ctx.prod != NULL);
+  ctx.cons = ctx.prod;
+  if (flags & SHMFIFO_FLAG_BROADCAST) {
+    ctx.cons = ShmFifoOpenAttr(fifo_name.c_str(), msg_size, TEST_MIRROR_COUNT, &attr);
+    TEST_CHECK(ctx.cons && ShmFifoSubscribe(ctx.cons) >= 0);
+  }
+
+  ret = MirrorWalk(&ctx);
+  if (ctx.cons != ctx.prod) {
+    ShmFifoClose(ctx.cons);
+  }
+  ShmFifoClose(ctx.prod);
+  unlink(fifo_name.c_str());
+  TEST_CHECK(ret == SHMFIFO_ERR_NO);
+  /* the walk has to reach the end, or it proves nothing about the mirror */
+  TEST_CHECK((flags & SHMFIFO_FLAG_MIRROR) || ctx.truncated);
+  SHMFIFO_DEBUG_OUT("flags %x, %u messages read as spans", flags, ctx.seq);
+  return SHMFIFO_ERR_NO;
+}
+
+int TestMirror(std::string fifo_name)
+{
+  static const uint32_t modes[] = {
+    SHMFIFO_FLAG_DIRECT,
+    SHMFIFO_FLAG_DIRECT | SHMFIFO_FLAG_MIRROR,
+    SHMFIFO_FLAG_BROADCAST,
+    SHMFIFO_FLAG_BROADCAST | SHMFIFO_FLAG_MIRROR,
+    SHMFIFO_FLAG_VARLEN,
+    SHMFIFO_FLAG_VARLEN | SHMFIFO_FLAG_MIRROR,
+    SHMFIFO_FLAG_VARLEN | SHMFIFO_FLAG_ALIGN64 | SHMFIFO_FLAG_MIRROR,
+  };
+  struct ShmFifo *fifo;
+  struct iovec    span;
+  int             ret;
+
+  unlink(fifo_name.c_str());
+  fifo = ShmFifoOpen(fifo_name.c_str(), TEST_MIRROR_SLOT, TEST_MIRROR_COUNT);
+  TEST_CHECK(fifo != NULL);
+  TEST_CHECK(ShmFifoTopSpan(fifo, &span, 1) == -SHMFIFO_ERR_SPAN_FLAGS);
+  ShmFifoClose(fifo);
+
+  for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i) {
+    ret = MirrorRun(fifo_name, modes[i]);
+    if (ret != SHMFIFO_ERR_NO) {
+      SHMFIFO_ERR_OUT("mirror flags %x failed", modes[i]);
+      return ret;
+    }
+  }
+  unlink(fifo_name.c_str());
+  return SHMFIFO_ERR_NO;
+}
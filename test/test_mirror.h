@@ -0,0 +1,5 @@
+#ifndef TEST_MIRROR_H_
+#define TEST_MIRROR_H_
+#include <string>
+int TestMirror(std::string fifo_name);
+#endif
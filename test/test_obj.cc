@@ -0,0 +1,190 @@
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include "shmfifo.h"
+#include "shmfifo_error.h"
+#include "shmfifo_log.h"
+#include "shmfifo_obj_pool.h"
+#include "shmfifo_ring.h"
+#include "test_check.h"
+
+#define TEST_OBJ_RING  (32)
+#define TEST_OBJ_BULK  (20)
+#define TEST_OBJ_SIZE  (1000)
+#define TEST_OBJ_COUNT (16)
+
+static struct ShmFifoObj ObjMake(uint32_t seq)
+{
+  struct ShmFifoObj obj;
+
+  /* both fields run through their extremes so a swapped or cut half shows */
+  switch (seq % 4) {
+  case 0:
+    obj.index = 0;
+    obj.size = UINT32_MAX;
+    break;
+  case 1:
+    obj.index = UINT32_MAX;
+    obj.size = 0;
+    break;
+  default:
+    obj.index = seq * 2654435761u;
+    obj.size = ~seq;
+    break;
+  }
+  return obj;
+}
+
+/* every bulk size 1..TEST_OBJ_BULK, across the wrap, whole and partial copy blocks */
+static int ObjRing(int flags)
+{
+  struct ShmFifoRing *ring;
+  struct ShmFifoObj   in[TEST_OBJ_RING];
+  struct ShmFifoObj   out[TEST_OBJ_RING];
+  uint32_t            seq = 0;
+  unsigned int        n;
+
+  ring = (struct ShmFifoRing *)aligned_alloc(SHMFIFO_CACHE_LINE, SHMFIFO_SIZE_ALIGN(
+    sizeof(struct ShmFifoRing) + sizeof(struct ShmFifoObj) * TEST_OBJ_RING, SHMFIFO_CACHE_LINE));
+  TEST_CHECK(ring != NULL);
+  ShmFifoRingInit(ring, TEST_OBJ_RING, flags);
+
+  for (int round = 0; round < 1000; ++round) {
+    n = 1 + round % TEST_OBJ_BULK;
+    for (unsigned int i = 0; i < n; ++i) {
+      in[i] = ObjMake(seq++);
+    }
+    memset(out, 0x5a, sizeof(out));
+    if (ShmFifoRingEnqueueBulk(ring, in, n, NULL) != n ||
+        ShmFifoRingDequeueBulk(ring, out, n, NULL) != n ||
+        memcmp(in, out, sizeof(struct ShmFifoObj) * n) != 0) {
+      free(ring);
+      SHMFIFO_ERR_OUT("round %d, bulk %u mismatch", round, n);
+      return TEST_FAIL;
+    }
+  }
+
+  /* a burst is cut at the capacity and still keeps every descriptor intact */
+  for (unsigned int i = 0; i < TEST_OBJ_RING; ++i) {
+    in[i] = ObjMake(seq++);
+  }
+  n = ShmFifoRingEnqueueBurst(ring, in, TEST_OBJ_RING - 3, NULL);
+  n += ShmFifoRingEnqueueBurst(ring, in + n, TEST_OBJ_RING, NULL);
+  if (n != TEST_OBJ_RING || ShmFifoRingDequeueBurst(ring, out, TEST_OBJ_RING, NULL) != n ||
+      memcmp(in, out, sizeof(in)) != 0) {
+    free(ring);
+    SHMFIFO_ERR_OUT("burst of %u mismatch", n);
+    return TEST_FAIL;
+  }
+  free(ring);
+  return SHMFIFO_ERR_NO;
+}
+
+/* the 32 bit index addresses every 64 byte unit up to SHMFIFO_OBJ_DATA_MAX */
+static int ObjOffset(void)
+{
+  static const size_t offsets[] = {
+    0,
+    1 << SHMFIFO_OBJ_SHIFT,
+    (size_t)UINT32_MAX + 1,
+    (size_t)1 << 37,
+    SHMFIFO_OBJ_DATA_MAX,
+  };
+  struct ShmFifoObj obj;
+
+  TEST_CHECK(sizeof(struct ShmFifoObj) == 8);
+  for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); ++i) {
+    obj.index = SHMFIFO_OBJ_INDEX(offsets[i]);
+    obj.size = UINT32_MAX;
+    TEST_CHECK(SHMFIFO_OBJ_OFFSET(obj) == offsets[i]);
+  }
+  return SHMFIFO_ERR_NO;
+}
+
+/* each message size up to msg_size comes back as pushed */
+static int ObjSize(const std::string &fifo_name)
+{
+  char            buf[TEST_OBJ_SIZE];
+  struct iovec    iov[TEST_OBJ_COUNT];
+  struct ShmFifo *fifo;
+  char           *data;
+  size_t          size;
+  size_t          n;
+  ssize_t         got;
+
+  unlink(fifo_name.c_str());
+  fifo = ShmFifoOpen(fifo_name.c_str(), TEST_OBJ_SIZE, TEST_OBJ_COUNT);
+  TEST_CHECK(fifo != NULL);
+  for (size = 1; size <= TEST_OBJ_SIZE; ++size) {
+    memset(buf, (char)size, size);
+    TEST_CHECK(ShmFifoPush(fifo, buf, size) == (ssize_t)size);
+    data = (char *)ShmFifoTop(fifo, &n);
+    TEST_CHECK(data && n == size && data[size - 1] == (char)size);
+    TEST_CHECK(ShmFifoPop(fifo) == SHMFIFO_ERR_NO);
+  }
+
+  for (size = 0; size < TEST_OBJ_COUNT; ++size) {
+    iov[size].iov_base = buf;
+    iov[size].iov_len = TEST_OBJ_SIZE - size * 61;
+  }
+  TEST_CHECK(ShmFifoPushBulk(fifo, iov, TEST_OBJ_COUNT) > 0);
+  memset(iov, 0, sizeof(iov));
+  got = ShmFifoTopBurst(fifo, iov, TEST_OBJ_COUNT);
+  TEST_CHECK(got == TEST_OBJ_COUNT);
+  for (size = 0; size < TEST_OBJ_COUNT; ++size) {
+    TEST_CHECK(iov[size].iov_len == TEST_OBJ_SIZE - size * 61);
+  }
+  TEST_CHECK(ShmFifoPopBulk(fifo, TEST_OBJ_COUNT) == SHMFIFO_ERR_NO);
+
+  ShmFifoClose(fifo);
+  unlink(fifo_name.c_str());
+  return SHMFIFO_ERR_NO;
+}
+
+/* sizes are checked once aligned, nothing may wrap into the 32 bit size field */
+static int ObjRange(const std::string &fifo_name)
+{
+  struct ShmFifoAttr attr;
+
+  unlink(fifo_name.c_str());
+  TEST_CHECK(ShmFifoOpen(fifo_name.c_str(), (size_t)UINT32_MAX - 100, 1) == NULL);
+  ShmFifoAttrInit(&attr);
+  attr.class_size[0] = SIZE_MAX - 10;
+  attr.class_count[0] = 1;
+  TEST_CHECK(ShmFifoOpenAttr(fifo_name.c_str(), TEST_OBJ_SIZE, TEST_OBJ_COUNT, &attr) == NULL);
+  attr.class_size[0] = (size_t)UINT32_MAX + 1;
+  TEST_CHECK(ShmFifoOpenAttr(fifo_name.c_str(), TEST_OBJ_SIZE, TEST_OBJ_COUNT, &attr) == NULL);
+  unlink(fifo_name.c_str());
+  return SHMFIFO_ERR_NO;
+}
+
+int TestObj(std::string fifo_name)
+{
+  static const int flags[] = {
+    SHMFIFO_RING_SP_ENQ | SHMFIFO_RING_SC_DEQ,
+    0,
+    SHMFIFO_RING_MP_RTS_ENQ | SHMFIFO_RING_MC_RTS_DEQ,
+  };
+
+  for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); ++i) {
+    if (ObjRing(flags[i]) != SHMFIFO_ERR_NO) {
+      SHMFIFO_ERR_OUT("descriptor ring flags %x failed", flags[i]);
+      return TEST_FAIL;
+    }
+  }
+  if (ObjOffset() != SHMFIFO_ERR_NO) {
+    SHMFIFO_ERR_OUT("descriptor offset failed");
+    return TEST_FAIL;
+  }
+  if (ObjSize(fifo_name) != SHMFIFO_ERR_NO) {
+    SHMFIFO_ERR_OUT("descriptor size failed");
+    return TEST_FAIL;
+  }
+  if (ObjRange(fifo_name) != SHMFIFO_ERR_NO) {
+    SHMFIFO_ERR_OUT("descriptor range failed");
+    return TEST_FAIL;
+  }
+  return SHMFIFO_ERR_NO;
+}
@@ -0,0 +1,5 @@
+#ifndef TEST_OBJ_H_
+#define TEST_OBJ_H_
+#include <string>
+int TestObj(std::string fifo_name);
+#endif
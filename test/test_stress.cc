@@ -0,0 +1,196 @@
+#include <string>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <vector>
+
+#include "shmfifo.h"
+#include "shmfifo_error.h"
+#include "shmfifo_log.h"
+#include "test_check.h"
+#include "test_msg.h"
+
+#define TEST_STRESS_THREADS (3)
+#define TEST_STRESS_COUNT   (64)
+
+/* every thread opens its own handle, as separate processes would */
+struct TestStressCtx {
+  std::string          fifo_name;
+  struct ShmFifoAttr   attr;
+  int                  producers;
+  int                  consumers;
+  int                  n;
+  int                  total;
+  int                  popped;
+  int                  errors;
+  std::vector<int>     seen;
+};
+
+struct TestStressArg {
+  struct TestStressCtx *ctx;
+  int                   id;
+};
+
+/*
+ * a plain multi thread side spins until the threads ahead of it publish, with
+ * more threads than cpus one preempted in that window costs the others whole
+ * time slices, so only rts sides get every thread on a small machine
+ */
+static int StressThreads(uint32_t flags, uint32_t side)
+{
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (!(flags & side)) {
+    return 1;
+  }
+  if ((flags & SHMFIFO_FLAG_RTS) || cpus >= TEST_STRESS_THREADS * 2) {
+    return TEST_STRESS_THREADS;
+  }
+  return (cpus >= 4) ? (int)(cpus / 2) : 1;
+}
+
+static void *StressPush(void *arg)
+{
+  struct TestStressArg *a = (struct TestStressArg *)arg;
+  struct TestStressCtx *ctx = a->ctx;
+  struct ShmFifo       *fifo;
+  struct TestMsg        msg;
+  ssize_t               ret;
+
+  fifo = ShmFifoOpenAttr(ctx->fifo_name.c_str(), sizeof(msg), TEST_STRESS_COUNT, &ctx->attr);
+  if (!fifo) {
+    __atomic_add_fetch(&ctx->errors, 1, __ATOMIC_RELAXED);
+    return NULL;
+  }
+  memset(&msg, 0, sizeof(msg));
+  msg.f1 = a->id;
+  for (int i = 0; i < ctx->n; ++i) {
+    msg.seq = i;
+    while ((ret = ShmFifoPush(fifo, (const char *)&msg, sizeof(msg))) == -SHMFIFO_ERR_FULL) {
+      sched_yield();
+    }
+    if (ret != sizeof(msg)) {
+      SHMFIFO_ERR_OUT("ShmFifoPush err %ld", ret);
+      __atomic_add_fetch(&ctx->errors, 1, __ATOMIC_RELAXED);
+      break;
+    }
+  }
+  ShmFifoClose(fifo);
+  return NULL;
+}
+
+static void *StressPop(void *arg)
+{
+  struct TestStressArg *a = (struct TestStressArg *)arg;
+  struct TestStressCtx *ctx = a->ctx;
+  struct ShmFifo       *fifo;
+  struct TestMsg        msg;
+  std::vector<int64_t>  last(ctx->producers, -1);
+  ssize_t               ret;
+
+  fifo = ShmFifoOpenAttr(ctx->fifo_name.c_str(), sizeof(msg), TEST_STRESS_COUNT, &ctx->attr);
+  if (!fifo) {
+    __atomic_add_fetch(&ctx->errors, 1, __ATOMIC_RELAXED);
+    return NULL;
+  }
+  while (__atomic_load_n(&ctx->popped, __ATOMIC_RELAXED) < ctx->total &&
+         !__atomic_load_n(&ctx->errors, __ATOMIC_RELAXED)) {
+    ret = ShmFifoPopData(fifo, (char *)&msg, sizeof(msg));
+    if (ret == -SHMFIFO_ERR_EMPTY) {
+      sched_yield();
+      continue;
+    }
+    if (ret != sizeof(msg) || msg.f1 >= (uint32_t)ctx->producers || msg.seq >= (uint64_t)ctx->n) {
+      SHMFIFO_ERR_OUT("ShmFifoPopData err %ld, producer %u, seq %lu", ret, msg.f1, msg.seq);
+      __atomic_add_fetch(&ctx->errors, 1, __ATOMIC_RELAXED);
+      break;
+    }
+    /* one consumer sees each producer in order, several only in order among their own pops */
+    if ((int64_t)msg.seq <= last[msg.f1]) {
+      SHMFIFO_ERR_OUT("producer %u seq %lu after %ld", msg.f1, msg.seq, last[msg.f1]);
+      __atomic_add_fetch(&ctx->errors, 1, __ATOMIC_RELAXED);
+    }
+    last[msg.f1] = msg.seq;
+    __atomic_add_fetch(&ctx->seen[msg.f1 * ctx->n + msg.seq], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&ctx->popped, 1, __ATOMIC_RELAXED);
+  }
+  ShmFifoClose(fifo);
+  return NULL;
+}
+
+static int StressRun(const std::string &fifo_name, uint32_t flags, int n)
+{
+  struct TestStressCtx ctx;
+  struct ShmFifo      *fifo;
+  pthread_t            tids[TEST_STRESS_THREADS * 2];
+  struct TestStressArg args[TEST_STRESS_THREADS * 2];
+  int                  threads = 0;
+
+  unlink(fifo_name.c_str());
+  ctx.fifo_name = fifo_name;
+  ShmFifoAttrInit(&ctx.attr);
+  ctx.attr.flags = flags;
+  ctx.producers = StressThreads(flags, SHMFIFO_FLAG_MP);
+  ctx.consumers = StressThreads(flags, SHMFIFO_FLAG_MC);
+  ctx.n = n;
+  ctx.total = ctx.producers * n;
+  ctx.popped = 0;
+  ctx.errors = 0;
+  ctx.seen.assign(ctx.total, 0);
+
+  /* created up front so no thread races the format */
+  fifo = ShmFifoOpenAttr(fifo_name.c_str(), sizeof(struct TestMsg), TEST_STRESS_COUNT, &ctx.attr);
+  TEST_CHECK(fifo != NULL);
+  for (int i = 0; i < ctx.consumers; ++i, ++threads) {
+    args[threads].ctx = &ctx;
+    args[threads].id = i;
+    TEST_CHECK(pthread_create(&tids[threads], NULL, StressPop, &args[threads]) == 0);
+  }
+  for (int i = 0; i < ctx.producers; ++i, ++threads) {
+    args[threads].ctx = &ctx;
+    args[threads].id = i;
+    TEST_CHECK(pthread_create(&tids[threads], NULL, StressPush, &args[threads]) == 0);
+  }
+  for (int i = 0; i < threads; ++i) {
+    pthread_join(tids[i], NULL);
+  }
+  TEST_CHECK(ShmFifoPopData(fifo, (char *)&args, sizeof(args)) == -SHMFIFO_ERR_EMPTY);
+  ShmFifoClose(fifo);
+  unlink(fifo_name.c_str());
+
+  TEST_CHECK(ctx.errors == 0);
+  TEST_CHECK(ctx.popped == ctx.total);
+  for (int i = 0; i < ctx.total; ++i) {
+    if (ctx.seen[i] != 1) {
+      SHMFIFO_ERR_OUT("flags %x, producer %d seq %d popped %d times", flags, i / n, i % n,
+        ctx.seen[i]);
+      return TEST_FAIL;
+    }
+  }
+  SHMFIFO_DEBUG_OUT("flags %x, %d producers %d consumers, %d msgs ok", flags, ctx.producers,
+    ctx.consumers, ctx.total);
+  return SHMFIFO_ERR_NO;
+}
+
+int TestStress(std::string fifo_name, int n)
+{
+  static const uint32_t modes[] = {
+    SHMFIFO_SYNC_SPSC,
+    SHMFIFO_SYNC_MPSC,
+    SHMFIFO_SYNC_SPMC,
+    SHMFIFO_SYNC_MPMC,
+    SHMFIFO_SYNC_MPSC | SHMFIFO_FLAG_RTS,
+    SHMFIFO_SYNC_SPMC | SHMFIFO_FLAG_RTS,
+    SHMFIFO_SYNC_MPMC | SHMFIFO_FLAG_RTS,
+  };
+  int ret;
+
+  for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i) {
+    ret = StressRun(fifo_name, modes[i], n);
+    if (ret != SHMFIFO_ERR_NO) {
+      return ret;
+    }
+  }
+  return SHMFIFO_ERR_NO;
+}
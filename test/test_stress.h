@@ -0,0 +1,5 @@
+#ifndef TEST_STRESS_H_
+#define TEST_STRESS_H_
+#include <string>
+int TestStress(std::string fifo_name, int n);
+#endif
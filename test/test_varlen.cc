@@ -0,0 +1,205 @@
+#include <string>
+#include <string.h>
+#include <deque>
+
+#include "shmfifo.h"
+#include "shmfifo_error.h"
+#include "shmfifo_log.h"
+#include "test_check.h"
+
+#define TEST_VARLEN_SIZE  (200)
+#define TEST_VARLEN_COUNT (8)
+#define TEST_VARLEN_BURST (4)
+
+struct TestVarlenMsg {
+  uint32_t seq;
+  uint32_t size;
+};
+
+static struct ShmFifo *VarlenOpen(const std::string &fifo_name, uint32_t flags)
+{
+  struct ShmFifoAttr attr;
+
+  ShmFifoAttrInit(&attr);
+  attr.flags = SHMFIFO_FLAG_VARLEN | flags;
+  return ShmFifoOpenAttr(fifo_name.c_str(), TEST_VARLEN_SIZE, TEST_VARLEN_COUNT, &attr);
+}
+
+static void VarlenFill(char *data, uint32_t seq, size_t size)
+{
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = (char)(seq * 31 + i);
+  }
+}
+
+static int VarlenMatch(const void *data, size_t size, const struct TestVarlenMsg &msg)
+{
+  char expect[TEST_VARLEN_SIZE];
+
+  if (size != msg.size) {
+    SHMFIFO_ERR_OUT("seq %u size %lu, expected %u", msg.seq, size, msg.size);
+    return TEST_FAIL;
+  }
+  VarlenFill(expect, msg.seq, size);
+  if (memcmp(data, expect, size)) {
+    SHMFIFO_ERR_OUT("seq %u data mismatch", msg.seq);
+    return TEST_FAIL;
+  }
+  return SHMFIFO_ERR_NO;
+}
+
+/*
+ * records of every size run round the ring many times, each one that does
+ * not fit before the end goes behind a PAD filler and must come back whole
+ */
+static int VarlenWrap(const std::string &fifo_name, uint32_t flags, int n)
+{
+  struct ShmFifo           *fifo;
+  std::deque<struct TestVarlenMsg> queue;
+  struct TestVarlenMsg      msg;
+  struct iovec              iov[TEST_VARLEN_BURST];
+  char                      buf[TEST_VARLEN_SIZE];
+  void                     *data;
+  size_t                    size;
+  uint32_t                  seq = 0;
+  uint32_t                  rnd = 1;
+  ssize_t                   ret;
+
+  unlink(fifo_name.c_str());
+  fifo = VarlenOpen(fifo_name, flags);
+  TEST_CHECK(fifo != NULL);
+
+  for (int round = 0; round < n; ++round) {
+    for (int i = 0; i < TEST_VARLEN_BURST; ++i) {
+      rnd = rnd * 1103515245 + 12345;
+      msg.seq = seq;
+      msg.size = (rnd >> 16) % TEST_VARLEN_SIZE + 1;
+      VarlenFill(buf, msg.seq, msg.size);
+      ret = ShmFifoPush(fifo, buf, msg.size);
+      if (ret == -SHMFIFO_ERR_FULL) {
+        TEST_CHECK(!queue.empty());
+        break;
+      }
+      TEST_CHECK(ret == (ssize_t)msg.size);
+      queue.push_back(msg);
+      ++seq;
+    }
+    /* drain through each consumer api in turn */
+    switch (round % 3) {
+    case 0:
+      ret = ShmFifoPopData(fifo, buf, sizeof(buf));
+      TEST_CHECK(ret > 0 && VarlenMatch(buf, ret, queue.front()) == SHMFIFO_ERR_NO);
+      queue.pop_front();
+      break;
+    case 1:
+      data = ShmFifoTop(fifo, &size);
+      TEST_CHECK(data && VarlenMatch(data, size, queue.front()) == SHMFIFO_ERR_NO);
+      TEST_CHECK(ShmFifoPop(fifo) == SHMFIFO_ERR_NO);
+      queue.pop_front();
+      break;
+    default:
+      ret = ShmFifoTopBurst(fifo, iov, TEST_VARLEN_BURST);
+      TEST_CHECK(ret > 0 && ret <= (ssize_t)queue.size());
+      for (ssize_t i = 0; i < ret; ++i) {
+        TEST_CHECK(VarlenMatch(iov[i].iov_base, iov[i].iov_len, queue[i]) == SHMFIFO_ERR_NO);
+      }
+      TEST_CHECK(ShmFifoPopBulk(fifo, ret) == SHMFIFO_ERR_NO);
+      queue.erase(queue.begin(), queue.begin() + ret);
+      break;
+    }
+  }
+  while (!queue.empty()) {
+    ret = ShmFifoPopData(fifo, buf, sizeof(buf));
+    TEST_CHECK(ret > 0 && VarlenMatch(buf, ret, queue.front()) == SHMFIFO_ERR_NO);
+    queue.pop_front();
+  }
+  TEST_CHECK(ShmFifoPopData(fifo, buf, sizeof(buf)) == -SHMFIFO_ERR_EMPTY);
+
+  ShmFifoClose(fifo);
+  unlink(fifo_name.c_str());
+  SHMFIFO_DEBUG_OUT("flags %x, %u varlen records ok", flags, seq);
+  return SHMFIFO_ERR_NO;
+}
+
+/* short records pack tighter than msg_count slots of msg_size */
+static int VarlenPack(const std::string &fifo_name, uint32_t flags)
+{
+  struct ShmFifo *fifo;
+  uint64_t        seq = 0;
+  uint64_t        got;
+
+  unlink(fifo_name.c_str());
+  fifo = VarlenOpen(fifo_name, flags);
+  TEST_CHECK(fifo != NULL);
+  while (ShmFifoPush(fifo, (const char *)&seq, sizeof(seq)) == sizeof(seq)) {
+    ++seq;
+  }
+  TEST_CHECK(seq > TEST_VARLEN_COUNT);
+  for (uint64_t i = 0; i < seq; ++i) {
+    TEST_CHECK(ShmFifoPopData(fifo, (char *)&got, sizeof(got)) == sizeof(got) && got == i);
+  }
+  ShmFifoClose(fifo);
+  unlink(fifo_name.c_str());
+  return SHMFIFO_ERR_NO;
+}
+
+/* a reservation is used once, by a commit or an abort */
+static int VarlenReserve(const std::string &fifo_name, uint32_t flags)
+{
+  struct TestVarlenMsg msg = {7, 50};
+  struct ShmFifo      *fifo;
+  char                 buf[TEST_VARLEN_SIZE];
+  char                *slot;
+
+  unlink(fifo_name.c_str());
+  fifo = VarlenOpen(fifo_name, flags);
+  TEST_CHECK(fifo != NULL);
+
+  TEST_CHECK(ShmFifoReserve(fifo, TEST_VARLEN_SIZE + 1) == NULL);
+  slot = (char *)ShmFifoReserve(fifo, TEST_VARLEN_SIZE);
+  TEST_CHECK(slot != NULL);
+  TEST_CHECK(ShmFifoAbort(fifo, slot) == SHMFIFO_ERR_NO);
+  TEST_CHECK(ShmFifoAbort(fifo, slot) == -SHMFIFO_ERR_ABORT_ADDR);
+  TEST_CHECK(ShmFifoCommit(fifo, slot, msg.size) == -SHMFIFO_ERR_COMMIT_ADDR);
+  TEST_CHECK(ShmFifoPopData(fifo, buf, sizeof(buf)) == -SHMFIFO_ERR_EMPTY);
+
+  slot = (char *)ShmFifoReserve(fifo, TEST_VARLEN_SIZE);
+  TEST_CHECK(slot != NULL);
+  VarlenFill(slot, msg.seq, msg.size);
+  TEST_CHECK(ShmFifoCommit(fifo, slot, TEST_VARLEN_SIZE + 1) == -SHMFIFO_ERR_COMMIT_SIZE);
+  TEST_CHECK(ShmFifoCommit(fifo, slot, msg.size) == (ssize_t)msg.size);
+  TEST_CHECK(ShmFifoCommit(fifo, slot, msg.size) == -SHMFIFO_ERR_COMMIT_ADDR);
+  TEST_CHECK(ShmFifoAbort(fifo, slot) == -SHMFIFO_ERR_ABORT_ADDR);
+
+  TEST_CHECK(ShmFifoPopData(fifo, buf, sizeof(buf)) == (ssize_t)msg.size);
+  TEST_CHECK(VarlenMatch(buf, msg.size, msg) == SHMFIFO_ERR_NO);
+  TEST_CHECK(ShmFifoPopData(fifo, buf, sizeof(buf)) == -SHMFIFO_ERR_EMPTY);
+
+  ShmFifoClose(fifo);
+  unlink(fifo_name.c_str());
+  return SHMFIFO_ERR_NO;
+}
+
+int TestVarlen(std::string fifo_name, int n)
+{
+  static const uint32_t modes[] = {
+    0,
+    SHMFIFO_FLAG_ALIGN64,
+  };
+  int ret;
+
+  for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i) {
+    ret = VarlenWrap(fifo_name, modes[i], n);
+    if (ret == SHMFIFO_ERR_NO) {
+      ret = VarlenPack(fifo_name, modes[i]);
+    }
+    if (ret == SHMFIFO_ERR_NO) {
+      ret = VarlenReserve(fifo_name, modes[i]);
+    }
+    if (ret != SHMFIFO_ERR_NO) {
+      SHMFIFO_ERR_OUT("varlen flags %x failed", modes[i]);
+      return ret;
+    }
+  }
+  return SHMFIFO_ERR_NO;
+}
@@ -0,0 +1,5 @@
+#ifndef TEST_VARLEN_H_
+#define TEST_VARLEN_H_
+#include <string>
+int TestVarlen(std::string fifo_name, int n);
+#endif
@@ -0,0 +1,195 @@
+#include <string>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "shmfifo.h"
+#include "shmfifo_error.h"
+#include "shmfifo_log.h"
+#include "test_check.h"
+
+#define TEST_WAIT_SIZE    (48)
+#define TEST_WAIT_COUNT   (4)
+#define TEST_WAIT_US      (20000)
+/* loose upper bound so a loaded machine does not fail the timing checks */
+#define TEST_WAIT_SLACK_US (1000000)
+#define TEST_WAIT_SPIN_LONG (1ULL << 40)
+
+struct TestWaitArg {
+  std::string fifo_name;
+  uint32_t    flags;
+  ssize_t     ret;
+  uint64_t    seq;
+};
+
+static int64_t WaitNowUs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static struct ShmFifo *WaitOpen(const std::string &fifo_name, uint32_t flags, uint64_t spin)
+{
+  struct ShmFifoAttr attr;
+
+  ShmFifoAttrInit(&attr);
+  attr.flags = flags;
+  attr.spin_cycles = spin;
+  return ShmFifoOpenAttr(fifo_name.c_str(), TEST_WAIT_SIZE, TEST_WAIT_COUNT, &attr);
+}
+
+/* the spin phase counts against the timeout, even a very long one */
+static int WaitTimeout(const std::string &fifo_name, uint32_t flags)
+{
+  struct ShmFifo *fifo;
+  char            buf[TEST_WAIT_SIZE];
+  size_t          size;
+  int64_t         start;
+  int64_t         elapsed;
+
+  unlink(fifo_name.c_str());
+  fifo = WaitOpen(fifo_name, flags, TEST_WAIT_SPIN_LONG);
+  TEST_CHECK(fifo != NULL);
+  memset(buf, 0, sizeof(buf));
+
+  start = WaitNowUs();
+  TEST_CHECK(ShmFifoPopDataWait(fifo, buf, sizeof(buf), 0) == -SHMFIFO_ERR_TIMEOUT);
+  TEST_CHECK(ShmFifoTopWait(fifo, &size, 0) == NULL);
+  elapsed = WaitNowUs() - start;
+  TEST_CHECK(elapsed < TEST_WAIT_SLACK_US);
+
+  start = WaitNowUs();
+  TEST_CHECK(ShmFifoPopDataWait(fifo, buf, sizeof(buf), TEST_WAIT_US) == -SHMFIFO_ERR_TIMEOUT);
+  elapsed = WaitNowUs() - start;
+  TEST_CHECK(elapsed >= TEST_WAIT_US && elapsed < TEST_WAIT_US + TEST_WAIT_SLACK_US);
+
+  while (ShmFifoPush(fifo, buf, sizeof(buf)) == sizeof(buf)) {
+  }
+  start = WaitNowUs();
+  TEST_CHECK(ShmFifoPushWait(fifo, buf, sizeof(buf), TEST_WAIT_US) == -SHMFIFO_ERR_TIMEOUT);
+  elapsed = WaitNowUs() - start;
+  TEST_CHECK(elapsed >= TEST_WAIT_US && elapsed < TEST_WAIT_US + TEST_WAIT_SLACK_US);
+
+  /* ready without waiting */
+  TEST_CHECK(ShmFifoPopDataWait(fifo, buf, sizeof(buf), 0) == sizeof(buf));
+  TEST_CHECK(ShmFifoPushWait(fifo, buf, sizeof(buf), 0) == sizeof(buf));
+
+  ShmFifoClose(fifo);
+  unlink(fifo_name.c_str());
+  return SHMFIFO_ERR_NO;
+}
+
+static void *WaitPop(void *arg)
+{
+  struct TestWaitArg *a = (struct TestWaitArg *)arg;
+  struct ShmFifo     *fifo;
+  char                buf[TEST_WAIT_SIZE];
+
+  fifo = WaitOpen(a->fifo_name, a->flags, 0);
+  if (!fifo) {
+    a->ret = -SHMFIFO_ERR_OPEN;
+    return NULL;
+  }
+  /* inline pops copy whole cells */
+  a->ret = ShmFifoPopDataWait(fifo, buf, sizeof(buf), -1);
+  memcpy(&a->seq, buf, sizeof(a->seq));
+  ShmFifoClose(fifo);
+  return NULL;
+}
+
+static void *WaitPush(void *arg)
+{
+  struct TestWaitArg *a = (struct TestWaitArg *)arg;
+  struct ShmFifo     *fifo;
+
+  fifo = WaitOpen(a->fifo_name, a->flags, 0);
+  if (!fifo) {
+    a->ret = -SHMFIFO_ERR_OPEN;
+    return NULL;
+  }
+  a->ret = ShmFifoPushWait(fifo, (const char *)&a->seq, sizeof(a->seq), -1);
+  ShmFifoClose(fifo);
+  return NULL;
+}
+
+/* no spinning, the waiter sleeps on the futex until the other side wakes it */
+static int WaitWake(const std::string &fifo_name, uint32_t flags)
+{
+  struct ShmFifo     *fifo;
+  struct TestWaitArg  arg;
+  pthread_t           tid;
+  char                buf[TEST_WAIT_SIZE];
+  uint64_t            seq = 42;
+  uint64_t            pushed = 0;
+
+  unlink(fifo_name.c_str());
+  fifo = WaitOpen(fifo_name, flags, 0);
+  TEST_CHECK(fifo != NULL);
+  arg.fifo_name = fifo_name;
+  arg.flags = flags;
+
+  arg.ret = 0;
+  arg.seq = 0;
+  TEST_CHECK(pthread_create(&tid, NULL, WaitPop, &arg) == 0);
+  usleep(TEST_WAIT_US);
+  TEST_CHECK(ShmFifoPush(fifo, (const char *)&seq, sizeof(seq)) == sizeof(seq));
+  pthread_join(tid, NULL);
+  TEST_CHECK(arg.ret == sizeof(seq) && arg.seq == seq);
+
+  while (ShmFifoPush(fifo, (const char *)&pushed, sizeof(pushed)) == sizeof(pushed)) {
+    ++pushed;
+  }
+  arg.ret = 0;
+  arg.seq = seq;
+  TEST_CHECK(pthread_create(&tid, NULL, WaitPush, &arg) == 0);
+  usleep(TEST_WAIT_US);
+  for (uint64_t i = 0; i < pushed; ++i) {
+    TEST_CHECK(ShmFifoPopData(fifo, buf, sizeof(buf)) == sizeof(seq));
+    TEST_CHECK(memcmp(buf, &i, sizeof(i)) == 0);
+  }
+  pthread_join(tid, NULL);
+  TEST_CHECK(arg.ret == sizeof(seq));
+  TEST_CHECK(ShmFifoPopData(fifo, buf, sizeof(buf)) == sizeof(seq));
+  TEST_CHECK(memcmp(buf, &arg.seq, sizeof(arg.seq)) == 0);
+
+  ShmFifoClose(fifo);
+  unlink(fifo_name.c_str());
+  return SHMFIFO_ERR_NO;
+}
+
+int TestWait(std::string fifo_name)
+{
+  static const uint32_t modes[] = {
+    SHMFIFO_FLAG_WAIT,
+    SHMFIFO_FLAG_WAIT | SHMFIFO_SYNC_MPMC,
+    SHMFIFO_FLAG_WAIT | SHMFIFO_FLAG_DIRECT,
+    SHMFIFO_FLAG_WAIT | SHMFIFO_FLAG_INLINE,
+    SHMFIFO_FLAG_WAIT | SHMFIFO_FLAG_VARLEN,
+  };
+  struct ShmFifo *fifo;
+  char            buf[TEST_WAIT_SIZE];
+  int             ret;
+
+  unlink(fifo_name.c_str());
+  fifo = WaitOpen(fifo_name, 0, 0);
+  TEST_CHECK(fifo != NULL);
+  TEST_CHECK(ShmFifoPopDataWait(fifo, buf, sizeof(buf), 0) == -SHMFIFO_ERR_WAIT_FLAGS);
+  ShmFifoClose(fifo);
+
+  for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i) {
+    ret = WaitTimeout(fifo_name, modes[i]);
+    if (ret != SHMFIFO_ERR_NO) {
+      SHMFIFO_ERR_OUT("flags %x, wait timeout failed", modes[i]);
+      return ret;
+    }
+    ret = WaitWake(fifo_name, modes[i]);
+    if (ret != SHMFIFO_ERR_NO) {
+      SHMFIFO_ERR_OUT("flags %x, wait wake failed", modes[i]);
+      return ret;
+    }
+  }
+  unlink(fifo_name.c_str());
+  return SHMFIFO_ERR_NO;
+}
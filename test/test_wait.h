@@ -0,0 +1,5 @@
+#ifndef TEST_WAIT_H_
+#define TEST_WAIT_H_
+#include <string>
+int TestWait(std::string fifo_name);
+#endif
@@ -0,0 +1,341 @@
+/*
+ * shmfifo-stat, prints the state of a fifo file without ShmFifoOpen, the
+ * file is mapped PROT_READ so the tool can never format, lock or write it
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shmfifo.h"
+#include "shmfifo_header.h"
+#include "shmfifo_ring.h"
+#include "shmfifo_byte_ring.h"
+#include "shmfifo_cursor.h"
+
+#define STAT_INTERVAL_MS (1000)
+
+/* read only view of the metadata in front of the data region */
+struct StatView {
+  const struct ShmFifoHeader      *header;
+  const struct ShmFifoRing        *list;
+  const struct ShmFifoByteRing    *bytes;
+  const struct ShmFifoCursorTable *cursors;
+  size_t                           map_size;
+};
+
+/*
+ * counters at one instant, from the stats block with SHMFIFO_FLAG_STATS,
+ * otherwise the ring tails, which wrap at 32 bits
+ */
+struct StatSample {
+  struct timespec ts;
+  uint64_t        pushes;
+  uint64_t        pops;
+  uint64_t        bytes;
+};
+
+static const struct {
+  uint32_t    flag;
+  const char *name;
+} kStatFlags[] = {
+  {SHMFIFO_FLAG_DIRECT, "DIRECT"}, {SHMFIFO_FLAG_MP, "MP"}, {SHMFIFO_FLAG_MC, "MC"},
+  {SHMFIFO_FLAG_RTS, "RTS"}, {SHMFIFO_FLAG_WAIT, "WAIT"}, {SHMFIFO_FLAG_EVENT, "EVENT"},
+  {SHMFIFO_FLAG_BROADCAST, "BROADCAST"}, {SHMFIFO_FLAG_EVICT, "EVICT"},
+  {SHMFIFO_FLAG_VARLEN, "VARLEN"}, {SHMFIFO_FLAG_ALIGN64, "ALIGN64"},
+  {SHMFIFO_FLAG_MIRROR, "MIRROR"}, {SHMFIFO_FLAG_INLINE, "INLINE"},
+  {SHMFIFO_FLAG_STATS, "STATS"},
+};
+
+static void StatUsage(const char *prog)
+{
+  fprintf(stderr, "usage: %s [-i interval_ms] [-t] [-n count] fifo_path\n"
+    "  -i  rate sampling interval, 0 prints the state only, default %d\n"
+    "  -t  redraw every interval like top until interrupted\n"
+    "  -n  stop after count redraws with -t\n", prog, STAT_INTERVAL_MS);
+}
+
+static int StatOpen(const char *path, struct StatView *view)
+{
+  const struct ShmFifoHeader *header;
+  struct stat                 st;
+  size_t                      meta_size;
+  void                       *addr;
+  int                         fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "open %s failed, %s\n", path, strerror(errno));
+    return -1;
+  }
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct ShmFifoHeader)) {
+    fprintf(stderr, "%s is not a fifo file, size %ld\n", path, (long)st.st_size);
+    close(fd);
+    return -1;
+  }
+  addr = mmap(NULL, sizeof(struct ShmFifoHeader), PROT_READ, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    fprintf(stderr, "mmap %s failed, %s\n", path, strerror(errno));
+    close(fd);
+    return -1;
+  }
+  header = (const struct ShmFifoHeader *)addr;
+  if (header->magic != SHMFIFO_MAGIC) {
+    fprintf(stderr, "%s magic %#x, not a fifo file or not formatted yet\n", path,
+      header->magic);
+    goto err_header;
+  }
+  if (header->version != SHMFIFO_VERSION) {
+    fprintf(stderr, "%s version %u.%u, this tool reads %u.%u only\n", path,
+      header->version >> 16, header->version & 0xFFFF, SHMFIFO_MAJOR, SHMFIFO_MINOR);
+    goto err_header;
+  }
+  /* rings, pools and cursors sit between the header and the data region */
+  meta_size = header->data_offset;
+  if (meta_size < sizeof(struct ShmFifoHeader) || meta_size > (size_t)st.st_size) {
+    fprintf(stderr, "%s data offset %lu out of file size %ld\n", path,
+      (unsigned long)meta_size, (long)st.st_size);
+    goto err_header;
+  }
+  munmap(addr, sizeof(struct ShmFifoHeader));
+  addr = mmap(NULL, meta_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    fprintf(stderr, "mmap %s failed, %s\n", path, strerror(errno));
+    return -1;
+  }
+  memset(view, 0, sizeof(*view));
+  view->header = (const struct ShmFifoHeader *)addr;
+  view->map_size = meta_size;
+  if (view->header->flags & SHMFIFO_FLAG_VARLEN) {
+    view->bytes = (const struct ShmFifoByteRing *)((const char *)addr +
+      view->header->list_offset);
+  } else {
+    view->list = (const struct ShmFifoRing *)((const char *)addr + view->header->list_offset);
+  }
+  if (view->header->cursor_offset) {
+    view->cursors = (const struct ShmFifoCursorTable *)((const char *)addr +
+      view->header->cursor_offset);
+  }
+  return 0;
+
+err_header:
+  munmap(addr, sizeof(struct ShmFifoHeader));
+  close(fd);
+  return -1;
+}
+
+static void StatTake(const struct StatView *view, struct StatSample *sample)
+{
+  const struct ShmFifoStatsBlock *stats = &view->header->stats;
+
+  clock_gettime(CLOCK_MONOTONIC, &sample->ts);
+  if (view->header->flags & SHMFIFO_FLAG_STATS) {
+    sample->pushes = __atomic_load_n(&stats->prod.pushes, __ATOMIC_RELAXED);
+    sample->pops = __atomic_load_n(&stats->cons.pops, __ATOMIC_RELAXED);
+    sample->bytes = __atomic_load_n(&stats->prod.bytes, __ATOMIC_RELAXED);
+  } else if (view->bytes) {
+    /* without counters a varlen fifo only tells how many bytes moved */
+    sample->pushes = 0;
+    sample->pops = 0;
+    sample->bytes = __atomic_load_n(&view->bytes->prod_tail, __ATOMIC_RELAXED);
+  } else {
+    sample->pushes = __atomic_load_n(&view->list->prod.tail, __ATOMIC_RELAXED);
+    sample->pops = __atomic_load_n(&view->list->cons.tail, __ATOMIC_RELAXED);
+    sample->bytes = 0;
+  }
+}
+
+static uint64_t StatDelta(const struct StatView *view, uint64_t now, uint64_t before)
+{
+  if (view->header->flags & (SHMFIFO_FLAG_STATS | SHMFIFO_FLAG_VARLEN)) {
+    return now - before;
+  }
+  return (uint32_t)(now - before);
+}
+
+static uint32_t StatHead(const struct ShmFifoHeadTail *ht, const struct ShmFifoRtsHeadTail *rts)
+{
+  if (ht->sync_type == SHMFIFO_RING_SYNC_MT_RTS) {
+    return __atomic_load_n(&rts->head.val.pos, __ATOMIC_RELAXED);
+  }
+  return __atomic_load_n(&ht->head, __ATOMIC_RELAXED);
+}
+
+static void StatPrintRate(const char *name, double v, const char *unit)
+{
+  if (v >= 1e9) {
+    printf("  %s %.2f G%s/s", name, v / 1e9, unit);
+  } else if (v >= 1e6) {
+    printf("  %s %.2f M%s/s", name, v / 1e6, unit);
+  } else if (v >= 1e3) {
+    printf("  %s %.2f K%s/s", name, v / 1e3, unit);
+  } else {
+    printf("  %s %.0f %s/s", name, v, unit);
+  }
+}
+
+static void StatPrint(const char *path, const struct StatView *view,
+  const struct StatSample *before, const struct StatSample *now)
+{
+  const struct ShmFifoHeader *header = view->header;
+  const struct ShmFifoStatsBlock *stats = &header->stats;
+  const struct ShmFifoCursor *cursor;
+  uint64_t                    depth;
+  uint64_t                    capacity;
+  uint32_t                    prod_tail;
+  char                        created[32];
+  struct tm                   tm;
+  double                      secs;
+  size_t                      i;
+  int                         alive;
+
+  printf("fifo       %s\n", path);
+  printf("magic      %#x  version %u.%u\n", header->magic, header->version >> 16,
+    header->version & 0xFFFF);
+  printf("flags      %#x", header->flags);
+  for (i = 0; i < sizeof(kStatFlags) / sizeof(kStatFlags[0]); ++i) {
+    if (header->flags & kStatFlags[i].flag) {
+      printf(" %s", kStatFlags[i].name);
+    }
+  }
+  printf("\n");
+  printf("msg_size   %lu  msg_count %lu  data_size %lu  total_size %lu\n",
+    (unsigned long)header->msg_size, (unsigned long)header->msg_count,
+    (unsigned long)header->data_size, (unsigned long)header->total_size);
+  printf("page_size  %lu\n", (unsigned long)header->page_size);
+  for (i = 0; i + 1 < header->class_num; ++i) {
+    printf("class      %lu  msg_size %lu  msg_count %lu\n", (unsigned long)i,
+      (unsigned long)header->classes[i].msg_size, (unsigned long)header->classes[i].msg_count);
+  }
+  localtime_r(&header->create_time, &tm);
+  strftime(created, sizeof(created), "%Y-%m-%d %H:%M:%S", &tm);
+  alive = kill(header->creator, 0) == 0 || errno == EPERM;
+  printf("creator    pid %d (%s)  created %s\n", (int)header->creator,
+    alive ? "running" : "exited", created);
+
+  if (view->bytes) {
+    depth = __atomic_load_n(&view->bytes->prod_tail, __ATOMIC_RELAXED) -
+      __atomic_load_n(&view->bytes->cons_tail, __ATOMIC_RELAXED);
+    capacity = view->bytes->size;
+    printf("prod       tail %lu\n", (unsigned long)view->bytes->prod_tail);
+    printf("cons       tail %lu\n", (unsigned long)view->bytes->cons_tail);
+    printf("depth      %lu / %lu bytes (%.1f%%)\n", (unsigned long)depth,
+      (unsigned long)capacity, capacity ? 100.0 * depth / capacity : 0.0);
+  } else {
+    prod_tail = __atomic_load_n(&view->list->prod.tail, __ATOMIC_RELAXED);
+    depth = (uint32_t)(prod_tail - __atomic_load_n(&view->list->cons.tail, __ATOMIC_RELAXED));
+    capacity = view->list->capacity;
+    printf("prod       head %u  tail %u  retries %lu\n",
+      StatHead(&view->list->prod, &view->list->rts_prod), prod_tail,
+      (unsigned long)view->list->prod_retries);
+    printf("cons       head %u  tail %u  retries %lu\n",
+      StatHead(&view->list->cons, &view->list->rts_cons), view->list->cons.tail,
+      (unsigned long)view->list->cons_retries);
+    printf("depth      %lu / %lu (%.1f%%)\n", (unsigned long)depth, (unsigned long)capacity,
+      capacity ? 100.0 * depth / capacity : 0.0);
+  }
+  if (view->cursors) {
+    for (i = 0; i < SHMFIFO_CURSOR_MAX; ++i) {
+      cursor = &view->cursors->cursor[i];
+      if (!ShmFifoCursorLive(cursor)) {
+        continue;
+      }
+      printf("subscriber %lu  pid %d  pos %u  lag %u\n", (unsigned long)i, (int)cursor->pid,
+        cursor->pos, ShmFifoCursorCount(cursor, view->list));
+    }
+  }
+  if (header->flags & SHMFIFO_FLAG_STATS) {
+    printf("stats      pushes %lu  bytes %lu  full %lu  pops %lu  empty %lu  max_depth %lu\n",
+      (unsigned long)stats->prod.pushes, (unsigned long)stats->prod.bytes,
+      (unsigned long)stats->prod.full, (unsigned long)stats->cons.pops,
+      (unsigned long)stats->cons.empty, (unsigned long)stats->prod.max_depth);
+  }
+  if (!before) {
+    return;
+  }
+  secs = (now->ts.tv_sec - before->ts.tv_sec) + (now->ts.tv_nsec - before->ts.tv_nsec) / 1e9;
+  if (secs <= 0) {
+    return;
+  }
+  printf("rate     ");
+  if (header->flags & SHMFIFO_FLAG_STATS || !view->bytes) {
+    StatPrintRate("push", StatDelta(view, now->pushes, before->pushes) / secs, "msg");
+    StatPrintRate("pop", StatDelta(view, now->pops, before->pops) / secs, "msg");
+  }
+  if (header->flags & (SHMFIFO_FLAG_STATS | SHMFIFO_FLAG_VARLEN)) {
+    StatPrintRate("push", StatDelta(view, now->bytes, before->bytes) / secs, "B");
+  }
+  printf("  over %.0f ms\n", secs * 1e3);
+}
+
+static void StatSleep(long ms)
+{
+  struct timespec ts;
+
+  ts.tv_sec = ms / 1000;
+  ts.tv_nsec = (ms % 1000) * 1000000L;
+  while (nanosleep(&ts, &ts) < 0 && errno == EINTR);
+}
+
+int main(int argc, char *argv[])
+{
+  struct StatView   view;
+  struct StatSample before;
+  struct StatSample now;
+  long              interval = STAT_INTERVAL_MS;
+  long              count = 0;
+  long              i;
+  int               top = 0;
+  int               opt;
+
+  while ((opt = getopt(argc, argv, "i:n:th")) != -1) {
+    switch (opt) {
+    case 'i':
+      interval = atol(optarg);
+      break;
+    case 'n':
+      count = atol(optarg);
+      break;
+    case 't':
+      top = 1;
+      break;
+    default:
+      StatUsage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind + 1 != argc || interval < 0 || count < 0 || (top && !interval)) {
+    StatUsage(argv[0]);
+    return 1;
+  }
+  if (StatOpen(argv[optind], &view) < 0) {
+    return 1;
+  }
+  StatTake(&view, &before);
+  if (!top) {
+    if (interval) {
+      StatSleep(interval);
+      StatTake(&view, &now);
+    }
+    StatPrint(argv[optind], &view, interval ? &before : NULL, &now);
+    return 0;
+  }
+  for (i = 0; !count || i < count; ++i) {
+    StatSleep(interval);
+    StatTake(&view, &now);
+    printf("\033[H\033[2J");
+    StatPrint(argv[optind], &view, &before, &now);
+    fflush(stdout);
+    before = now;
+  }
+  return 0;
+}